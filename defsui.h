@@ -47,6 +47,9 @@
 
 #define LABELS_RIGHT_JUSTIFICATION_VALUE        (8)
 
+#define HISTOGRAM_BINS_NUMBER                   FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER
+#define HISTOGRAM_SPACING                       FITS_HISTOGRAM_SPACING_LINEAR   /// _LOG or _ASINH give the faint values more bins
+
 #include <QString>
 
 constexpr int32_t minTickCountX = 10, maxTickCountX = 15;
@@ -135,6 +138,8 @@ struct ImageParams
     uint32_t        height;
     long double     bzero;
     long double     bscale;
+    int64_t         blank;
+    bool            blankFlag;      /// the BLANK keyword is defined
     size_t          HDUBaseOffset;
     size_t          maxDataBufferSize;
     uint32_t        hduIndex;
@@ -22,7 +22,20 @@ static int32_t percentCallbackFunctionSample(int32_t a_percent, void* a_buffer)
 
 #define OPENMP_THREADS_DISABLE_NUMBER           (0) //// Number of excluded OpenMP threads - default here is 2
 
-#define ENABLE_FILE_MAPPING_FILE_LOADING        //// enabling for mapping file into RAM or legacy file reading
+#define ENABLE_FILE_MAPPING_FILE_LOADING        //// default I/O strategy: auto (mapping) or legacy file reading, see FITS_IO_STRATEGY_ENV_VARIABLE
+
+#define ENABLE_PARALLEL_FILE_READING            //// enabling/disabling reading large files with many concurrent requests (io_uring or threads)
+                                                //// Opt-in: used by the read* strategies only (e.g. NFITSVIEW_IO_STRATEGY=read), auto maps the large files
+
+//// the *_SIDECAR files are written next to the data files, so they are off by default
+///#define ENABLE_GZIP_INDEX_SIDECAR            //// enabling/disabling saving/loading the gzip access points index next to .gz files
+#define ENABLE_GZIP_PIPELINED_LOADING           //// enabling/disabling parsing HDUs of .gz files while they are still being inflated
+#define ENABLE_FAST_HDU_SCAN                    //// enabling/disabling locating HDUs by the structural keywords only, full headers are parsed on demand
+///#define ENABLE_HDU_INDEX_SIDECAR             //// enabling/disabling saving/loading the HDU offsets index next to multi-extension files
+///#define ENABLE_STATS_CACHE_SIDECAR           //// enabling/disabling saving/loading the image statistics next to the files
+#define ENABLE_SIMD_PIXEL_KERNELS               //// enabling/disabling the SSE4.2/AVX2/AVX-512 pixel conversion kernels chosen at runtime
+#define ENABLE_SAMPLE_PLANE_CACHE               //// enabling/disabling keeping the decoded samples of the images for re-rendering them
+#define ENABLE_PARALLEL_RENDERING               //// enabling/disabling rendering the images by row bands on all the cores
 
 #define LIBNFITS_MAJOR_VERSION                  3
 #define LIBNFITS_MINOR_VERSION                  9
@@ -48,6 +61,39 @@ constexpr long double FITS_BZERO_DEFAULT_VALUE   = 0.0L;
 #define FITS_COMPRESS_MEMORY_CHUNK_MB           (64)                /// default is 64 MB
 #define FITS_COMPRESS_MEMORY_CHUNK_SIZE         (FITS_COMPRESS_MEMORY_CHUNK_MB * 1024 * 1024)
 
+#define FITS_GZIP_INFLATE_BLOCK_MB              (256)               /// max. amount of data passed to one inflate() call
+#define FITS_GZIP_INFLATE_BLOCK_SIZE            ((size_t)FITS_GZIP_INFLATE_BLOCK_MB * 1024 * 1024)
+#define FITS_GZIP_MIN_SIZE                      (18)                /// 10 bytes header + 8 bytes trailer
+#define FITS_GZIP_ISIZE_WRAP                    (0x100000000ULL)    /// ISIZE is stored modulo 2^32
+#define FITS_GZIP_MAX_ESTIMATE_RATIO            (4)                 /// max. decompressed/compressed size ratio assumed for a wrapped ISIZE
+#define FITS_GZIP_MAGIC                         (0x8b1f)
+#define FITS_GZIP_WINDOW_SIZE                   (32768)             /// deflate history window size
+#define FITS_GZIP_MEMBER_START                  (-1)                /// access point at the beginning of a gzip member
+#define FITS_GZIP_INDEX_SPAN_MB                 (8)                 /// distance between access points of the gzip index
+#define FITS_GZIP_INDEX_SPAN_SIZE               ((size_t)FITS_GZIP_INDEX_SPAN_MB * 1024 * 1024)
+#define FITS_GZIP_INDEX_HEADER_BLOCKS           (16)                /// number of FITS blocks inflated at once during header lookup
+#define FITS_GZIP_INDEX_FILE_EXTENSION          ".gzidx"
+#define FITS_GZIP_INDEX_FILE_SIGNATURE          "NFGZIDX1"
+#define FITS_GZIP_PIPELINE_BLOCK_MB             (1)                 /// amount of data inflated before the parser is notified
+#define FITS_GZIP_PIPELINE_BLOCK_SIZE           ((size_t)FITS_GZIP_PIPELINE_BLOCK_MB * 1024 * 1024)
+
+#define FITS_GZIP_INFLATE_RUNNING               (0)
+#define FITS_GZIP_INFLATE_DONE                  (1)
+#define FITS_GZIP_INFLATE_ERROR                 (-1)
+#define FITS_GZIP_INFLATE_OVERFLOW              (-2)                /// the presized buffer is too small, the data must be inflated again
+
+#define FITS_HDU_INDEX_FILE_EXTENSION           ".hduidx"
+#define FITS_HDU_INDEX_FILE_SIGNATURE           "NFHDUIX1"
+#define FITS_HDU_INDEX_MIN_HDUS                 (16)                /// the index is saved only for files with at least this number of HDUs
+#define FITS_MAX_NAXIS                          (999)               /// the largest NAXIS value allowed by the standard
+
+#define FITS_STATS_CACHE_FILE_EXTENSION         ".nfstats"
+#define FITS_STATS_CACHE_FILE_SIGNATURE         "NFSTATS1"
+#define FITS_STATS_CACHE_HASH_BLOCKS            (64)                /// FITS blocks of a payload hashed to validate its cached statistics
+#define FITS_STATS_CACHE_MAX_BINS               (16777216)          /// larger histograms in a cache file mean it is corrupted
+
+#define FITS_HDU_CALLBACK_RESET                 (-1)                /// passed to the HDU callback, all previously reported HDUs are invalid
+
 #define FITS_HEADER_RECORD_ASSIGNMENT_CHAR      '='
 #define FITS_PADDING_SPACE_CHAR                 ' '
 #define FITS_QUOTE_CHAR                         '\''
@@ -75,6 +121,50 @@ constexpr long double FITS_BZERO_DEFAULT_VALUE   = 0.0L;
 #define FITS_MSG_ERROR_OPENING_FILE             "Error occurred during opening the file or the file is not FITS format!"
 #define FITS_MSG_ERROR_TYPE                     "File Open Error"
 
+#define FITS_IO_STRATEGY_AUTO                   (0)                 /// chosen from the file size and the access pattern
+#define FITS_IO_STRATEGY_MMAP                   (1)
+#define FITS_IO_STRATEGY_MMAP_SEQUENTIAL        (2)                 /// mmap + madvise(MADV_SEQUENTIAL | MADV_WILLNEED)
+#define FITS_IO_STRATEGY_MMAP_POPULATE          (3)                 /// mmap with all the pages prefaulted (MAP_POPULATE)
+#define FITS_IO_STRATEGY_READ                   (4)                 /// read() into a heap buffer
+#define FITS_IO_STRATEGY_READ_DIRECT            (5)                 /// O_DIRECT read() bypassing the page cache, for cold reads
+#define FITS_IO_STRATEGY_READ_HUGE_PAGES        (6)                 /// read() into a transparent huge pages backed buffer
+
+#ifdef ENABLE_FILE_MAPPING_FILE_LOADING
+#define FITS_IO_STRATEGY_DEFAULT                FITS_IO_STRATEGY_AUTO
+#else
+#define FITS_IO_STRATEGY_DEFAULT                FITS_IO_STRATEGY_READ
+#endif
+
+#define FITS_IO_STRATEGY_ENV_VARIABLE           "NFITSVIEW_IO_STRATEGY"     /// overrides the default strategy, e.g. "read" or "mmap-populate"
+
+#define FITS_PIXEL_KERNELS_ENV_VARIABLE         "NFITSVIEW_PIXEL_KERNELS"   /// forces "scalar", "sse4.2", "avx2" or "avx512" kernels
+#define FITS_PIXEL_KERNELS_SCALAR               "scalar"
+
+#define FITS_SAMPLE_PLANE_CACHE_BUDGET_MB       (1024)              /// memory for the decoded samples of all the images
+#define FITS_SAMPLE_PLANE_CACHE_BUDGET_SIZE     ((size_t)FITS_SAMPLE_PLANE_CACHE_BUDGET_MB * 1024 * 1024)
+
+#define FITS_RENDER_BAND_PIXELS                 (262144)            /// pixels of the rows a thread renders at once
+#define FITS_RENDER_MAX_THREADS                 (64)
+
+#define FITS_IO_ACCESS_NORMAL                   (0)
+#define FITS_IO_ACCESS_SEQUENTIAL               (1)                 /// the file is read once from the start to the end, e.g. inflating
+#define FITS_IO_ACCESS_RANDOM                   (2)                 /// only parts of the file are read, e.g. indexed .gz files
+
+#define FITS_IO_SMALL_FILE_MB                   (16)                /// auto: smaller files are read() at once
+#define FITS_IO_SMALL_FILE_SIZE                 ((size_t)FITS_IO_SMALL_FILE_MB * 1024 * 1024)
+#define FITS_IO_POPULATE_MAX_MB                 (1024)              /// auto: larger files are not prefaulted
+#define FITS_IO_POPULATE_MAX_SIZE               ((size_t)FITS_IO_POPULATE_MAX_MB * 1024 * 1024)
+#define FITS_IO_READ_CHUNK_MB                   (64)                /// max. amount of data per read() call
+#define FITS_IO_READ_CHUNK_SIZE                 ((size_t)FITS_IO_READ_CHUNK_MB * 1024 * 1024)
+#define FITS_IO_DIRECT_ALIGNMENT                (4096)              /// O_DIRECT buffer, offset and length alignment
+#define FITS_IO_HUGE_PAGE_SIZE                  (2 * 1024 * 1024)
+#define FITS_IO_PARALLEL_MIN_MB                 (64)                /// smaller files are read with a single request at a time
+#define FITS_IO_PARALLEL_MIN_SIZE               ((size_t)FITS_IO_PARALLEL_MIN_MB * 1024 * 1024)
+#define FITS_IO_PARALLEL_CHUNK_MB               (4)                 /// size of one request, a multiple of FITS_IO_DIRECT_ALIGNMENT
+#define FITS_IO_PARALLEL_CHUNK_SIZE             ((size_t)FITS_IO_PARALLEL_CHUNK_MB * 1024 * 1024)
+#define FITS_IO_PARALLEL_QUEUE_DEPTH            (32)                /// io_uring requests in flight
+#define FITS_IO_PARALLEL_MAX_THREADS            (8)                 /// pread() threads if io_uring is not available
+
 #define FITS_MEMORY_MAP_FILE_SUCCESS            (1)
 #define FITS_MEMORY_MAP_FILE_ERROR              (0)
 
@@ -135,6 +225,12 @@ constexpr uint32_t FITS_NUMBER_OF_TRANSFORMS =                  9;
 constexpr uint32_t FITS_PERCENTILE_THRESHOLD_OFFSET =           1000;  /// workaround for not calculating wrong distrib stats
                                                                        /// as every percent smaller than this value will be
                                                                        /// treated in the old threshold logic (the progressbar)
+constexpr uint32_t FITS_PERCENTILE_METHOD_HISTOGRAM =           0;     /// interpolation inside a value distribution segment
+constexpr uint32_t FITS_PERCENTILE_METHOD_EXACT =               1;     /// radix selection over all the valid pixels
+constexpr uint32_t FITS_PERCENTILE_METHOD_SAMPLED =             2;     /// selection within FITS_PERCENTILE_SAMPLE_PIXELS pixels
+constexpr uint32_t FITS_HISTOGRAM_SPACING_LINEAR =              0;     /// bins of the same width
+constexpr uint32_t FITS_HISTOGRAM_SPACING_LOG =                 1;     /// bins widening with the distance from the min
+constexpr uint32_t FITS_HISTOGRAM_SPACING_ASINH =               2;     /// bins widening with the distance from 0
 
 #define FITS_FLOAT_DOUBLE_RANGE_MIN_ZERO             (0.0)
 #define FITS_FLOAT_DOUBLE_RANGE_MAX_ZERO             (0.0)
@@ -143,5 +239,13 @@ constexpr uint32_t FITS_PERCENTILE_THRESHOLD_OFFSET =           1000;  /// worka
 
 #define FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER      (10000) /// old default was 200
 #define FITS_VALUE_DISTRIBUTION_RANGE_MIN_THREASHOLD (0.01)
+#define FITS_HISTOGRAM_SOFTENING_FACTOR              (0.001) /// the log and asinh bins are about linear below this part of the range
+#define FITS_STATS_SAMPLE_PIXELS                     (65536) /// pixels sampled for the provisional range of the fine histogram
+#define FITS_STATS_FINE_BINS_FACTOR                  (4)     /// fine histogram bins (one per integer value) per distribution segment
+#define FITS_STATS_OUTLIERS_DIVIDER                  (64)    /// more than 1/64 of the pixels out of the provisional range
+                                                             /// are counted with a second pass
+#define FITS_PERCENTILE_SAMPLE_PIXELS                (1048576) /// evenly spaced pixels of the sampled percentiles
+#define FITS_PERCENTILE_COLLECT_LIMIT                (1048576) /// the radix selection sorts the last candidates if few are left
+#define FITS_QUICK_LOOK_SAMPLE_PIXELS                (1048576) /// evenly spaced pixels of the quick look statistics
 
 #endif // LIBNFITS_DEFS_H
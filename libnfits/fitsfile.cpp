@@ -1,23 +1,92 @@
 #include "fitsfile.h"
 
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#include <sys/stat.h>
+
 #include "defs.h"
 
 #include "image.h"
+#include "hduindex.h"
 
 namespace libnfits
 {
 
 FitsFile::FitsFile():
     m_fileName(""), m_memoryBuffer(nullptr), m_memoryDecompressedBuffer(nullptr), m_memoryBufferBak(nullptr), m_fileSize(0),
-    m_offset(0), m_callbackFunc(nullptr), m_callbackFuncParam(nullptr)
+    m_offset(0), m_bLazyDecompression(false), m_inflateProgress(nullptr), m_callbackFunc(nullptr), m_callbackFuncParam(nullptr),
+    m_ioAccessPattern(FITS_IO_ACCESS_NORMAL), m_HDUCallbackFunc(nullptr), m_HDUCallbackFuncParam(nullptr)
 {
+#ifdef ENABLE_GZIP_INDEX_SIDECAR
+    m_bGZIPIndexSidecar = true;
+#else
+    m_bGZIPIndexSidecar = false;
+#endif
+
+#ifdef ENABLE_GZIP_PIPELINED_LOADING
+    m_bGZIPPipelinedLoading = true;
+#else
+    m_bGZIPPipelinedLoading = false;
+#endif
+
+#ifdef ENABLE_FAST_HDU_SCAN
+    m_bFastHDUScan = true;
+#else
+    m_bFastHDUScan = false;
+#endif
+
+#ifdef ENABLE_HDU_INDEX_SIDECAR
+    m_bHDUIndexSidecar = true;
+#else
+    m_bHDUIndexSidecar = false;
+#endif
+
+#ifdef ENABLE_STATS_CACHE_SIDECAR
+    m_bStatsCacheSidecar = true;
+#else
+    m_bStatsCacheSidecar = false;
+#endif
 
 }
 
 FitsFile::FitsFile(const std::string& a_fileName):
     m_fileName(a_fileName), m_memoryBuffer(nullptr), m_memoryDecompressedBuffer(nullptr),  m_memoryBufferBak(nullptr), m_fileSize(0),
-    m_offset(0), m_callbackFunc(nullptr), m_callbackFuncParam(nullptr)
+    m_offset(0), m_bLazyDecompression(false), m_inflateProgress(nullptr), m_callbackFunc(nullptr), m_callbackFuncParam(nullptr),
+    m_ioAccessPattern(FITS_IO_ACCESS_NORMAL), m_HDUCallbackFunc(nullptr), m_HDUCallbackFuncParam(nullptr)
 {
+#ifdef ENABLE_GZIP_INDEX_SIDECAR
+    m_bGZIPIndexSidecar = true;
+#else
+    m_bGZIPIndexSidecar = false;
+#endif
+
+#ifdef ENABLE_GZIP_PIPELINED_LOADING
+    m_bGZIPPipelinedLoading = true;
+#else
+    m_bGZIPPipelinedLoading = false;
+#endif
+
+#ifdef ENABLE_FAST_HDU_SCAN
+    m_bFastHDUScan = true;
+#else
+    m_bFastHDUScan = false;
+#endif
+
+#ifdef ENABLE_HDU_INDEX_SIDECAR
+    m_bHDUIndexSidecar = true;
+#else
+    m_bHDUIndexSidecar = false;
+#endif
+
+#ifdef ENABLE_STATS_CACHE_SIDECAR
+    m_bStatsCacheSidecar = true;
+#else
+    m_bStatsCacheSidecar = false;
+#endif
 
 }
 
@@ -30,11 +99,22 @@ FitsFile::~FitsFile()
 
 int32_t FitsFile::loadFile(const std::string& a_fileName)
 {
-#ifdef ENABLE_FILE_MAPPING_FILE_LOADING
+    int32_t ioAccessPattern = m_ioAccessPattern;
+
+    // .gz files are inflated from the start to the end, or only partially via their sidecar index
+    if (ioAccessPattern == FITS_IO_ACCESS_NORMAL && a_fileName.ends_with(".gz"))
+    {
+        struct stat sb;
+
+        bool bIndex = m_bGZIPIndexSidecar && stat((a_fileName + FITS_GZIP_INDEX_FILE_EXTENSION).c_str(), &sb) == FITS_FILE_OPEN_STAT_SUCCESS;
+
+        ioAccessPattern = bIndex ? FITS_IO_ACCESS_RANDOM : FITS_IO_ACCESS_SEQUENTIAL;
+    }
+
+    m_mapFile.setIOAccessPattern(ioAccessPattern);
+    m_mapFile.setCallbackFunction(m_callbackFunc, m_callbackFuncParam);
+
     int32_t retVal = m_mapFile.loadFile(a_fileName);
-#else
-    int32_t retVal = m_mapFile.loadFileRead(a_fileName);
-#endif
 
     if (retVal != FITS_MEMORY_MAP_FILE_SUCCESS)
         return retVal;
@@ -48,11 +128,24 @@ int32_t FitsFile::loadFile(const std::string& a_fileName)
 
     m_fileName = a_fileName;
 
+    // the images are inserted while the HDUs are found, their statistics are looked up in the cache
+    loadStatsCache();
+
     if (isGZIPCompressed())
     {
-        size_t decSize = decompressData((const int8_t*)m_memoryBuffer, (int8_t*&)m_memoryDecompressedBuffer, m_mapFile.getFileSize());
-
         m_memoryBufferBak = m_memoryBuffer; // backup for memory mapped pointer, backup-restore of this pointer may be also used in the future
+
+        if (loadGZIPIndex() != FITS_GENERAL_SUCCESS && m_bGZIPPipelinedLoading)
+        {
+            retVal = loadGZIPFilePipelined();
+
+            // on overflow the ISIZE based buffer was too small, the file is inflated again in the regular way
+            if (retVal != FITS_GZIP_INFLATE_OVERFLOW)
+                return retVal;
+        }
+
+        size_t decSize = decompressGZIPFile();
+
         m_memoryBuffer = m_memoryDecompressedBuffer;
 
         if (decSize == 0)
@@ -74,15 +167,240 @@ int32_t FitsFile::loadFile(const std::string& a_fileName)
     return retVal;
 }
 
+int32_t FitsFile::loadGZIPIndex()
+{
+    if (!m_bGZIPIndexSidecar)
+        return FITS_GENERAL_ERROR;
+
+    return m_gzipIndex.loadFromFile(m_fileName + FITS_GZIP_INDEX_FILE_EXTENSION, m_memoryBufferBak, m_mapFile.getFileSize());
+}
+
+// With a valid sidecar index only the buffer is allocated here, the headers and payloads are inflated on demand.
+// Otherwise the whole file is inflated and the index is created along the way for the next opening.
+size_t FitsFile::decompressGZIPFile()
+{
+    size_t compressedSize = m_mapFile.getFileSize();
+    std::string indexFileName = m_fileName + FITS_GZIP_INDEX_FILE_EXTENSION;
+
+    if (m_gzipIndex.isValid())
+    {
+        m_memoryDecompressedBuffer = new (std::nothrow) uint8_t[m_gzipIndex.getDecompressedSize()];
+
+        if (m_memoryDecompressedBuffer != nullptr)
+        {
+            m_bLazyDecompression = true;
+
+            return m_gzipIndex.getDecompressedSize();
+        }
+    }
+
+    size_t decSize = decompressGZIPData((const int8_t*)m_memoryBufferBak, (int8_t*&)m_memoryDecompressedBuffer, compressedSize,
+                                        m_bGZIPIndexSidecar ? &m_gzipIndex : nullptr);
+
+    if (decSize != 0 && m_bGZIPIndexSidecar)
+        m_gzipIndex.saveToFile(indexFileName);  // failing to save the index (e.g. read-only directory) is not an error
+
+    return decSize;
+}
+
+// The file is inflated in a separate thread while the HDUs are parsed and reported as soon as their data is ready
+int32_t FitsFile::loadGZIPFilePipelined()
+{
+    GZIPInflateProgress progress;
+    int8_t* outputBuffer = nullptr;
+    int8_t* progressBuffer = nullptr;
+    size_t progressCapacity = 0;
+
+    std::thread inflateThread(decompressGZIPData, (const int8_t*)m_memoryBufferBak, std::ref(outputBuffer), m_mapFile.getFileSize(),
+                              m_bGZIPIndexSidecar ? &m_gzipIndex : nullptr, &progress);
+
+    {
+        std::unique_lock<std::mutex> lock(progress.mutex);
+        progress.condition.wait(lock, [&progress] { return progress.buffer != nullptr || progress.status != FITS_GZIP_INFLATE_RUNNING; });
+
+        progressBuffer = progress.buffer;
+        progressCapacity = progress.capacity;
+    }
+
+    if (progressBuffer != nullptr)
+    {
+        m_memoryDecompressedBuffer = (uint8_t*)progressBuffer;
+        m_memoryBuffer = m_memoryDecompressedBuffer;
+        m_fileSize = progressCapacity;   // upper bound until the inflating is finished
+        m_inflateProgress = &progress;
+
+        setOffset(0);
+
+        findAllHDUs();
+
+        // not a FITS file, no need to inflate the rest
+        if (m_HDUs.empty())
+            progress.cancel = true;
+    }
+
+    inflateThread.join();
+
+    m_inflateProgress = nullptr;
+
+    if (progress.status == FITS_GZIP_INFLATE_DONE)
+    {
+        m_fileSize = progress.availableSize;
+
+        if (m_bGZIPIndexSidecar)
+            m_gzipIndex.saveToFile(m_fileName + FITS_GZIP_INDEX_FILE_EXTENSION);  // failing to save the index is not an error
+
+        return m_HDUs.empty() ? FITS_GENERAL_ERROR : FITS_GENERAL_SUCCESS;
+    }
+
+    if (!m_HDUs.empty() && m_HDUCallbackFunc != nullptr)
+        m_HDUCallbackFunc(FITS_HDU_CALLBACK_RESET, m_HDUCallbackFuncParam);
+
+    m_HDUs.clear();
+    m_HDUDataLoaded.clear();
+
+    delete [] m_memoryDecompressedBuffer;
+    m_memoryDecompressedBuffer = nullptr;
+    m_memoryBuffer = m_memoryBufferBak;
+    m_fileSize = m_mapFile.getFileSize();
+
+    if (progress.status == FITS_GZIP_INFLATE_OVERFLOW)
+        return FITS_GZIP_INFLATE_OVERFLOW;
+
+    m_memoryBuffer = nullptr;
+
+    m_mapFile.closeFile();
+
+    return FITS_GENERAL_ERROR;
+}
+
+// Blocks until a_size bytes of the file are inflated, returns false if the inflating ended before that
+bool FitsFile::waitForData(size_t a_size)
+{
+    if (m_inflateProgress == nullptr)
+        return true;
+
+    std::unique_lock<std::mutex> lock(m_inflateProgress->mutex);
+
+    m_inflateProgress->condition.wait(lock, [this, a_size]
+                                      { return m_inflateProgress->availableSize >= a_size || m_inflateProgress->status != FITS_GZIP_INFLATE_RUNNING; });
+
+    if (m_inflateProgress->status == FITS_GZIP_INFLATE_DONE)
+        m_fileSize = m_inflateProgress->availableSize;
+
+    return m_inflateProgress->availableSize >= a_size;
+}
+
+// Making header blocks of the next HDU available, via the gzip index or by waiting for the inflating thread, until END keyword is found
+int32_t FitsFile::loadHeaderBlocks()
+{
+    size_t offset = m_offset;
+
+    while (offset + FITS_BLOCK_SIZE <= m_fileSize)
+    {
+        size_t length = FITS_BLOCK_SIZE;
+
+        if (m_bLazyDecompression)
+        {
+            length = std::min((size_t)FITS_GZIP_INDEX_HEADER_BLOCKS * FITS_BLOCK_SIZE, alignOffsetBackward(m_fileSize - offset));
+
+            if (m_gzipIndex.extract(m_memoryBufferBak, m_mapFile.getFileSize(), m_memoryDecompressedBuffer, offset, length) != FITS_GENERAL_SUCCESS)
+                return FITS_GENERAL_ERROR;
+        }
+        else if (!waitForData(offset + length))
+            return FITS_GENERAL_ERROR;
+
+        // not a header start, e.g. padding after the last HDU
+        if (offset == m_offset && std::memcmp(m_memoryBuffer + offset, FITS_KEYWORD_SIMPLE, std::strlen(FITS_KEYWORD_SIMPLE)) != 0 &&
+            std::memcmp(m_memoryBuffer + offset, FITS_KEYWORD_XTENSION, std::strlen(FITS_KEYWORD_XTENSION)) != 0)
+            return FITS_GENERAL_ERROR;
+
+        for (size_t i = offset; i < offset + length; i += FITS_HEADER_RECORD_SIZE)
+            if (std::memcmp(m_memoryBuffer + i, FITS_KEYWORD_END "     ", FITS_KEYWORD_END_POS) == 0)
+                return FITS_GENERAL_SUCCESS;
+
+        offset += length;
+    }
+
+    return FITS_GENERAL_ERROR;
+}
+
+int32_t FitsFile::loadHDUData(uint32_t a_index)
+{
+    if (a_index >= m_HDUs.size())
+        return FITS_GENERAL_ERROR;
+
+    if (!m_bLazyDecompression || m_HDUDataLoaded[a_index])
+        return FITS_GENERAL_SUCCESS;
+
+    size_t offset = m_HDUs[a_index].getOffset();
+    size_t size = std::min(m_HDUs[a_index].getSize(), m_fileSize - offset);
+
+    if (m_gzipIndex.extract(m_memoryBufferBak, m_mapFile.getFileSize(), m_memoryDecompressedBuffer, offset, size) != FITS_GENERAL_SUCCESS)
+        return FITS_GENERAL_ERROR;
+
+    m_HDUDataLoaded[a_index] = true;
+
+    return FITS_GENERAL_SUCCESS;
+}
+
+void FitsFile::setGZIPIndexSidecar(bool a_flag)
+{
+    m_bGZIPIndexSidecar = a_flag;
+}
+
+void FitsFile::setGZIPPipelinedLoading(bool a_flag)
+{
+    m_bGZIPPipelinedLoading = a_flag;
+}
+
+void FitsFile::setFastHDUScan(bool a_flag)
+{
+    m_bFastHDUScan = a_flag;
+}
+
+void FitsFile::setHDUIndexSidecar(bool a_flag)
+{
+    m_bHDUIndexSidecar = a_flag;
+}
+
+void FitsFile::setStatsCacheSidecar(bool a_flag)
+{
+    m_bStatsCacheSidecar = a_flag;
+}
+
+StatsCache& FitsFile::getStatsCache()
+{
+    return m_statsCache;
+}
+
+void FitsFile::setIOStrategy(int32_t a_ioStrategy)
+{
+    m_mapFile.setIOStrategy(a_ioStrategy);
+}
+
+void FitsFile::setIOAccessPattern(int32_t a_ioAccessPattern)
+{
+    m_ioAccessPattern = a_ioAccessPattern;
+}
+
+int32_t FitsFile::getLoadedIOStrategy() const
+{
+    return m_mapFile.getLoadedIOStrategy();
+}
+
+void FitsFile::setHDUCallbackFunction(CallbackFunctionPtr a_callbackFunc, void* a_callbackFuncParam)
+{
+    m_HDUCallbackFunc = a_callbackFunc;
+    m_HDUCallbackFuncParam = a_callbackFuncParam;
+}
+
 int32_t FitsFile::closeFile()
 {
+    saveStatsCache();
+
     m_memoryBuffer = m_memoryBufferBak;
 
-#ifdef ENABLE_FILE_MAPPING_FILE_LOADING
     int32_t resUnmap = m_mapFile.closeFile();
-#else
-    int32_t resUnmap = m_mapFile.closeFileRead();
-#endif
 
     if (resUnmap == FITS_MEMORY_MAP_FILE_SUCCESS)
         reset();
@@ -127,14 +445,15 @@ int32_t FitsFile::findHDU()
     size_t  recordIndex = 0;
     bool    bEnd = false;
     uint8_t hduType = FITS_HDU_TYPE_PRIMARY;
-    size_t  prevOffset = 0;
 
     Header  header;
     HDU     hdu;
 
-    prevOffset = m_offset;
     hdu.setOffset(m_offset);
 
+    if ((m_bLazyDecompression || m_inflateProgress != nullptr) && loadHeaderBlocks() != FITS_GENERAL_SUCCESS)
+        return FITS_HDU_OFFSET_ERROR;
+
     while (!bEnd)
     {
         HeaderRecord hRecord;
@@ -142,9 +461,8 @@ int32_t FitsFile::findHDU()
         if (m_offset > (m_fileSize - FITS_HEADER_RECORD_SIZE))
             return FITS_HDU_OFFSET_ERROR;
 
-        std::string strRecord = getStringFromBuffer(m_memoryBuffer, m_offset);
-
-        hRecord.setData(strRecord);
+        // the record refers to the file buffer, no copy is made
+        hRecord.setRecordView(std::string_view((const char*)m_memoryBuffer + m_offset, FITS_HEADER_RECORD_SIZE));
         int32_t parseRes = hRecord.parse();
 
         if (parseRes != FITS_GENERAL_SUCCESS)
@@ -154,9 +472,8 @@ int32_t FitsFile::findHDU()
         // it should be either 'SIMPLE' or 'XTENSION' for the beginning of the header.
         // Otherwise we are not at the header start position which is wrong.
         // Or we continue identifying the correct image type
-        std::string keyword = hRecord.getKeyword();
-        std::string value = hRecord.getValueString();
-        trimStringLeftRight(value, FITS_QUOTE_CHAR); // This quotation stripping is added here because we skipped stripping in header parsing
+        std::string_view keyword = hRecord.getKeywordView();
+        std::string_view value = trimStringViewLeftRight(hRecord.getValueView(), FITS_QUOTE_CHAR); // This quotation stripping is added here because we skipped stripping in header parsing
                                                      // in order to have 'VALUE' syntax in the header output.
                                                      // Commented trimStringLeftRight(strValue, FITS_QUOTE_CHAR); in headerrecord.cpp
 
@@ -180,43 +497,178 @@ int32_t FitsFile::findHDU()
             bEnd = true;
     }
 
-    m_offset = alignOffsetForward(m_offset);
-
     hdu.addHeader(header);
     hdu.setType(hduType);
 
-    hdu.setData(m_memoryBuffer + hdu.getOffset());
-    if (header.getNAXIS() != 0)
+    bool bSuccess = false;
+    int64_t pcount = header.getKeywordValue<int64_t>(FITS_KEYWORD_PCOUNT, bSuccess);
+
+    if (!bSuccess)
+        pcount = 0;
+
+    int64_t gcount = header.getKeywordValue<int64_t>(FITS_KEYWORD_GCOUNT, bSuccess);
+
+    if (!bSuccess)
+        gcount = 1;
+
+    addHDU(hdu, m_offset, pcount, gcount);
+
+    return retVal;
+}
+
+// Locates the next HDU reading only the structural keywords of its header, the other records are parsed when the header
+// is requested. The keyword field of each card is compared as one 8-byte integer, END is found the same way.
+int32_t FitsFile::scanHDU()
+{
+    static const uint64_t fieldEnd = getKeywordField(FITS_KEYWORD_END);
+    static const uint64_t fieldSimple = getKeywordField(FITS_KEYWORD_SIMPLE);
+    static const uint64_t fieldXtension = getKeywordField(FITS_KEYWORD_XTENSION);
+    static const uint64_t fieldBitpix = getKeywordField(FITS_KEYWORD_BITPIX);
+    static const uint64_t fieldNaxis = getKeywordField(FITS_KEYWORD_NAXIS);
+    static const uint64_t fieldPcount = getKeywordField(FITS_KEYWORD_PCOUNT);
+    static const uint64_t fieldGcount = getKeywordField(FITS_KEYWORD_GCOUNT);
+
+    const size_t naxisLength = std::strlen(FITS_KEYWORD_NAXIS);
+
+    uint8_t hduType = FITS_HDU_TYPE_PRIMARY;
+    int32_t bitpix = FITS_RECORD_NOT_FOUND;
+    int32_t naxis = FITS_RECORD_NOT_FOUND;
+    int64_t pcount = 0;
+    int64_t gcount = 1;
+    std::vector<int64_t> axisValues;
+
+    HDU hdu;
+
+    hdu.setOffset(m_offset);
+
+    if ((m_bLazyDecompression || m_inflateProgress != nullptr) && loadHeaderBlocks() != FITS_GENERAL_SUCCESS)
+        return FITS_HDU_OFFSET_ERROR;
+
+    for (size_t recordIndex = 0; ; ++recordIndex, m_offset += FITS_HEADER_RECORD_SIZE)
+    {
+        if (m_offset > (m_fileSize - FITS_HEADER_RECORD_SIZE))
+            return FITS_HDU_OFFSET_ERROR;
+
+        std::string_view record((const char*)m_memoryBuffer + m_offset, FITS_HEADER_RECORD_SIZE);
+        uint64_t field = getKeywordField(record);
+
+        if (recordIndex == 0 && field != fieldSimple && field != fieldXtension)
+            return FITS_HDU_START_ERROR;
+
+        if (field == fieldEnd)
+            break;
+
+        bool bNaxisN = field != fieldNaxis && record.starts_with(FITS_KEYWORD_NAXIS) && std::isdigit((uint8_t)record[naxisLength]);
+
+        if (field != fieldXtension && field != fieldBitpix && field != fieldNaxis && field != fieldPcount &&
+            field != fieldGcount && !bNaxisN)
+            continue;
+
+        HeaderRecord hRecord;
+
+        hRecord.setRecordView(record);
+
+        if (hRecord.parse() != FITS_GENERAL_SUCCESS)
+            return FITS_RECORD_SYNTAX_ERROR;
+
+        if (field == fieldXtension)
+        {
+            std::string_view value = trimStringViewLeftRight(hRecord.getValueView(), FITS_QUOTE_CHAR);
+
+            if (value == FITS_XTENSION_IMAGE)
+                hduType = FITS_HDU_TYPE_IMAGE_XTENSION;
+            else if (value == FITS_XTENSION_TABLE)
+                hduType = FITS_HDU_TYPE_ASCII_TABLE_XTENSION;
+            else if (value == FITS_XTENSION_BINTABLE)
+                hduType = FITS_HDU_TYPE_BINARY_TABLE_XTENSION;
+
+            continue;
+        }
+
+        bool bSuccess = false;
+        int64_t value = convertStringViewNumber<int64_t>(hRecord.getValueView(), bSuccess);
+
+        if (!bSuccess)
+            continue;
+
+        if (field == fieldBitpix)
+            bitpix = value;
+        else if (field == fieldNaxis)
+            naxis = value;
+        else if (field == fieldPcount)
+            pcount = value;
+        else if (field == fieldGcount)
+            gcount = value;
+        else
+        {
+            size_t axisIndex = 0;
+            std::string_view axisNumber = trimStringViewRight(hRecord.getKeywordView().substr(naxisLength), FITS_PADDING_SPACE_CHAR);
+            std::from_chars_result res = std::from_chars(axisNumber.data(), axisNumber.data() + axisNumber.length(), axisIndex);
+
+            if (res.ec != std::errc() || res.ptr != axisNumber.data() + axisNumber.length() || axisIndex == 0)
+                continue;
+
+            if (axisValues.size() < axisIndex)
+                axisValues.resize(axisIndex, FITS_RECORD_NOT_FOUND);
+
+            axisValues[axisIndex - 1] = value;
+        }
+    }
+
+    std::vector<uint32_t> axises;
+
+    for (int32_t i = 0; i < naxis && i < (int32_t)axisValues.size(); ++i)
+        if (axisValues[i] != FITS_RECORD_NOT_FOUND)
+            axises.push_back(axisValues[i]);
+
+    // moving after the END record
+    m_offset += FITS_HEADER_RECORD_SIZE;
+
+    hdu.setDeferredHeader(bitpix, naxis, axises);
+    hdu.setType(hduType);
+
+    addHDU(hdu, m_offset, pcount, gcount);
+
+    return FITS_GENERAL_SUCCESS;
+}
+
+// Sets the payload and the size of the HDU with the parsed header and appends it, m_offset is moved to the next HDU
+void FitsFile::addHDU(HDU& a_hdu, size_t a_headerEndOffset, int64_t a_pcount, int64_t a_gcount)
+{
+    m_offset = alignOffsetForward(a_headerEndOffset);
+
+    a_hdu.setData(m_memoryBuffer + a_hdu.getOffset());
+    a_hdu.setHeaderSize(a_headerEndOffset - a_hdu.getOffset());
+
+    if (a_hdu.getNaxis() != 0)
     {
-        hdu.setPaylod(m_memoryBuffer + m_offset);
-        hdu.setPayloadOffset(m_offset);
+        a_hdu.setPaylod(m_memoryBuffer + m_offset);
+        a_hdu.setPayloadOffset(m_offset);
     }
 
-    // Calculating the amount of real data after the header
-    bool bSucess = false;
-    int32_t naxis = header.getNAXIS();
-    int32_t bitpix = std::abs(header.getBITPIX()) / 8;  // number of bytes for one entry
-    size_t size = naxis ? bitpix : 0;
+    // Calculating the amount of real data after the header: |BITPIX| * GCOUNT * (PCOUNT + NAXIS1 * ... * NAXISn)
+    int32_t bitpix = std::abs(a_hdu.getBitpix()) / 8;  // number of bytes for one entry
+    size_t size = 0;
 
-    for (int32_t i = 1; i <= naxis; ++i)
+    if (a_hdu.getNaxis() != 0)
     {
-        int32_t tmpSize = header.getKeywordValue<int32_t>(FITS_KEYWORD_NAXIS + std::to_string(i), bSucess);
+        size = 1;
+
+        for (uint32_t axis : a_hdu.getAxises())
+            size = size * axis;
 
-        if (bSucess)
-            size = size * tmpSize;
+        size = bitpix * a_gcount * (a_pcount + size);
     }
-    //
 
     // added to fix the missing miltiple HDU bug and wrong HDU sizes bug
     m_offset += size;
     m_offset = alignOffsetForward(m_offset);
 
-    hdu.setSize(m_offset - prevOffset);
+    a_hdu.setSize(m_offset - a_hdu.getOffset());
     // end of bugfixes
 
-    m_HDUs.push_back(hdu);
-
-    return retVal;
+    m_HDUs.push_back(std::move(a_hdu));
+    m_HDUDataLoaded.push_back(!m_bLazyDecompression);
 }
 
 int32_t FitsFile::findPrimaryHDU()
@@ -232,16 +684,151 @@ int32_t FitsFile::findAllHDUs()
 
     m_offset = 0;
 
+    // the HDUs of an unchanged file are taken from its sidecar index without reading the headers
+    if (loadHDUIndex() == FITS_GENERAL_SUCCESS)
+    {
+        m_offset = m_HDUs.back().getOffset() + m_HDUs.back().getSize();
+
+        if (m_HDUCallbackFunc != nullptr)
+            for (uint32_t i = 0; i < m_HDUs.size(); ++i)
+                m_HDUCallbackFunc(i, m_HDUCallbackFuncParam);
+
+        return FITS_GENERAL_SUCCESS;
+    }
+
     do
     {
-        tmpVal = findHDU();
+        tmpVal = m_bFastHDUScan ? scanHDU() : findHDU();
+
+        if (tmpVal == FITS_GENERAL_SUCCESS)
+        {
+            const HDU& hdu = m_HDUs.back();
+
+            // The HDU is reported only when it is completely inflated. If the inflating fails, the reported HDUs are reset
+            // and this one is never shown. A file ending inside the HDU is truncated, the HDU is kept as in the regular loading.
+            if (!waitForData(hdu.getOffset() + hdu.getSize()))
+            {
+                if (m_inflateProgress->status == FITS_GZIP_INFLATE_DONE && m_HDUCallbackFunc != nullptr)
+                    m_HDUCallbackFunc(m_HDUs.size() - 1, m_HDUCallbackFuncParam);
+
+                break;
+            }
+
+            if (m_HDUCallbackFunc != nullptr)
+                m_HDUCallbackFunc(m_HDUs.size() - 1, m_HDUCallbackFuncParam);
+        }
     }
     while (tmpVal == FITS_GENERAL_SUCCESS);
 
     if (m_HDUs.size() == 0)
         return FITS_GENERAL_ERROR;
-    else
-        return FITS_GENERAL_SUCCESS;
+
+    saveHDUIndex();
+
+    return FITS_GENERAL_SUCCESS;
+}
+
+int32_t FitsFile::loadHDUIndex()
+{
+    // during pipelined inflating the HDUs are found as the data arrives anyway
+    if (!m_bHDUIndexSidecar || m_inflateProgress != nullptr)
+        return FITS_GENERAL_ERROR;
+
+    HDUIndex index;
+    size_t fileSize = m_mapFile.getFileSize();
+    uint64_t blockHash = HDUIndex::hashBlock(m_mapFile.getMappedFileBuffer(), std::min(fileSize, (size_t)FITS_BLOCK_SIZE));
+
+    if (index.loadFromFile(m_fileName + FITS_HDU_INDEX_FILE_EXTENSION, fileSize, HDUIndex::getModificationTime(m_fileName), blockHash,
+                           m_fileSize) != FITS_GENERAL_SUCCESS)
+        return FITS_GENERAL_ERROR;
+
+    for (const HDUIndexEntry& entry : index.getEntries())
+    {
+        // the headers are parsed on demand, with lazy decompression they must be inflated for that
+        if (m_bLazyDecompression &&
+            m_gzipIndex.extract(m_memoryBufferBak, fileSize, m_memoryDecompressedBuffer, entry.offset, entry.headerSize) != FITS_GENERAL_SUCCESS)
+        {
+            m_HDUs.clear();
+            m_HDUDataLoaded.clear();
+
+            return FITS_GENERAL_ERROR;
+        }
+
+        HDU hdu;
+
+        hdu.setOffset(entry.offset);
+        hdu.setData(m_memoryBuffer + entry.offset);
+        hdu.setHeaderSize(entry.headerSize);
+        hdu.setDeferredHeader(entry.bitpix, entry.naxis, entry.axises);
+        hdu.setType(entry.type);
+
+        if (entry.naxis != 0)
+        {
+            hdu.setPaylod(m_memoryBuffer + entry.payloadOffset);
+            hdu.setPayloadOffset(entry.payloadOffset);
+        }
+
+        hdu.setSize(entry.size);
+
+        m_HDUs.push_back(std::move(hdu));
+        m_HDUDataLoaded.push_back(!m_bLazyDecompression);
+    }
+
+    return FITS_GENERAL_SUCCESS;
+}
+
+void FitsFile::saveHDUIndex() const
+{
+    // the HDUs found while inflating may still be reset, small files are fast to scan without an index
+    if (!m_bHDUIndexSidecar || m_inflateProgress != nullptr || m_HDUs.size() < FITS_HDU_INDEX_MIN_HDUS)
+        return;
+
+    HDUIndex index;
+    size_t fileSize = m_mapFile.getFileSize();
+    uint64_t blockHash = HDUIndex::hashBlock(m_mapFile.getMappedFileBuffer(), std::min(fileSize, (size_t)FITS_BLOCK_SIZE));
+
+    index.setFileInfo(fileSize, HDUIndex::getModificationTime(m_fileName), blockHash, m_fileSize);
+
+    for (const HDU& hdu : m_HDUs)
+    {
+        HDUIndexEntry entry;
+
+        entry.offset = hdu.getOffset();
+        entry.payloadOffset = hdu.getPayloadOffset();
+        entry.size = hdu.getSize();
+        entry.headerSize = hdu.getHeaderSize();
+        entry.type = hdu.getType();
+        entry.bitpix = hdu.getBitpix();
+        entry.naxis = hdu.getNaxis();
+        entry.axises = hdu.getAxises();
+
+        index.addEntry(entry);
+    }
+
+    index.saveToFile(m_fileName + FITS_HDU_INDEX_FILE_EXTENSION);  // failing to save the index (e.g. read-only directory) is not an error
+}
+
+// The cache is kept for the file on disk, for .gz files too, the payloads are validated by their hashes
+void FitsFile::loadStatsCache()
+{
+    m_statsCache.reset();
+
+    if (!m_bStatsCacheSidecar)
+        return;
+
+    size_t fileSize = m_mapFile.getFileSize();
+    uint64_t blockHash = HDUIndex::hashBlock(m_mapFile.getMappedFileBuffer(), std::min(fileSize, (size_t)FITS_BLOCK_SIZE));
+
+    m_statsCache.loadFromFile(m_fileName + FITS_STATS_CACHE_FILE_EXTENSION, fileSize, HDUIndex::getModificationTime(m_fileName),
+                              blockHash);
+}
+
+void FitsFile::saveStatsCache()
+{
+    if (!m_bStatsCacheSidecar || !m_statsCache.isModified())
+        return;
+
+    m_statsCache.saveToFile(m_fileName + FITS_STATS_CACHE_FILE_EXTENSION);
 }
 
 void FitsFile::reset()
@@ -254,8 +841,15 @@ void FitsFile::reset()
     m_fileSize = 0;
     m_offset = 0;
     m_callbackFunc = nullptr;
+    m_HDUCallbackFunc = nullptr;
     m_HDUs.clear();
 
+    m_gzipIndex.reset();
+    m_bLazyDecompression = false;
+    m_HDUDataLoaded.clear();
+
+    m_statsCache.reset();
+
     //m_mapFile.closeFile();
     m_memoryBuffer = nullptr;
 }
@@ -272,12 +866,15 @@ int32_t FitsFile::exportImageHDU(uint32_t a_hduIndex, int32_t a_transform, bool
     if ((HDUtype != FITS_HDU_TYPE_PRIMARY && HDUtype != FITS_HDU_TYPE_IMAGE_XTENSION) || (axisesNumber < 2 || !bSuccess))
         return FITS_PNG_HDU_NOT_IMAGE_ERROR;
 
+    if (loadHDUData(a_hduIndex) != FITS_GENERAL_SUCCESS)
+        return FITS_PNG_EXPORT_ERROR;
+
     Image           image;
     std::string     fileName;
 
     fileName = m_fileName + "." + formatNumberString(a_hduIndex, 10) + ".png";
 
-    std::vector<uint32_t> axises = m_HDUs[a_hduIndex].getAxises();
+    const std::vector<uint32_t>& axises = m_HDUs[a_hduIndex].getAxises();
 
     if (axises.size() < 2)
         return FITS_PNG_HDU_NOT_IMAGE_ERROR;
@@ -292,12 +889,18 @@ int32_t FitsFile::exportImageHDU(uint32_t a_hduIndex, int32_t a_transform, bool
     long double bzero = m_HDUs[a_hduIndex].getKeywordValue<long double>(FITS_KEYWORD_BZERO, bZSuccess);
     long double bscale = m_HDUs[a_hduIndex].getKeywordValue<long double>(FITS_KEYWORD_BSCALE, bSSuccess);
 
+    bool bBSuccess = false;
+    int64_t blank = m_HDUs[a_hduIndex].getKeywordValue<int64_t>(FITS_KEYWORD_BLANK, bBSuccess);
+
     image.setParameters(axises[0], axises[1], FITS_PNG_DEFAULT_PIXEL_DEPTH, bitpix);
     image.setData(m_HDUs[a_hduIndex].getPayload());
     image.setMaxDataBufferSize(m_fileSize);
     image.setBaseOffset(m_HDUs[a_hduIndex].getPayloadOffset());
     image.setCallbackFunction(m_callbackFunc, m_callbackFuncParam);
 
+    if (bBSuccess)
+        image.setBlankValue(blank);
+
     if (bitpix == -64)
             image.calcBufferMinMax<double>();
     else if (bitpix == 64)
@@ -353,6 +956,17 @@ int32_t FitsFile::getHDU(uint32_t a_index, HDU& a_hdu) const
      return FITS_GENERAL_SUCCESS;
 }
 
+// No copy is made, the pointer is valid until the file is closed or reloaded
+int32_t FitsFile::getHDU(uint32_t a_index, const HDU*& a_hdu) const
+{
+     if (a_index >= m_HDUs.size())
+         return FITS_GENERAL_ERROR;
+
+     a_hdu = &m_HDUs[a_index];
+
+     return FITS_GENERAL_SUCCESS;
+}
+
 std::string FitsFile::getFileName() const
 {
     return m_fileName;
@@ -365,7 +979,7 @@ bool FitsFile::isOpen() const
 
 bool FitsFile::isGZIPCompressed() const
 {
-    return (*(uint16_t*)m_memoryBuffer) == 0x8b1f ? true : false;
+    return (*(uint16_t*)m_memoryBuffer) == FITS_GZIP_MAGIC ? true : false;
 }
 
 }
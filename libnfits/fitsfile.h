@@ -4,6 +4,8 @@
 #include <string>
 #include "helperio.h"
 #include "hdu.h"
+#include "gzipindex.h"
+#include "statscache.h"
 
 namespace libnfits
 {
@@ -21,13 +23,41 @@ private:
 
     std::vector<HDU>    m_HDUs;
 
+    GZIPIndex           m_gzipIndex;
+    bool                m_bGZIPIndexSidecar;
+    bool                m_bLazyDecompression;      /// HDU payloads are inflated on demand via the gzip index
+    std::vector<bool>   m_HDUDataLoaded;
+
+    bool                m_bGZIPPipelinedLoading;
+    bool                m_bFastHDUScan;            /// headers are parsed on demand, only the structural keywords are read
+    bool                m_bHDUIndexSidecar;
+    StatsCache          m_statsCache;
+    bool                m_bStatsCacheSidecar;
+    GZIPInflateProgress* m_inflateProgress;         /// set only while HDUs are parsed during inflating
+
     CallbackFunctionPtr m_callbackFunc;
     void*               m_callbackFuncParam;
 
+    int32_t             m_ioAccessPattern;         /// FITS_IO_ACCESS_NORMAL means it is guessed from the file
+
+    CallbackFunctionPtr m_HDUCallbackFunc;          /// called with the index of each HDU as soon as it is available
+    void*               m_HDUCallbackFuncParam;
+
 private:
     int32_t findHDU();
+    int32_t scanHDU();
+    void addHDU(HDU& a_hdu, size_t a_headerEndOffset, int64_t a_pcount, int64_t a_gcount);
+    int32_t loadHDUIndex();
+    void saveHDUIndex() const;
+    void loadStatsCache();
+    void saveStatsCache();
     int32_t findAllHDUs();
     int32_t findPrimaryHDU();
+    int32_t loadHeaderBlocks();
+    int32_t loadGZIPIndex();
+    size_t decompressGZIPFile();
+    int32_t loadGZIPFilePipelined();
+    bool waitForData(size_t a_size);
     void reset();
 
 public:
@@ -45,9 +75,21 @@ public:
     int32_t exportAllImageHDUs(int32_t a_transform = FITS_FLOAT_DOUBLE_NO_TRANSFORM, bool a_gray = false);
     void setCallbackFunction(CallbackFunctionPtr a_callbackFunc, void* a_callbackFuncParam);
     int32_t getHDU(uint32_t a_index, HDU& a_hdu) const;
+    int32_t getHDU(uint32_t a_index, const HDU*& a_hdu) const;
     std::string getFileName() const;
     bool isOpen() const;
     bool isGZIPCompressed() const;
+    void setGZIPIndexSidecar(bool a_flag = true);
+    void setGZIPPipelinedLoading(bool a_flag = true);
+    void setFastHDUScan(bool a_flag = true);
+    void setHDUIndexSidecar(bool a_flag = true);
+    void setStatsCacheSidecar(bool a_flag = true);
+    StatsCache& getStatsCache();
+    void setHDUCallbackFunction(CallbackFunctionPtr a_callbackFunc, void* a_callbackFuncParam);
+    int32_t loadHDUData(uint32_t a_index);
+    void setIOStrategy(int32_t a_ioStrategy);
+    void setIOAccessPattern(int32_t a_ioAccessPattern);
+    int32_t getLoadedIOStrategy() const;
 };
 
 }
@@ -0,0 +1,317 @@
+#include "gzipindex.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <zlib.h>
+
+namespace libnfits
+{
+
+GZIPIndex::GZIPIndex():
+    m_span(FITS_GZIP_INDEX_SPAN_SIZE), m_compressedSize(0), m_decompressedSize(0), m_trailer(0), m_stream(nullptr),
+    m_bRawStream(false), m_streamStartOffset(0), m_streamInOffset(0), m_streamOutOffset(0)
+{
+
+}
+
+GZIPIndex::~GZIPIndex()
+{
+    reset();
+}
+
+void GZIPIndex::reset()
+{
+    closeStream();
+
+    m_points.clear();
+    m_compressedSize = 0;
+    m_decompressedSize = 0;
+    m_trailer = 0;
+}
+
+void GZIPIndex::setSpan(size_t a_span)
+{
+    m_span = a_span;
+}
+
+size_t GZIPIndex::getSpan() const
+{
+    return m_span;
+}
+
+size_t GZIPIndex::getNumberOfPoints() const
+{
+    return m_points.size();
+}
+
+size_t GZIPIndex::getDecompressedSize() const
+{
+    return m_decompressedSize;
+}
+
+bool GZIPIndex::isValid() const
+{
+    return !m_points.empty() && m_decompressedSize > 0;
+}
+
+uint64_t GZIPIndex::readTrailer(const uint8_t* a_inputBuffer, size_t a_inputSize)
+{
+    uint64_t trailer = 0;
+
+    if (a_inputSize >= FITS_GZIP_MIN_SIZE)
+        std::memcpy(&trailer, a_inputBuffer + a_inputSize - sizeof(trailer), sizeof(trailer));
+
+    return trailer;
+}
+
+int32_t GZIPIndex::addPoint(size_t a_inOffset, size_t a_outOffset, int32_t a_bits, const uint8_t* a_outputBuffer)
+{
+    // the first point is always added, the others only every m_span bytes of the decompressed data
+    if (!m_points.empty() && a_outOffset - m_points.back().outOffset < m_span)
+        return FITS_GENERAL_ERROR;
+
+    GZIPAccessPoint point;
+
+    point.inOffset = a_inOffset;
+    point.outOffset = a_outOffset;
+    point.bits = a_bits;
+
+    // member start points don't need the history window
+    if (a_bits != FITS_GZIP_MEMBER_START)
+    {
+        size_t windowSize = std::min(a_outOffset, (size_t)FITS_GZIP_WINDOW_SIZE);
+        point.window.assign(a_outputBuffer + a_outOffset - windowSize, a_outputBuffer + a_outOffset);
+    }
+
+    m_points.push_back(std::move(point));
+
+    return FITS_GENERAL_SUCCESS;
+}
+
+void GZIPIndex::finalize(const uint8_t* a_inputBuffer, size_t a_inputSize, size_t a_decompressedSize)
+{
+    m_compressedSize = a_inputSize;
+    m_decompressedSize = a_decompressedSize;
+    m_trailer = readTrailer(a_inputBuffer, a_inputSize);
+}
+
+int32_t GZIPIndex::openStream(const uint8_t* a_inputBuffer, const GZIPAccessPoint& a_point)
+{
+    closeStream();
+
+    m_stream = new z_stream;
+    std::memset(m_stream, 0, sizeof(z_stream));
+
+    m_bRawStream = a_point.bits != FITS_GZIP_MEMBER_START;
+
+    if (inflateInit2(m_stream, m_bRawStream ? -MAX_WBITS : 16 + MAX_WBITS) != Z_OK)
+    {
+        delete m_stream;
+        m_stream = nullptr;
+
+        return FITS_GENERAL_ERROR;
+    }
+
+    if (m_bRawStream)
+    {
+        if (a_point.bits > 0)
+            inflatePrime(m_stream, a_point.bits, a_inputBuffer[a_point.inOffset - 1] >> (8 - a_point.bits));
+
+        if (!a_point.window.empty())
+            inflateSetDictionary(m_stream, a_point.window.data(), a_point.window.size());
+    }
+
+    m_streamStartOffset = a_point.outOffset;
+    m_streamInOffset = a_point.inOffset;
+    m_streamOutOffset = a_point.outOffset;
+
+    return FITS_GENERAL_SUCCESS;
+}
+
+void GZIPIndex::closeStream()
+{
+    if (m_stream == nullptr)
+        return;
+
+    inflateEnd(m_stream);
+
+    delete m_stream;
+    m_stream = nullptr;
+}
+
+// Inflates the data up to a_offset + a_length, continuing the open stream if it is closer to a_offset than the nearest
+// access point. a_outputBuffer must be the whole decompressed file buffer (the same one for all calls): the data from
+// the starting position up to a_offset is written into it as well, so the already decompressed parts stay unchanged.
+int32_t GZIPIndex::extract(const uint8_t* a_inputBuffer, size_t a_inputSize, uint8_t* a_outputBuffer, size_t a_offset, size_t a_length)
+{
+    if (!isValid() || a_length == 0 || a_offset + a_length > m_decompressedSize || a_inputSize != m_compressedSize)
+        return FITS_GENERAL_ERROR;
+
+    size_t endOffset = a_offset + a_length;
+
+    // the data is already in the buffer from the previous requests
+    if (m_stream != nullptr && m_streamStartOffset <= a_offset && endOffset <= m_streamOutOffset)
+        return FITS_GENERAL_SUCCESS;
+
+    auto it = std::upper_bound(m_points.begin(), m_points.end(), a_offset,
+                               [](size_t a_value, const GZIPAccessPoint& a_point) { return a_value < a_point.outOffset; });
+
+    if (it == m_points.begin())
+        return FITS_GENERAL_ERROR;
+
+    --it;
+
+    bool bContinue = m_stream != nullptr && m_streamStartOffset <= a_offset && m_streamOutOffset >= it->outOffset;
+
+    if (!bContinue && openStream(a_inputBuffer, *it) != FITS_GENERAL_SUCCESS)
+        return FITS_GENERAL_ERROR;
+
+    int32_t res = Z_OK;
+
+    while (m_streamOutOffset < endOffset)
+    {
+        if (m_stream->avail_in == 0)
+        {
+            if (m_streamInOffset >= a_inputSize)
+                break;
+
+            m_stream->next_in = (Bytef*)(a_inputBuffer + m_streamInOffset);
+            m_stream->avail_in = (uInt)std::min(a_inputSize - m_streamInOffset, FITS_GZIP_INFLATE_BLOCK_SIZE);
+            m_streamInOffset += m_stream->avail_in;
+        }
+
+        m_stream->next_out = (Bytef*)(a_outputBuffer + m_streamOutOffset);
+        m_stream->avail_out = (uInt)std::min(endOffset - m_streamOutOffset, FITS_GZIP_INFLATE_BLOCK_SIZE);
+
+        uInt availOut = m_stream->avail_out;
+
+        res = inflate(m_stream, Z_NO_FLUSH);
+
+        m_streamOutOffset += availOut - m_stream->avail_out;
+
+        if (res == Z_STREAM_END)
+        {
+            // raw inflating stops before the member trailer, the next member is inflated with the gzip header
+            size_t memberOffset = m_streamInOffset - m_stream->avail_in + (m_bRawStream ? 2 * sizeof(uint32_t) : 0);
+
+            if (memberOffset + FITS_GZIP_MIN_SIZE > a_inputSize || *(const uint16_t*)(a_inputBuffer + memberOffset) != FITS_GZIP_MAGIC)
+                break;
+
+            inflateReset2(m_stream, 16 + MAX_WBITS);
+            m_bRawStream = false;
+
+            m_stream->next_in = (Bytef*)(a_inputBuffer + memberOffset);
+            m_stream->avail_in = (uInt)std::min(a_inputSize - memberOffset, FITS_GZIP_INFLATE_BLOCK_SIZE);
+            m_streamInOffset = memberOffset + m_stream->avail_in;
+        }
+        else if (res != Z_OK && res != Z_BUF_ERROR)
+            break;
+    }
+
+    if (m_streamOutOffset < endOffset)
+    {
+        closeStream();
+
+        return FITS_GENERAL_ERROR;
+    }
+
+    return FITS_GENERAL_SUCCESS;
+}
+
+int32_t GZIPIndex::saveToFile(const std::string& a_fileName) const
+{
+    if (!isValid())
+        return FITS_GENERAL_ERROR;
+
+    std::ofstream file(a_fileName, std::ios::binary | std::ios::trunc);
+
+    if (!file)
+        return FITS_GENERAL_ERROR;
+
+    uint64_t header[5] = { m_compressedSize, m_decompressedSize, m_trailer, m_span, m_points.size() };
+
+    file.write(FITS_GZIP_INDEX_FILE_SIGNATURE, std::strlen(FITS_GZIP_INDEX_FILE_SIGNATURE));
+    file.write((const char*)header, sizeof(header));
+
+    for (const GZIPAccessPoint& point : m_points)
+    {
+        uint64_t offsets[2] = { point.inOffset, point.outOffset };
+        int32_t pointInfo[2] = { point.bits, (int32_t)point.window.size() };
+
+        file.write((const char*)offsets, sizeof(offsets));
+        file.write((const char*)pointInfo, sizeof(pointInfo));
+        file.write((const char*)point.window.data(), point.window.size());
+    }
+
+    return file.good() ? FITS_GENERAL_SUCCESS : FITS_GENERAL_ERROR;
+}
+
+// The index is accepted only if it was created for the same compressed data, checked by size and the last gzip trailer
+int32_t GZIPIndex::loadFromFile(const std::string& a_fileName, const uint8_t* a_inputBuffer, size_t a_inputSize)
+{
+    reset();
+
+    std::ifstream file(a_fileName, std::ios::binary);
+
+    if (!file)
+        return FITS_GENERAL_ERROR;
+
+    char signature[sizeof(FITS_GZIP_INDEX_FILE_SIGNATURE)] = {};
+    uint64_t header[5] = {};
+
+    file.read(signature, std::strlen(FITS_GZIP_INDEX_FILE_SIGNATURE));
+    file.read((char*)header, sizeof(header));
+
+    if (!file || std::strcmp(signature, FITS_GZIP_INDEX_FILE_SIGNATURE) != 0 ||
+        header[0] != a_inputSize || header[2] != readTrailer(a_inputBuffer, a_inputSize) || header[4] == 0)
+        return FITS_GENERAL_ERROR;
+
+    for (uint64_t i = 0; i < header[4]; ++i)
+    {
+        GZIPAccessPoint point;
+        uint64_t offsets[2];
+        int32_t pointInfo[2];
+
+        file.read((char*)offsets, sizeof(offsets));
+        file.read((char*)pointInfo, sizeof(pointInfo));
+
+        //// the bits are -1 for a member start or 0..7 taken from the byte before inOffset,
+        //// the points are in the order of the stream
+        bool bValidBits = pointInfo[0] == FITS_GZIP_MEMBER_START || (pointInfo[0] >= 0 && pointInfo[0] <= 7);
+        bool bOrdered = m_points.empty() || (offsets[0] >= m_points.back().inOffset && offsets[1] >= m_points.back().outOffset);
+
+        if (!file || offsets[0] > a_inputSize || offsets[1] > header[1] || pointInfo[1] < 0 || pointInfo[1] > FITS_GZIP_WINDOW_SIZE ||
+            !bValidBits || (pointInfo[0] > 0 && offsets[0] == 0) || !bOrdered)
+        {
+            reset();
+
+            return FITS_GENERAL_ERROR;
+        }
+
+        point.inOffset = offsets[0];
+        point.outOffset = offsets[1];
+        point.bits = pointInfo[0];
+        point.window.resize(pointInfo[1]);
+
+        file.read((char*)point.window.data(), point.window.size());
+
+        m_points.push_back(std::move(point));
+    }
+
+    if (!file)
+    {
+        reset();
+
+        return FITS_GENERAL_ERROR;
+    }
+
+    m_compressedSize = header[0];
+    m_decompressedSize = header[1];
+    m_trailer = header[2];
+    m_span = header[3];
+
+    return FITS_GENERAL_SUCCESS;
+}
+
+}
@@ -0,0 +1,68 @@
+#ifndef LIBNFITS_GZIPINDEX_H
+#define LIBNFITS_GZIPINDEX_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "defs.h"
+
+struct z_stream_s;
+
+namespace libnfits
+{
+
+// Access point of the gzip stream from which inflating can be started without decoding the preceding data
+struct GZIPAccessPoint
+{
+    size_t                  inOffset;       /// offset of the first full compressed byte
+    size_t                  outOffset;      /// corresponding offset in the decompressed data
+    int32_t                 bits;           /// bits of the byte before inOffset still to be used, or FITS_GZIP_MEMBER_START
+    std::vector<uint8_t>    window;         /// last up to 32 KB of the decompressed data before outOffset
+};
+
+// zran-style checkpoint index of a gzip file, used for decompressing parts of .fits.gz files on demand
+class GZIPIndex
+{
+private:
+    std::vector<GZIPAccessPoint>    m_points;
+    size_t                          m_span;
+    size_t                          m_compressedSize;
+    size_t                          m_decompressedSize;
+    uint64_t                        m_trailer;          /// CRC32 and ISIZE of the last member, used for validation
+
+    // The last used inflate stream is kept open, so sequential requests continue from where the previous one stopped
+    z_stream_s*                     m_stream;
+    bool                            m_bRawStream;
+    size_t                          m_streamStartOffset;
+    size_t                          m_streamInOffset;
+    size_t                          m_streamOutOffset;
+
+private:
+    static uint64_t readTrailer(const uint8_t* a_inputBuffer, size_t a_inputSize);
+
+    int32_t openStream(const uint8_t* a_inputBuffer, const GZIPAccessPoint& a_point);
+    void closeStream();
+
+public:
+    GZIPIndex();
+    ~GZIPIndex();
+
+    void reset();
+    void setSpan(size_t a_span);
+    size_t getSpan() const;
+    size_t getNumberOfPoints() const;
+    size_t getDecompressedSize() const;
+    bool isValid() const;
+
+    int32_t addPoint(size_t a_inOffset, size_t a_outOffset, int32_t a_bits, const uint8_t* a_outputBuffer);
+    void finalize(const uint8_t* a_inputBuffer, size_t a_inputSize, size_t a_decompressedSize);
+
+    int32_t extract(const uint8_t* a_inputBuffer, size_t a_inputSize, uint8_t* a_outputBuffer, size_t a_offset, size_t a_length);
+
+    int32_t saveToFile(const std::string& a_fileName) const;
+    int32_t loadFromFile(const std::string& a_fileName, const uint8_t* a_inputBuffer, size_t a_inputSize);
+};
+
+}
+#endif // LIBNFITS_GZIPINDEX_H
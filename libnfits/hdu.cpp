@@ -4,7 +4,7 @@ namespace libnfits
 {
 
 HDU::HDU():
-    m_dataBuffer(nullptr), m_payloadBuffer(nullptr), m_offset(0), m_payloadOffset(0), m_size(0),
+    m_bHeaderParsed(true), m_headerSize(0), m_dataBuffer(nullptr), m_payloadBuffer(nullptr), m_offset(0), m_payloadOffset(0), m_size(0),
     m_type(/*FITS_HDU_PRIMARY_HDU_INDEX*/0), m_bitpix(0), m_naxis(0)
 {
 
@@ -18,6 +18,7 @@ HDU::~HDU()
 void HDU::addHeader(const Header& a_header)
 {
     m_header = a_header;
+    m_bHeaderParsed = true;
 
     HeaderRecord hRecord;
 
@@ -41,8 +42,65 @@ void HDU::addHeader(const Header& a_header)
     }
 }
 
-Header HDU::getHeader() const
+// The header cards start at the data buffer set by setData(), their size is set by setHeaderSize()
+void HDU::setDeferredHeader(int32_t a_bitpix, int32_t a_naxis, const std::vector<uint32_t>& a_axises)
 {
+    m_header.clear();
+    m_bHeaderParsed = false;
+
+    m_bitpix = a_bitpix;
+    m_naxis = a_naxis;
+    m_axises = a_axises;
+}
+
+bool HDU::isHeaderParsed() const
+{
+    std::lock_guard<std::mutex> lock(m_headerMutex.mutex);
+
+    return m_bHeaderParsed;
+}
+
+void HDU::setHeaderSize(size_t a_headerSize)
+{
+    m_headerSize = a_headerSize;
+}
+
+size_t HDU::getHeaderSize() const
+{
+    return m_headerSize;
+}
+
+// The header may be requested from several threads at once, e.g. the statistics worker and the GUI
+void HDU::parseHeader() const
+{
+    std::lock_guard<std::mutex> lock(m_headerMutex.mutex);
+
+    if (m_bHeaderParsed)
+        return;
+
+    m_bHeaderParsed = true;
+
+    if (m_dataBuffer == nullptr)
+        return;
+
+    // the same way as FitsFile::findHDU() does it, parsing stops on the first wrong record
+    for (size_t offset = 0; offset + FITS_HEADER_RECORD_SIZE <= m_headerSize; offset += FITS_HEADER_RECORD_SIZE)
+    {
+        HeaderRecord hRecord;
+
+        hRecord.setRecordView(std::string_view((const char*)m_dataBuffer + offset, FITS_HEADER_RECORD_SIZE));
+
+        if (hRecord.parse() != FITS_GENERAL_SUCCESS)
+            break;
+
+        m_header.addRecord(hRecord);
+    }
+}
+
+const Header& HDU::getHeader() const
+{
+    parseHeader();
+
     return m_header;
 }
 
@@ -81,11 +139,21 @@ uint8_t HDU::getType() const
     return m_type;
 }
 
-std::vector<uint32_t> HDU::getAxises() const
+const std::vector<uint32_t>& HDU::getAxises() const
 {
     return m_axises;
 }
 
+int32_t HDU::getBitpix() const
+{
+    return m_bitpix;
+}
+
+int32_t HDU::getNaxis() const
+{
+    return m_naxis;
+}
+
 void HDU::setOffset(size_t a_offset)
 {
     m_offset = a_offset;
@@ -127,6 +195,9 @@ void HDU::reset()
     m_bitpix = 0;
     m_naxis = 0;
     m_axises.clear();
+    m_header.clear();
+    m_bHeaderParsed = true;
+    m_headerSize = 0;
 }
 
 }
@@ -9,10 +9,15 @@
 namespace libnfits
 {
 
+// The header may be set as deferred: only the structural values are known then, the records are parsed from the
+// header cards in the file buffer on the first access
 class HDU
 {
 private:
-    Header                  m_header;
+    mutable Header          m_header;
+    mutable bool            m_bHeaderParsed;
+    mutable CacheMutex      m_headerMutex;      /// guards the parsing of a deferred header
+    size_t                  m_headerSize;       /// size of the header cards up to END inclusive
     uint8_t*                m_dataBuffer;
     uint8_t*                m_payloadBuffer;
     size_t                  m_offset;
@@ -23,12 +28,24 @@ private:
     uint32_t                m_naxis;
     std::vector<uint32_t>   m_axises;
 
+private:
+    void parseHeader() const;
+
 public:
     HDU();
+    HDU(const HDU& a_hdu) = default;
+    HDU(HDU&& a_hdu) = default;
     ~HDU();
 
+    HDU& operator = (const HDU& a_hdu) = default;
+    HDU& operator = (HDU&& a_hdu) = default;
+
     void addHeader(const Header& a_header);
-    Header getHeader() const;
+    void setDeferredHeader(int32_t a_bitpix, int32_t a_naxis, const std::vector<uint32_t>& a_axises);
+    bool isHeaderParsed() const;
+    void setHeaderSize(size_t a_headerSize);
+    size_t getHeaderSize() const;
+    const Header& getHeader() const;
     void setData(const uint8_t* a_dataBuffer);
     uint8_t* getData() const;
     void setPaylod(const uint8_t* a_payloadBuffer);
@@ -36,10 +53,14 @@ public:
     bool isPrimary() const;
     void setType(uint8_t a_type);
     uint8_t getType() const;
-    std::vector<uint32_t> getAxises() const;
+    const std::vector<uint32_t>& getAxises() const;
+    int32_t getBitpix() const;
+    int32_t getNaxis() const;
 
-    template<typename T> T getKeywordValue(const std::string& a_strKeyword, bool& a_successFlag)
+    template<typename T> T getKeywordValue(const std::string& a_strKeyword, bool& a_successFlag) const
     {
+        parseHeader();
+
         return  m_header.getKeywordValue<T>(a_strKeyword, a_successFlag);
     }
 
@@ -0,0 +1,179 @@
+#include "hduindex.h"
+
+#include <cstring>
+#include <fstream>
+
+#include <sys/stat.h>
+
+namespace libnfits
+{
+
+HDUIndex::HDUIndex():
+    m_fileSize(0), m_modificationTime(0), m_blockHash(0), m_dataSize(0)
+{
+
+}
+
+HDUIndex::~HDUIndex()
+{
+    reset();
+}
+
+// Modification time in nanoseconds where it is available, 0 if the file can't be accessed
+uint64_t HDUIndex::getModificationTime(const std::string& a_fileName)
+{
+    struct stat sb;
+
+    if (stat(a_fileName.c_str(), &sb) != FITS_FILE_OPEN_STAT_SUCCESS)
+        return 0;
+
+#if defined(__APPLE__)
+    return (uint64_t)sb.st_mtimespec.tv_sec * 1000000000ULL + sb.st_mtimespec.tv_nsec;
+#elif defined(__unix__)
+    return (uint64_t)sb.st_mtim.tv_sec * 1000000000ULL + sb.st_mtim.tv_nsec;
+#else
+    return (uint64_t)sb.st_mtime * 1000000000ULL;
+#endif
+}
+
+// FNV-1a hash
+uint64_t HDUIndex::hashBlock(const uint8_t* a_buffer, size_t a_size)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < a_size; ++i)
+    {
+        hash ^= a_buffer[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+void HDUIndex::reset()
+{
+    m_entries.clear();
+    m_fileSize = 0;
+    m_modificationTime = 0;
+    m_blockHash = 0;
+    m_dataSize = 0;
+}
+
+void HDUIndex::setFileInfo(uint64_t a_fileSize, uint64_t a_modificationTime, uint64_t a_blockHash, uint64_t a_dataSize)
+{
+    m_fileSize = a_fileSize;
+    m_modificationTime = a_modificationTime;
+    m_blockHash = a_blockHash;
+    m_dataSize = a_dataSize;
+}
+
+void HDUIndex::addEntry(const HDUIndexEntry& a_entry)
+{
+    m_entries.push_back(a_entry);
+}
+
+const std::vector<HDUIndexEntry>& HDUIndex::getEntries() const
+{
+    return m_entries;
+}
+
+bool HDUIndex::isValid() const
+{
+    return !m_entries.empty() && m_modificationTime != 0;
+}
+
+int32_t HDUIndex::saveToFile(const std::string& a_fileName) const
+{
+    if (!isValid())
+        return FITS_GENERAL_ERROR;
+
+    std::ofstream file(a_fileName, std::ios::binary | std::ios::trunc);
+
+    if (!file)
+        return FITS_GENERAL_ERROR;
+
+    uint64_t header[5] = { m_fileSize, m_modificationTime, m_blockHash, m_dataSize, m_entries.size() };
+
+    file.write(FITS_HDU_INDEX_FILE_SIGNATURE, std::strlen(FITS_HDU_INDEX_FILE_SIGNATURE));
+    file.write((const char*)header, sizeof(header));
+
+    for (const HDUIndexEntry& entry : m_entries)
+    {
+        uint64_t offsets[4] = { entry.offset, entry.payloadOffset, entry.size, entry.headerSize };
+        int32_t structure[4] = { entry.type, entry.bitpix, entry.naxis, (int32_t)entry.axises.size() };
+
+        file.write((const char*)offsets, sizeof(offsets));
+        file.write((const char*)structure, sizeof(structure));
+        file.write((const char*)entry.axises.data(), entry.axises.size() * sizeof(uint32_t));
+    }
+
+    return file.good() ? FITS_GENERAL_SUCCESS : FITS_GENERAL_ERROR;
+}
+
+// The index is accepted only if it was created for the same file: size, modification time and the first block hash must match
+int32_t HDUIndex::loadFromFile(const std::string& a_fileName, uint64_t a_fileSize, uint64_t a_modificationTime, uint64_t a_blockHash,
+                               uint64_t a_dataSize)
+{
+    reset();
+
+    std::ifstream file(a_fileName, std::ios::binary);
+
+    if (!file)
+        return FITS_GENERAL_ERROR;
+
+    char signature[sizeof(FITS_HDU_INDEX_FILE_SIGNATURE)] = {};
+    uint64_t header[5] = {};
+
+    file.read(signature, std::strlen(FITS_HDU_INDEX_FILE_SIGNATURE));
+    file.read((char*)header, sizeof(header));
+
+    if (!file || std::strcmp(signature, FITS_HDU_INDEX_FILE_SIGNATURE) != 0 || header[0] != a_fileSize ||
+        header[1] != a_modificationTime || header[2] != a_blockHash || header[3] != a_dataSize || header[4] == 0)
+        return FITS_GENERAL_ERROR;
+
+    for (uint64_t i = 0; i < header[4]; ++i)
+    {
+        HDUIndexEntry entry;
+        uint64_t offsets[4];
+        int32_t structure[4];
+
+        file.read((char*)offsets, sizeof(offsets));
+        file.read((char*)structure, sizeof(structure));
+
+        //// the size is the one of the whole HDU from its offset, the header and the payload must be inside it
+        //// and the HDU inside the data, compared so that the sums can't wrap
+        if (!file || offsets[0] > a_dataSize || offsets[2] > a_dataSize - offsets[0] || offsets[3] > offsets[2] ||
+            offsets[1] > offsets[0] + offsets[2] || structure[3] < 0 || structure[3] > FITS_MAX_NAXIS)
+        {
+            reset();
+
+            return FITS_GENERAL_ERROR;
+        }
+
+        entry.offset = offsets[0];
+        entry.payloadOffset = offsets[1];
+        entry.size = offsets[2];
+        entry.headerSize = offsets[3];
+        entry.type = structure[0];
+        entry.bitpix = structure[1];
+        entry.naxis = structure[2];
+        entry.axises.resize(structure[3]);
+
+        file.read((char*)entry.axises.data(), entry.axises.size() * sizeof(uint32_t));
+
+        m_entries.push_back(std::move(entry));
+    }
+
+    if (!file)
+    {
+        reset();
+
+        return FITS_GENERAL_ERROR;
+    }
+
+    setFileInfo(a_fileSize, a_modificationTime, a_blockHash, a_dataSize);
+
+    return FITS_GENERAL_SUCCESS;
+}
+
+}
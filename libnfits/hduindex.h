@@ -0,0 +1,56 @@
+#ifndef LIBNFITS_HDUINDEX_H
+#define LIBNFITS_HDUINDEX_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "defs.h"
+
+namespace libnfits
+{
+
+// Location and structural keywords of one HDU, enough to create it without reading its header
+struct HDUIndexEntry
+{
+    uint64_t                offset;
+    uint64_t                payloadOffset;
+    uint64_t                size;
+    uint64_t                headerSize;     /// header cards up to END inclusive
+    int32_t                 type;
+    int32_t                 bitpix;
+    int32_t                 naxis;
+    std::vector<uint32_t>   axises;
+};
+
+// HDU offsets table of a FITS file, saved next to it so reopening the file skips the HDU discovery.
+// The index belongs to the file with the same size, modification time and first block contents.
+class HDUIndex
+{
+private:
+    std::vector<HDUIndexEntry>  m_entries;
+    uint64_t                    m_fileSize;         /// size of the file on disk
+    uint64_t                    m_modificationTime;
+    uint64_t                    m_blockHash;        /// hash of the first block of the file on disk
+    uint64_t                    m_dataSize;         /// size of the (decompressed) FITS data
+
+public:
+    HDUIndex();
+    ~HDUIndex();
+
+    static uint64_t getModificationTime(const std::string& a_fileName);
+    static uint64_t hashBlock(const uint8_t* a_buffer, size_t a_size);
+
+    void reset();
+    void setFileInfo(uint64_t a_fileSize, uint64_t a_modificationTime, uint64_t a_blockHash, uint64_t a_dataSize);
+    void addEntry(const HDUIndexEntry& a_entry);
+    const std::vector<HDUIndexEntry>& getEntries() const;
+    bool isValid() const;
+
+    int32_t saveToFile(const std::string& a_fileName) const;
+    int32_t loadFromFile(const std::string& a_fileName, uint64_t a_fileSize, uint64_t a_modificationTime, uint64_t a_blockHash,
+                         uint64_t a_dataSize);
+};
+
+}
+#endif // LIBNFITS_HDUINDEX_H
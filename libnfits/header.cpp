@@ -16,8 +16,20 @@ Header::~Header()
 void Header::addRecord(const HeaderRecord& a_record)
 {
     // Only non-empty records are suppoed to be added into the header info
-    if (!a_record.getKeyword().empty() || !a_record.getValueString().empty() || !a_record.getComment().empty())
-        m_headerRecords.push_back(a_record);
+    if (a_record.isEmpty())
+        return;
+
+    m_keywordIndex.emplace(a_record.getKeywordView(), (uint32_t)m_headerRecords.size());
+    m_headerRecords.push_back(a_record);
+    m_recordValues.emplace_back();
+}
+
+void Header::rebuildKeywordIndex()
+{
+    m_keywordIndex.clear();
+
+    for (uint32_t i = 0; i < m_headerRecords.size(); ++i)
+        m_keywordIndex.emplace(m_headerRecords[i].getKeywordView(), i);
 }
 
 int32_t Header::removeRecord(uint32_t a_index)
@@ -26,6 +38,9 @@ int32_t Header::removeRecord(uint32_t a_index)
         return FITS_GENERAL_ERROR;
 
     m_headerRecords.erase(m_headerRecords.begin() + a_index);
+    m_recordValues.erase(m_recordValues.begin() + a_index);
+
+    rebuildKeywordIndex();
 
     return FITS_GENERAL_SUCCESS;
 }
@@ -40,23 +55,28 @@ int32_t Header::getRecord(uint32_t a_index, HeaderRecord& a_headerRecord) const
     return FITS_GENERAL_SUCCESS;
 }
 
-int32_t Header::findRecordByKeyword(const std::string& a_strKeyword, HeaderRecord& a_headerRecord)
+int32_t Header::findRecordIndex(std::string_view a_strKeyword) const
+{
+    auto it = m_keywordIndex.find(a_strKeyword);
+
+    return it != m_keywordIndex.end() ? (int32_t)it->second : FITS_RECORD_NOT_FOUND;
+}
+
+int32_t Header::findRecordByKeyword(const std::string& a_strKeyword, HeaderRecord& a_headerRecord) const
 {
-    int32_t index = 0;
+    int32_t index = findRecordIndex(a_strKeyword);
 
-    for (std::vector<HeaderRecord>::iterator it = m_headerRecords.begin(); it < m_headerRecords.end(); ++it, ++index)
-        if ((*it).getDataRecord().keyword == a_strKeyword)
-        {
-            a_headerRecord = (*it);
-            return index;
-        }
+    if (index != FITS_RECORD_NOT_FOUND)
+        a_headerRecord = m_headerRecords[index];
 
-    return FITS_RECORD_NOT_FOUND;
+    return index;
 }
 
 void Header::clear()
 {
     m_headerRecords.clear();
+    m_recordValues.clear();
+    m_keywordIndex.clear();
 }
 
 void Header::reset()
@@ -64,7 +84,7 @@ void Header::reset()
     clear();
 }
 
-int32_t Header::getNAXIS()
+int32_t Header::getNAXIS() const
 {
     bool    bSuccess = false;
 
@@ -76,7 +96,7 @@ int32_t Header::getNAXIS()
         return FITS_RECORD_NOT_FOUND;
 }
 
-int32_t Header::getBITPIX()
+int32_t Header::getBITPIX() const
 {
     bool    bSuccess = false;
 
@@ -88,7 +108,7 @@ int32_t Header::getBITPIX()
         return FITS_RECORD_NOT_FOUND;
 }
 
-std::vector<HeaderRecord> Header::getHeaderRecords() const
+const std::vector<HeaderRecord>& Header::getHeaderRecords() const
 {
     return m_headerRecords;
 }
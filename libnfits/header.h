@@ -1,51 +1,128 @@
 #ifndef LIBNFITS_HEADER_H
 #define LIBNFITS_HEADER_H
 
+#include <limits>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+
 #include "headerrecord.h"
 
 namespace libnfits
 {
 
+// Hash allowing keyword lookups by std::string_view without creating std::string keys
+struct KeywordHash
+{
+    using is_transparent = void;
+
+    size_t operator()(std::string_view a_strKeyword) const
+    {
+        return std::hash<std::string_view>{}(a_strKeyword);
+    }
+};
+
+// Mutex of a cache filled by const methods, which may be called from several threads. A copy gets its own mutex,
+// so the classes keep their default copy and move.
+struct CacheMutex
+{
+    std::mutex mutex;
+
+    CacheMutex() = default;
+    CacheMutex(const CacheMutex&) {}
+    CacheMutex& operator = (const CacheMutex&) { return *this; }
+};
+
+// Numeric values of a record, parsed on the first request
+struct HeaderRecordValue
+{
+    bool        bIntegerParsed = false;
+    bool        bIntegerValid = false;
+    bool        bFloatParsed = false;
+    bool        bFloatValid = false;
+    int64_t     integerValue = 0;
+    long double floatValue = 0;
+};
+
 class Header
 {
 private:
     std::vector<HeaderRecord> m_headerRecords;
+    mutable std::vector<HeaderRecordValue> m_recordValues;      /// the same indexing as m_headerRecords
+    mutable CacheMutex m_recordValuesMutex;
+    std::unordered_map<std::string, uint32_t, KeywordHash, std::equal_to<>> m_keywordIndex;    /// the first record of each keyword
+
+private:
+    void rebuildKeywordIndex();
 
 public:
     Header();
+    Header(const Header& a_header) = default;
+    Header(Header&& a_header) = default;
     ~Header();
 
+    Header& operator = (const Header& a_header) = default;
+    Header& operator = (Header&& a_header) = default;
+
     void addRecord(const HeaderRecord& a_record);
     int32_t removeRecord(uint32_t a_index);
     int32_t getRecord(uint32_t a_index, HeaderRecord& a_headerRecord) const;
-    int32_t findRecordByKeyword(const std::string& a_strKeyword, HeaderRecord& a_headerRecord);
-    int32_t getNAXIS();
-    int32_t getBITPIX();
-    std::vector<HeaderRecord> getHeaderRecords() const;
+    int32_t findRecordIndex(std::string_view a_strKeyword) const;
+    int32_t findRecordByKeyword(const std::string& a_strKeyword, HeaderRecord& a_headerRecord) const;
+    int32_t getNAXIS() const;
+    int32_t getBITPIX() const;
+    const std::vector<HeaderRecord>& getHeaderRecords() const;
     void clear();
     void reset();
 
 
-    template<typename T> T getKeywordValue(const std::string& a_strKeyword, bool& a_successFlag)
+    template<typename T> T getKeywordValue(const std::string& a_strKeyword, bool& a_successFlag) const
     {
-        HeaderRecord    record;
-        T               retVal;
-        bool            bSuccess = false;
-
-        int32_t resFound = findRecordByKeyword(a_strKeyword, record);
+        int32_t index = findRecordIndex(a_strKeyword);
 
-        if (resFound == FITS_RECORD_NOT_FOUND)
+        if (index == FITS_RECORD_NOT_FOUND)
         {
-            a_successFlag = bSuccess;
+            a_successFlag = false;
 
             return FITS_RECORD_NOT_FOUND;
         }
 
-        retVal = record.getValue<T>(bSuccess);
+        HeaderRecordValue& value = m_recordValues[index];
+
+        if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool>)
+        {
+            std::lock_guard<std::mutex> lock(m_recordValuesMutex.mutex);
+
+            if (!value.bIntegerParsed)
+            {
+                value.integerValue = convertStringViewNumber<int64_t>(m_headerRecords[index].getValueView(), value.bIntegerValid);
+                value.bIntegerParsed = true;
+            }
+
+            // negative values are accepted for the unsigned types the same way as the stream conversion does
+            int64_t maxValue = (int64_t)std::min<uint64_t>(std::numeric_limits<T>::max(), std::numeric_limits<int64_t>::max());
+            int64_t minValue = std::is_signed_v<T> ? (int64_t)std::numeric_limits<T>::min() : -maxValue;
+
+            a_successFlag = value.bIntegerValid && value.integerValue >= minValue && value.integerValue <= maxValue;
+
+            return (T)value.integerValue;
+        }
+        else if constexpr (std::is_floating_point_v<T>)
+        {
+            std::lock_guard<std::mutex> lock(m_recordValuesMutex.mutex);
+
+            if (!value.bFloatParsed)
+            {
+                value.floatValue = convertStringViewNumber<long double>(m_headerRecords[index].getValueView(), value.bFloatValid);
+                value.bFloatParsed = true;
+            }
 
-        a_successFlag = bSuccess;
+            a_successFlag = value.bFloatValid;
 
-        return retVal;
+            return (T)value.floatValue;
+        }
+        else
+            return m_headerRecords[index].getValue<T>(a_successFlag);
     }
 
 };
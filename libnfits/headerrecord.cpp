@@ -6,7 +6,8 @@ namespace libnfits
 {
 
 HeaderRecord::HeaderRecord():
-    m_strData(""), m_bContinue(false)
+    m_strData(""), m_keywordStart(0), m_keywordLength(0), m_valueStart(0), m_valueLength(0), m_commentStart(0),
+    m_commentLength(0), m_bQuoteEscape(false), m_bContinue(false)
 {
 
 }
@@ -18,79 +19,81 @@ HeaderRecord::~HeaderRecord()
 
 void HeaderRecord::operator = (const std::string& a_strData)
 {
-    this->m_strData = a_strData;
+    setData(a_strData);
 }
 
 void HeaderRecord::setData(const std::string& a_strData)
 {
     m_strData = a_strData;
+    m_record = std::string_view();
+}
+
+void HeaderRecord::setRecordView(std::string_view a_record)
+{
+    m_strData.clear();
+    m_record = a_record;
+}
+
+std::string_view HeaderRecord::getRecordView() const
+{
+    return m_record.data() != nullptr ? m_record : std::string_view(m_strData);
 }
 
 std::string HeaderRecord::getData() const
 {
-    return m_strData;
+    return std::string(getRecordView());
 }
 
 int32_t HeaderRecord::parse()
 {
-    HeaderRecordData dataRecord;
-    std::string strAfterKeyword = "";
-    std::string strKeyword = "";
-    std::string strValue = FITS_UNDEFINED_STR_VALUE;
-    std::string strComment = "";
+    static const uint64_t fieldEnd = getKeywordField(FITS_KEYWORD_END);
+    static const uint64_t fieldContinue = getKeywordField(FITS_KEYWORD_CONTINUE);
+    static const uint64_t fieldHistory = getKeywordField(FITS_KEYWORD_HISTORY);
+    static const uint64_t fieldComment = getKeywordField(FITS_KEYWORD_COMMENT);
 
-    int32_t retVal = FITS_GENERAL_SUCCESS;
+    std::string_view record = getRecordView();
+    std::string_view keyword;
+    size_t afterKeywordPos = 0;
 
     // processing record error cases: empty, long, wrong syntax
-    if (m_strData.empty())
+    if (record.empty())
         return FITS_EMPTY_STRING_ERROR;
 
-    if (m_strData.length() > FITS_HEADER_RECORD_SIZE)
+    if (record.length() > FITS_HEADER_RECORD_SIZE)
         return FITS_RECORD_SIZE_ERROR;
 
-    if (!recordSyntaxCheck(m_strData))
+    if (!recordSyntaxCheck(record))
         return FITS_RECORD_SYNTAX_ERROR;
 
     // there is at least a keyword
-    if (m_strData.length() >= FITS_MIN_KEYWORD_VALUE_STR_LENGTH &&
-        m_strData[FITS_KEYWORD_END_POS] == FITS_HEADER_RECORD_ASSIGNMENT_CHAR &&
-        m_strData[FITS_KEYWORD_END_POS + 1] == FITS_PADDING_SPACE_CHAR)
+    if (record.length() >= FITS_MIN_KEYWORD_VALUE_STR_LENGTH &&
+        record[FITS_KEYWORD_END_POS] == FITS_HEADER_RECORD_ASSIGNMENT_CHAR &&
+        record[FITS_KEYWORD_END_POS + 1] == FITS_PADDING_SPACE_CHAR)
     {
-        strKeyword = removeSymbols(getKeywordFromRecord(m_strData), FITS_PADDING_SPACE_CHAR);
-        strAfterKeyword = getAfterKeywordFromRecord(m_strData);
+        keyword = trimStringViewLeftRight(record.substr(0, FITS_KEYWORD_END_POS), FITS_PADDING_SPACE_CHAR);
+        afterKeywordPos = FITS_KEYWORD_END_POS + 1;
     }
     else
     {
-        // special keywords (e.g. END, CONTINUE, HISTORY, COMMENT) case handling
-        size_t posFoundEnd = m_strData.find(FITS_KEYWORD_END);
-        size_t posFoundContinue = m_strData.find(FITS_KEYWORD_CONTINUE);
-        size_t posFoundHistory = m_strData.find(FITS_KEYWORD_HISTORY);
-        size_t posFoundComment = m_strData.find(FITS_KEYWORD_COMMENT);
-
-        if (posFoundEnd == 0)
-        {
-            strKeyword = FITS_KEYWORD_END;
-            strAfterKeyword = m_strData.substr(posFoundEnd + std::string(FITS_KEYWORD_END).length());
-        }
-        else if (posFoundContinue == 0)
-        {
-            strKeyword = FITS_KEYWORD_CONTINUE;
-            strAfterKeyword = m_strData.substr(posFoundContinue + std::string(FITS_KEYWORD_CONTINUE).length());
-        }
-        else if (posFoundHistory == 0)
-        {
-            strKeyword = FITS_KEYWORD_HISTORY;
-            strAfterKeyword = m_strData.substr(posFoundHistory + std::string(FITS_KEYWORD_HISTORY).length());
-        }
-        else if (posFoundComment == 0)
-        {
-            strKeyword = FITS_KEYWORD_COMMENT;
-            strAfterKeyword = m_strData.substr(posFoundComment + std::string(FITS_KEYWORD_COMMENT).length());
-        }
-        else
-            strAfterKeyword = m_strData;
+        // special keywords (e.g. END, CONTINUE, HISTORY, COMMENT) case handling, the whole keyword field is compared at once
+        uint64_t field = getKeywordField(record);
+
+        if (field == fieldEnd)
+            keyword = record.substr(0, std::string_view(FITS_KEYWORD_END).length());
+        else if (field == fieldContinue)
+            keyword = record.substr(0, std::string_view(FITS_KEYWORD_CONTINUE).length());
+        else if (field == fieldHistory)
+            keyword = record.substr(0, std::string_view(FITS_KEYWORD_HISTORY).length());
+        else if (field == fieldComment)
+            keyword = record.substr(0, std::string_view(FITS_KEYWORD_COMMENT).length());
+
+        afterKeywordPos = keyword.length();
     }
 
+    std::string_view strAfterKeyword = record.substr(afterKeywordPos);
+    std::string_view strValue = strAfterKeyword;
+    std::string_view strComment;
+
     // finding the exact comment (if exists) start position
     int32_t posComment = findFirstCharOutOfQuotes(strAfterKeyword, FITS_COMMENT_START_CHAR);
 
@@ -100,57 +103,61 @@ int32_t HeaderRecord::parse()
 
     if (posComment > 0)
         strValue = strAfterKeyword.substr(0, posComment - 1);
-    else
-        strValue = strAfterKeyword;
 
-    // removing possible double quotes from the value field
-    if (strValue.length() > 2)
-        replaceSubstring(strValue, FITS_DOUBLE_QUOTE_CHAR, std::string(1, FITS_QUOTE_CHAR));
-
-    // final processing of the keyword field
-    dataRecord.keyword = strKeyword;
+    // double quotes in the value field are replaced when the value string is requested
+    m_bQuoteEscape = strValue.length() > 2 && strValue.find(FITS_DOUBLE_QUOTE_CHAR) != std::string_view::npos;
 
     // final processing of the value field
-    trimStringLeftRight(strValue, FITS_PADDING_SPACE_CHAR);
-    ////trimStringLeftRight(strValue, FITS_QUOTE_CHAR);       // Here we may have 2 cases, with '' or without, both can be ok
-    trimStringRight(strValue, FITS_VALUE_CONTINUE_CHAR);
-    dataRecord.value = strValue;
+    strValue = trimStringViewLeftRight(strValue, FITS_PADDING_SPACE_CHAR);
+    ////strValue = trimStringViewLeftRight(strValue, FITS_QUOTE_CHAR);   // Here we may have 2 cases, with '' or without, both can be ok
+    strValue = trimStringViewRight(strValue, FITS_VALUE_CONTINUE_CHAR);
 
-    // final prpcessing of the comment field, both-side trimming may be optional
-    // trimStringLeftRight(strComment, FITS_PADDING_SPACE_CHAR);    // Uncomment this if needed to trim spaces both from left & right sides.
-    trimStringRight(strComment, FITS_PADDING_SPACE_CHAR);           // Comment this line if the above one is uncommented.
-    dataRecord.comment = strComment;
+    // final prpcessing of the comment field, only the right side is trimmed
+    strComment = trimStringViewRight(strComment, FITS_PADDING_SPACE_CHAR);
 
     // checking if the value or comment are continued to the next record item
-    bool bContinueValue = isValueContinued(strValue);
+    changeContinueFlag(isValueContinued(strValue));
+
+    auto getOffset = [&record](std::string_view a_field) { return a_field.empty() ? 0 : a_field.data() - record.data(); };
 
-    // changing continue flag for the record
-    changeContinueFlag(bContinueValue);
+    m_keywordStart = getOffset(keyword);
+    m_keywordLength = keyword.length();
+    m_valueStart = getOffset(strValue);
+    m_valueLength = strValue.length();
+    m_commentStart = getOffset(strComment);
+    m_commentLength = strComment.length();
 
-    // trimming the continuation marker (by default '&')
-    if (bContinueValue)
-        trimStringRight(strValue, FITS_VALUE_CONTINUE_CHAR);
+    return FITS_GENERAL_SUCCESS;
+}
 
-    // assigning the constructed final header record structure
-    m_headerRecordData = dataRecord;
+std::string_view HeaderRecord::getKeywordView() const
+{
+    return getRecordView().substr(m_keywordStart, m_keywordLength);
+}
 
-    m_strData.clear();
+// The value as it is in the record, without replacing the double quotes
+std::string_view HeaderRecord::getValueView() const
+{
+    return getRecordView().substr(m_valueStart, m_valueLength);
+}
 
-    return retVal;
+bool HeaderRecord::isEmpty() const
+{
+    return m_keywordLength == 0 && m_valueLength == 0 && m_commentLength == 0;
 }
 
 HeaderRecordData HeaderRecord::getDataRecord() const
 {
-    return m_headerRecordData;
+    return HeaderRecordData(getKeyword(), getValueString(), getComment());
 }
 
 std::vector<std::string> HeaderRecord::getDataRecordComponentsList() const
 {
     std::vector<std::string> retVec;
 
-    retVec.push_back(m_headerRecordData.keyword);
-    retVec.push_back(m_headerRecordData.value);
-    retVec.push_back(m_headerRecordData.comment);
+    retVec.push_back(getKeyword());
+    retVec.push_back(getValueString());
+    retVec.push_back(getComment());
 
     return retVec;
 }
@@ -206,23 +213,38 @@ void HeaderRecord::changeContinueFlag(bool a_flag)
 void HeaderRecord::clear()
 {
     m_bContinue = false;
+    m_bQuoteEscape = false;
     m_strData.clear();
-    m_headerRecordData.clear();
+    m_record = std::string_view();
+    m_keywordStart = m_keywordLength = 0;
+    m_valueStart = m_valueLength = 0;
+    m_commentStart = m_commentLength = 0;
 }
 
 std::string HeaderRecord::getKeyword() const
 {
-    return m_headerRecordData.keyword;
+    std::string strKeyword(getKeywordView());
+
+    // keywords with inner spaces are invalid, but they are kept readable
+    if (strKeyword.find(FITS_PADDING_SPACE_CHAR) != std::string::npos)
+        strKeyword = removeSymbols(strKeyword, FITS_PADDING_SPACE_CHAR);
+
+    return strKeyword;
 }
 
 std::string HeaderRecord::getValueString() const
 {
-    return m_headerRecordData.value;
+    std::string strValue(getValueView());
+
+    if (m_bQuoteEscape)
+        replaceSubstring(strValue, FITS_DOUBLE_QUOTE_CHAR, std::string(1, FITS_QUOTE_CHAR));
+
+    return strValue;
 }
 
 std::string HeaderRecord::getComment() const
 {
-    return m_headerRecordData.comment;
+    return std::string(getRecordView().substr(m_commentStart, m_commentLength));
 }
 
 }
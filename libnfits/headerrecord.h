@@ -2,6 +2,7 @@
 #define LIBNFITS_HEADERRECORD_H
 
 #include <cstdint>
+#include <string_view>
 
 #include "defs.h"
 #include "keywords.h"
@@ -49,13 +50,25 @@ struct HeaderRecordData
     }
 };
 
+// The record is parsed into offsets of its fields only, the strings are created when they are requested.
+// Records set by setRecordView() refer to the FITS file buffer, which must outlive them.
 class HeaderRecord
 {
 private:
-    std::string                 m_strData;
-    HeaderRecordData            m_headerRecordData;
+    std::string                 m_strData;          /// own copy of the record, if it was set as std::string
+    std::string_view            m_record;           /// slice of the FITS file buffer otherwise
+    uint8_t                     m_keywordStart;
+    uint8_t                     m_keywordLength;
+    uint8_t                     m_valueStart;
+    uint8_t                     m_valueLength;
+    uint8_t                     m_commentStart;
+    uint8_t                     m_commentLength;
+    bool                        m_bQuoteEscape;     /// the value contains '' to be replaced by '
     bool                        m_bContinue;
 
+private:
+    std::string_view getRecordView() const;
+
 public:
     HeaderRecord();
     ~HeaderRecord();
@@ -63,14 +76,18 @@ public:
     void operator = (const std::string& a_strData);
 
     void setData(const std::string& a_strData);
+    void setRecordView(std::string_view a_record);
     std::string getData() const;
     int32_t parse();
     HeaderRecordData getDataRecord() const;
     std::string getKeyword() const;
     std::string getValueString() const;
+    std::string_view getKeywordView() const;
+    std::string_view getValueView() const;
+    bool isEmpty() const;
     template<typename T> T getValue(bool& a_successFlag) const
     {
-        return convertStringMulti<T>(m_headerRecordData.value, a_successFlag);
+        return convertStringMulti<T>(getValueString(), a_successFlag);
     }
     std::string getComment() const;
     std::vector<std::string> getDataRecordComponentsList() const;
@@ -2,9 +2,19 @@
 
 #include <sstream>
 #include <fstream>
+#include <cstring>
+#include <new>
+#include <bit>
+#include <thread>
+#include <utility>
 #include <boost/iostreams/filtering_streambuf.hpp>
 #include <boost/iostreams/copy.hpp>
 #include <boost/iostreams/filter/gzip.hpp>
+#include <zlib.h>
+
+#include "gzipindex.h"
+#include "pixelkernels.h"
+#include "threadpool.h"
 
 #define HEX_DELIM_SYMBOL        ' '
 
@@ -124,7 +134,7 @@ bool recordKeywordSyntaxCheck(const std::string& a_strData)
     return true;
 }
 
-bool recordSyntaxCheck(const std::string& a_strData)
+bool recordSyntaxCheck(std::string_view a_strData)
 {
     // This checking is wrong. False positive on the "/ someone's comment" case
     //uint32_t quoteNum = countSymbol(a_strData, FITS_QUOTE_CHAR);
@@ -142,7 +152,7 @@ bool recordSyntaxCheck(const std::string& a_strData)
     return true;
 }
 
-int32_t findFirstCharOutOfQuotes(const std::string& a_strData, const int8_t a_sym)
+int32_t findFirstCharOutOfQuotes(std::string_view a_strData, const int8_t a_sym)
 {
     size_t retPos = -1;
 
@@ -162,7 +172,21 @@ int32_t findFirstCharOutOfQuotes(const std::string& a_strData, const int8_t a_sy
     return retPos;
 }
 
-bool isValueContinued(const std::string& a_strData)
+std::string_view trimStringViewRight(std::string_view a_strData, const int8_t a_sym)
+{
+    size_t pos = a_strData.find_last_not_of(a_sym);
+
+    return a_strData.substr(0, pos == std::string_view::npos ? 0 : pos + 1);
+}
+
+std::string_view trimStringViewLeftRight(std::string_view a_strData, const int8_t a_sym)
+{
+    size_t pos = a_strData.find_first_not_of(a_sym);
+
+    return trimStringViewRight(a_strData.substr(pos == std::string_view::npos ? a_strData.length() : pos), a_sym);
+}
+
+bool isValueContinued(std::string_view a_strData)
 {
     if (a_strData.empty())
         return false;
@@ -179,6 +203,19 @@ std::string getStringFromBuffer(const uint8_t* a_buffer, size_t a_offset, size_t
     return retStr;
 }
 
+// The keyword field (first 8 characters) of the record as one integer, shorter records are padded with spaces
+uint64_t getKeywordField(std::string_view a_strData)
+{
+    char        field[FITS_KEYWORD_END_POS];
+    uint64_t    retVal;
+
+    std::memset(field, FITS_PADDING_SPACE_CHAR, sizeof(field));
+    std::memcpy(field, a_strData.data(), std::min(a_strData.length(), sizeof(field)));
+    std::memcpy(&retVal, field, sizeof(retVal));
+
+    return retVal;
+}
+
 std::vector<int8_t> compressData(const std::vector<int8_t>& a_inputVector, const std::string& a_strMethod)
 {
     return compressDecompressData(a_inputVector, a_strMethod);
@@ -337,6 +374,235 @@ size_t compressDecompressData(const int8_t* a_inputBuffer, int8_t*& a_outputBuff
     return bufSize;
 }
 
+size_t estimateGZIPDecompressedSize(const int8_t* a_inputBuffer, size_t a_bufferSize)
+{
+    if (a_bufferSize < FITS_GZIP_MIN_SIZE)
+        return 0;
+
+    // ISIZE is the last 4 bytes of the gzip trailer, little endian, modulo 2^32
+    const uint8_t* trailer = (const uint8_t*)a_inputBuffer + a_bufferSize - sizeof(uint32_t);
+    size_t estSize = (size_t)trailer[0] | ((size_t)trailer[1] << 8) | ((size_t)trailer[2] << 16) | ((size_t)trailer[3] << 24);
+
+    // Deflate expands incompressible data by 5 bytes per 64 KB stored block at most (plus header/trailer),
+    // so an ISIZE noticeably smaller than the compressed size is either wrapped at 4 GB (single member) or it
+    // describes only the last member of a multi-member file. Which one is not known before inflating, so the
+    // wrapped size is used only up to a usual compression ratio, the decoder grows the buffer if needed.
+    if (a_bufferSize > FITS_BLOCK_SIZE)
+    {
+        size_t minSize = a_bufferSize - a_bufferSize / 8192 - FITS_BLOCK_SIZE;
+
+        if (estSize < minSize)
+        {
+            size_t maxSize = a_bufferSize * FITS_GZIP_MAX_ESTIMATE_RATIO;
+
+            while (estSize < minSize)
+                estSize += FITS_GZIP_ISIZE_WRAP;
+
+            if (estSize > maxSize)
+                estSize = maxSize;
+        }
+    }
+
+    if (estSize == 0)
+        estSize = FITS_BLOCK_SIZE;
+
+    return estSize;
+}
+
+// With a_progress set, the function is run in a separate thread while the data is being consumed: the buffer is published
+// as soon as it is allocated, it is never reallocated and on failure it is left to the caller to free it after the thread ends.
+size_t decompressGZIPData(const int8_t* a_inputBuffer, int8_t*& a_outputBuffer, size_t a_bufferSize, GZIPIndex* a_index,
+                          GZIPInflateProgress* a_progress)
+{
+    auto publishProgress = [a_progress](size_t a_availableSize, int32_t a_status)
+    {
+        if (a_progress == nullptr)
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(a_progress->mutex);
+
+            a_progress->availableSize = a_availableSize;
+            a_progress->status = a_status;
+        }
+
+        a_progress->condition.notify_all();
+    };
+
+    size_t capacity = estimateGZIPDecompressedSize(a_inputBuffer, a_bufferSize);
+
+    // one spare byte lets inflate() reach the trailer of a correctly estimated stream before the buffer is full
+    if (capacity != 0)
+        ++capacity;
+
+    a_outputBuffer = capacity ? new (std::nothrow) int8_t[capacity] : nullptr;
+
+    if (a_outputBuffer == nullptr)
+    {
+        publishProgress(0, FITS_GZIP_INFLATE_ERROR);
+
+        return FITS_GZIP_ERROR;
+    }
+
+    if (a_progress != nullptr)
+    {
+        {
+            std::lock_guard<std::mutex> lock(a_progress->mutex);
+
+            a_progress->buffer = a_outputBuffer;
+            a_progress->capacity = capacity;
+        }
+
+        publishProgress(0, FITS_GZIP_INFLATE_RUNNING);
+    }
+
+    // smaller steps let the consumer start parsing earlier
+    size_t outBlockSize = a_progress != nullptr ? FITS_GZIP_PIPELINE_BLOCK_SIZE : FITS_GZIP_INFLATE_BLOCK_SIZE;
+
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+
+    // 16 + MAX_WBITS tells zlib to expect the gzip header and trailer
+    if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK)
+    {
+        publishProgress(0, FITS_GZIP_INFLATE_ERROR);
+
+        if (a_progress == nullptr)
+        {
+            delete [] a_outputBuffer;
+            a_outputBuffer = nullptr;
+        }
+
+        return FITS_GZIP_ERROR;
+    }
+
+    size_t inOffset = 0, outOffset = 0;
+    int32_t res = Z_OK;
+
+    // with the index requested, inflate() stops at every deflate block boundary so the access points can be recorded
+    int32_t flush = Z_NO_FLUSH;
+
+    if (a_index != nullptr)
+    {
+        a_index->reset();
+        a_index->addPoint(0, 0, FITS_GZIP_MEMBER_START, (const uint8_t*)a_outputBuffer);
+
+        flush = Z_BLOCK;
+    }
+
+    while (true)
+    {
+        // The last member's ISIZE was wrong (multi-member file or wrapped size), growing the buffer
+        if (outOffset == capacity)
+        {
+            if (a_progress != nullptr)
+            {
+                res = Z_BUF_ERROR;
+                break;
+            }
+
+            size_t newCapacity = capacity + std::max(capacity / 2, (size_t)FITS_GZIP_INFLATE_BLOCK_SIZE);
+            int8_t* newBuffer = new (std::nothrow) int8_t[newCapacity];
+
+            if (newBuffer == nullptr)
+            {
+                res = Z_MEM_ERROR;
+                break;
+            }
+
+            std::memcpy(newBuffer, a_outputBuffer, outOffset);
+            delete [] a_outputBuffer;
+
+            a_outputBuffer = newBuffer;
+            capacity = newCapacity;
+        }
+
+        // zlib counters are 32-bit, so the data is fed and drained in large blocks
+        if (stream.avail_in == 0)
+        {
+            stream.next_in = (Bytef*)(a_inputBuffer + inOffset);
+            stream.avail_in = (uInt)std::min(a_bufferSize - inOffset, FITS_GZIP_INFLATE_BLOCK_SIZE);
+            inOffset += stream.avail_in;
+        }
+
+        stream.next_out = (Bytef*)(a_outputBuffer + outOffset);
+        stream.avail_out = (uInt)std::min(capacity - outOffset, outBlockSize);
+
+        uInt availIn = stream.avail_in;
+        uInt availOut = stream.avail_out;
+
+        res = inflate(&stream, flush);
+
+        outOffset += availOut - stream.avail_out;
+
+        bool bProgress = availIn != stream.avail_in || availOut != stream.avail_out;
+
+        if (a_progress != nullptr)
+        {
+            if (a_progress->cancel)
+            {
+                res = Z_DATA_ERROR;
+                break;
+            }
+
+            if (outOffset - a_progress->availableSize >= outBlockSize)
+                publishProgress(outOffset, FITS_GZIP_INFLATE_RUNNING);
+        }
+
+        if (res == Z_STREAM_END)
+        {
+            size_t remaining = stream.avail_in + (a_bufferSize - inOffset);
+
+            // Concatenated gzip members are decoded one after another, anything else after the member
+            // (e.g. zero padding of archived files) is ignored
+            if (remaining < FITS_GZIP_MIN_SIZE || *(const uint16_t*)stream.next_in != FITS_GZIP_MAGIC)
+                break;
+
+            inflateReset(&stream);
+
+            if (a_index != nullptr)
+                a_index->addPoint(a_bufferSize - remaining, outOffset, FITS_GZIP_MEMBER_START, (const uint8_t*)a_outputBuffer);
+        }
+        else if (res == Z_BUF_ERROR && stream.avail_in == 0 && inOffset == a_bufferSize)
+        {
+            res = Z_DATA_ERROR;    // truncated stream
+            break;
+        }
+        else if (res != Z_OK && res != Z_BUF_ERROR)
+            break;
+        else if (a_index != nullptr && bProgress && (stream.data_type & 128) && !(stream.data_type & 64))
+        {
+            // at a new block boundary, not after the last block
+            a_index->addPoint(inOffset - stream.avail_in, outOffset, stream.data_type & 7, (const uint8_t*)a_outputBuffer);
+        }
+    }
+
+    inflateEnd(&stream);
+
+    if (res != Z_STREAM_END)
+    {
+        if (a_index != nullptr)
+            a_index->reset();
+
+        publishProgress(outOffset, outOffset == capacity ? FITS_GZIP_INFLATE_OVERFLOW : FITS_GZIP_INFLATE_ERROR);
+
+        if (a_progress == nullptr)
+        {
+            delete [] a_outputBuffer;
+            a_outputBuffer = nullptr;
+        }
+
+        return FITS_GZIP_ERROR;
+    }
+
+    if (a_index != nullptr)
+        a_index->finalize((const uint8_t*)a_inputBuffer, a_bufferSize, outOffset);
+
+    publishProgress(outOffset, FITS_GZIP_INFLATE_DONE);
+
+    return outOffset;
+}
+
 bool isLittleEndian()
 {
     uint16_t i = 0x0001;
@@ -518,63 +784,14 @@ void convertBufferFloat2RGBA(uint8_t* a_buffer, size_t a_size, float a_min, floa
 void convertBufferFloat2RGB(uint8_t* a_buffer, size_t a_size, float a_min, float a_max,
                             long double a_bzero, long double a_bscale, bool a_zeroScaleFlag, uint32_t a_type)
 {
-    /// checking for buffer granularity
+    // checking for buffer granularity
     if (a_size % sizeof(float) != 0)
         return;
 
-    uint32_t stretchIndex = a_type & FITS_PERCENTILE_TRANSFORM_AND_QUATIENT;
-
-    uint32_t *writeBuffer = (uint32_t*)(a_buffer);
-
-    zeroScaleFloatPtr zeroScaleFunctionPtr = zeroScaleFloatDummy;
-
-    if (a_zeroScaleFlag)
-        zeroScaleFunctionPtr = zeroScaleFloatMul;
-
-    long double minR, maxR;
-    long double newRangeR = calcRangeMinMaxBScaleBZero<float>(a_min, a_max, a_bzero, a_bscale,
-                                                              a_zeroScaleFlag, a_type, minR, maxR);
-
-    float min = static_cast<float>(minR);
-    float max = static_cast<float>(maxR);
-    float newRange = static_cast<float>(newRangeR);
+    RenderParams params;
+    initRenderParams<float>(params, a_min, a_max, a_bzero, a_bscale, a_zeroScaleFlag, a_type);
 
-    ///float newRange = std::fabs(a_max - a_min); /// original version
-
-#if defined(ENABLE_OPENMP)
-///#pragma omp parallel for
-#endif
-    for (size_t i = 0; i < a_size / sizeof(float); ++i)
-    {
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-        uint32_t s = swap32(writeBuffer[i]);
-#else
-        uint32_t s = writeBuffer[i];
-#endif
-        float f = *((float *)&s);
-
-        zeroScaleFunctionPtr(f, a_bzero, a_bscale);
-
-        /// stretch is applied to min/max/range
-        if (stretchIndex > 0)
-        {
-            if (stretchIndex != 3) /// not arcsinh() case
-            {
-                f = (isGreaterZero(f)) ? f : 0.0f;
-            }
-            stretchFunctionsPtrMap[stretchIndex].floatPtrFunc(f);
-        }
-        if (a_type & FITS_PERCENTILE_TRANSFORM)
-        {
-            if (f > max)
-                f = max;
-            else if (f < min)
-                f = min;
-        }
-
-        writeBuffer[i] = convertFloat2Grayscale(f, min, newRange); ///
-        ///
-    }
+    selectRenderKernel(-32, a_type, a_zeroScaleFlag, false)(a_buffer, a_size / sizeof(float), a_buffer, params);
 }
 
 void convertBufferRGB2Grayscale(uint8_t* a_buffer, size_t a_size)
@@ -652,23 +869,107 @@ void convertBufferRGB322Grayscale(uint8_t** a_buffer, uint32_t a_width, uint32_t
 
 void convertBufferRGB32Flat2Grayscale(uint8_t* a_buffer, uint32_t a_width, uint32_t a_height)
 {
-    if (a_buffer == nullptr)
+    ColorKernelParams params = {};
+
+    params.bGrayscale = true;
+
+    adjustBufferRGB32FlatColors(a_buffer, a_width, a_height, params);
+}
+
+void setColorKernelLevels(ColorKernelParams& a_params, const float (&a_quatients)[3])
+{
+    for (int32_t channel = 0; channel < 3; ++channel)
+    {
+        a_params.levels[channel] = a_quatients[channel];
+
+        for (uint32_t value = 0; value < 256; ++value)
+            a_params.levelTables[channel][value] = max256((uint32_t)((float)value * a_quatients[channel]));
+    }
+
+    a_params.bLevels = true;
+}
+
+//// The vector kernels multiply the channels, which is faster than three table lookups per word there. Without them
+//// the words are adjusted here with the tables of setColorKernelLevels(), the results are the same.
+void adjustRGB32FlatPixels(uint32_t* a_pixels, size_t a_count, const ColorKernelParams& a_params)
+{
+    size_t i = adjustColorsVectorized(a_pixels, a_count, a_params);
+
+    /// only the levels, as the sliders set them
+    if (a_params.bLevels && !a_params.bGrayscale && !a_params.bEyeComfort && a_params.brightnessThreshold == 0)
+    {
+        const uint8_t* blueLevels = a_params.levelTables[0];
+        const uint8_t* greenLevels = a_params.levelTables[1];
+        const uint8_t* redLevels = a_params.levelTables[2];
+
+        for (; i < a_count; ++i)
+        {
+            uint32_t pixel = a_pixels[i];
+
+            a_pixels[i] = (pixel & 0xff000000) | ((uint32_t)redLevels[(pixel >> 16) & 0xff] << 16) |
+                          ((uint32_t)greenLevels[(pixel >> 8) & 0xff] << 8) | blueLevels[pixel & 0xff];
+        }
+
         return;
+    }
 
-#if defined(ENABLE_OPENMP)
-#pragma omp parallel for collapse(2)
-#endif
-    for (uint32_t y = 0; y < a_height; ++y)
-        for (uint32_t x = 0; x < a_width; ++x)
+    for (; i < a_count; ++i)
+    {
+        uint32_t pixel = a_pixels[i];
+        uint32_t alpha = pixel & 0xff000000;
+        uint8_t blue = pixel & 0xff, green = (pixel >> 8) & 0xff, red = (pixel >> 16) & 0xff;
+
+        if (a_params.bLevels)
+        {
+            blue = a_params.levelTables[0][blue];
+            green = a_params.levelTables[1][green];
+            red = a_params.levelTables[2][red];
+        }
+
+        if (a_params.bGrayscale)
+        {
+            red = green = blue = convertRGB2Grayscale(red, green, blue);
+        }
+        else if (a_params.bEyeComfort)
         {
-            uint8_t average = convertRGB2Grayscale(a_buffer[4*(y*a_width + x)], a_buffer[4*(y*a_width + x) + 1], a_buffer[4*(y*a_width + x) + 2]);
+            convertRGB2EyeComfortColors(red, green, blue, red, green, blue);
+            alpha = 0xff000000;
+        }
+
+        if (a_params.brightnessThreshold != 0 && calcPixelBrightness(red, green, blue) < a_params.brightnessThreshold)
+            red = green = blue = 0;
+
+        a_pixels[i] = alpha | ((uint32_t)red << 16) | ((uint32_t)green << 8) | blue;
+    }
+}
 
-            size_t indexBase = 4*(y*a_width + x);
+int32_t adjustBufferRGB32FlatColors(uint8_t* a_buffer, uint32_t a_width, uint32_t a_height, const ColorKernelParams& a_params)
+{
+    if (a_buffer == nullptr)
+        return FITS_GENERAL_ERROR;
+
+    uint32_t* pixels = reinterpret_cast<uint32_t*>(a_buffer);
+
+    return processRowBands(a_height, a_width, [&](size_t a_firstRow, size_t a_lastRow, std::vector<uint8_t>&)
+    {
+        adjustRGB32FlatPixels(pixels + a_firstRow * a_width, (a_lastRow - a_firstRow) * a_width, a_params);
+    });
+}
+
+void calcRGB32FlatPixelsColorStats(const uint32_t* a_pixels, size_t a_count, ColorKernelResult& a_result)
+{
+    for (size_t i = calcColorStatsVectorized(a_pixels, a_count, a_result); i < a_count; ++i)
+    {
+        for (size_t channel = 0; channel < 3; ++channel)
+        {
+            uint8_t value = (a_pixels[i] >> (channel * 8)) & 0xff;
 
-            a_buffer[indexBase] = average;
-            a_buffer[indexBase + 1] = average;
-            a_buffer[indexBase + 2] = average;
+            a_result.sum[channel] += value;
+            a_result.count[channel] += value != 0;
+            a_result.min[channel] = std::min(a_result.min[channel], value);
+            a_result.max[channel] = std::max(a_result.max[channel], value);
         }
+    }
 }
 
 void convertBufferDouble2RGBA(uint8_t* a_buffer, size_t a_size, double a_min, double a_max, uint32_t a_type)
@@ -788,63 +1089,14 @@ void convertBufferDouble2RGB(uint8_t* a_buffer, size_t a_size, double a_min, dou
 void convertBufferDouble2RGB(uint8_t* a_buffer, size_t a_size, double a_min, double a_max,
                              long double a_bzero, long double a_bscale, bool a_zeroScaleFlag, uint32_t a_type)
 {
-    /// checking for buffer granularity
+    // checking for buffer granularity
     if (a_size % sizeof(double) != 0)
         return;
 
-    uint32_t stretchIndex = a_type & FITS_PERCENTILE_TRANSFORM_AND_QUATIENT;
-
-    uint64_t *writeBuffer = (uint64_t*)(a_buffer);
-
-    zeroScaleDoublePtr zeroScaleFunctionPtr = zeroScaleDoubleDummy;
-
-    if (a_zeroScaleFlag)
-        zeroScaleFunctionPtr = zeroScaleDoubleMul;
-
-    long double minR, maxR;
-    long double newRangeR = calcRangeMinMaxBScaleBZero<double>(a_min, a_max, a_bzero, a_bscale,
-                                                              a_zeroScaleFlag, a_type, minR, maxR);
-
-    double min = static_cast<double>(minR);
-    double max = static_cast<double>(maxR);
-    double newRange = static_cast<double>(newRangeR);
-
-    /// double newRange = std::fabs(a_max - a_min); // original version
-
-#if defined(ENABLE_OPENMP)
-///#pragma omp parallel for
-#endif
-    for (size_t i = 0; i < a_size / sizeof(double); ++i)
-    {
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-        uint64_t s = swap64(writeBuffer[i]);
-#else
-        uint64_t s = writeBuffer[i];
-#endif
-        double f = *((double *)&s);
-
-        zeroScaleFunctionPtr(f, a_bzero, a_bscale);
-
-        /// stretch is applied to min/max/range
-        if (stretchIndex > 0)
-        {
-            if (stretchIndex != 3) /// not arcsinh() case
-            {
-                f = (isGreaterZero(f)) ? f : 0.0;
-            }
-            stretchFunctionsPtrMap[stretchIndex].doublePtrFunc(f);
-        }
-        if (a_type & FITS_PERCENTILE_TRANSFORM)
-        {
-            if (f > max)
-                f = max;
-            else if (f < min)
-                f = min;
-        }
+    RenderParams params;
+    initRenderParams<double>(params, a_min, a_max, a_bzero, a_bscale, a_zeroScaleFlag, a_type);
 
-        writeBuffer[i] = convertDouble2Grayscale(f, min, newRange); ///
-        ///
-    }
+    selectRenderKernel(-64, a_type, a_zeroScaleFlag, false)(a_buffer, a_size / sizeof(double), a_buffer, params);
 }
 
 
@@ -855,83 +1107,21 @@ void convertBufferShort2RGB(uint8_t* a_buffer, size_t a_size, uint8_t* a_destBuf
     if (a_size % sizeof(int16_t) != 0)
         return;
 
-    uint32_t stretchIndex = a_type & FITS_PERCENTILE_TRANSFORM_AND_QUATIENT;
+    RenderParams params;
+    initRenderParams<int16_t>(params, a_min, a_max, a_bzero, a_bscale, a_zeroScaleFlag, a_type);
 
-    uint32_t *writeBuffer = reinterpret_cast<uint32_t*>(a_destBuffer);
+    selectRenderKernel(16, a_type, a_zeroScaleFlag, false)(a_buffer, a_size / sizeof(int16_t), a_destBuffer, params);
+}
 
-    int16_t *tmpBuf = (int16_t*)(a_buffer);
+//// this function is obsolete, will not be used anymore
+void convertBufferShortSZ2RGB(uint8_t* a_buffer, size_t a_size, double a_bzero, double a_bscale, uint8_t* a_destBuffer, bool a_gray,
+                              uint16_t a_min, uint16_t a_max, uint32_t a_type)
+{
+    // checking for buffer granularity
+    if (a_size % sizeof(uint16_t) != 0)
+        return;
 
-    zeroScaleShortPtr zeroScaleFunctionPtr = zeroScaleShortDummy;
-    zeroScaleFloatPtr zeroScaleFunctionFloatPtr = zeroScaleFloatDummy;
-
-    if (a_zeroScaleFlag)
-    {
-        zeroScaleFunctionPtr = zeroScaleShortMul;
-        zeroScaleFunctionFloatPtr = zeroScaleFloatMul;
-    }
-
-    long double minR, maxR;
-    long double newRangeR = calcRangeMinMaxBScaleBZero<int16_t>(a_min, a_max, a_bzero, a_bscale,
-                                                               a_zeroScaleFlag, a_type, minR, maxR);
-
-    float min = static_cast<float>(minR);
-    float max = static_cast<float>(maxR);
-    float newRange = static_cast<float>(newRangeR);
-
-    /// int32_t newRange = std::abs(a_max - a_min); /// original version
-
-#if defined(ENABLE_OPENMP)
-///#pragma omp parallel for
-#endif
-    for (size_t i = 0; i < a_size / sizeof(int16_t); ++i)
-    {
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-        int16_t ff = swap16(tmpBuf[i]);
-#else
-        int16_t ff = tmpBuf[i];
-#endif
-
-        float f = ff;
-        zeroScaleFunctionFloatPtr(f, a_bzero, a_bscale);
-
-        ///zeroScaleFunctionPtr(f, a_bzero, a_bscale); /// original way
-
-        /// stretch is applied to min/max/range
-        if (stretchIndex > 0)
-        {
-            if (stretchIndex != 3) /// not arcsinh() case
-            {
-                ///f = f > 0 ? f : 0;
-
-                f = isGreaterZero(f) ? f : 0.0f;
-            }
-            stretchFunctionsPtrMap[stretchIndex].floatPtrFunc(f);
-
-            ///stretchFunctionsPtrMap[stretchIndex].int16PtrFunc(f); /// original way
-        }
-        if (a_type & FITS_PERCENTILE_TRANSFORM)
-        {
-            if (f > max)
-                f = max;
-            else if (f < min)
-                f = min;
-        }
-        writeBuffer[i] = convertFloat2Grayscale(f, min, newRange);
-
-        ///writeBuffer[i] = convertShort2Grayscale(f, min, newRange); /// original way
-        ///
-    }
-}
-
-//// this function is obsolete, will not be used anymore
-void convertBufferShortSZ2RGB(uint8_t* a_buffer, size_t a_size, double a_bzero, double a_bscale, uint8_t* a_destBuffer, bool a_gray,
-                              uint16_t a_min, uint16_t a_max, uint32_t a_type)
-{
-    // checking for buffer granularity
-    if (a_size % sizeof(uint16_t) != 0)
-        return;
-
-    uint16_t *tmpBuf = (uint16_t*)(a_buffer);
+    uint16_t *tmpBuf = (uint16_t*)(a_buffer);
 
     uint16_t min = std::numeric_limits<uint16_t>::min();
     uint16_t max = std::numeric_limits<uint16_t>::max();
@@ -1130,66 +1320,10 @@ void convertBufferByte2RGB(uint8_t* a_buffer, size_t a_size, uint8_t* a_destBuff
 void convertBufferByte2RGB(uint8_t* a_buffer, size_t a_size, uint8_t* a_destBuffer, int16_t a_min, int16_t a_max,
                            long double a_bzero, long double a_bscale, bool a_zeroScaleFlag, uint32_t a_type)
 {
-    uint32_t stretchIndex = a_type & FITS_PERCENTILE_TRANSFORM_AND_QUATIENT;
-
-    zeroScaleShortPtr zeroScaleFunctionPtr = zeroScaleShortDummy;
-    zeroScaleFloatPtr zeroScaleFunctionFloatPtr = zeroScaleFloatDummy;
-
-    uint32_t *writeBuffer = reinterpret_cast<uint32_t*>(a_destBuffer);
-
-    if (a_zeroScaleFlag)
-    {
-        zeroScaleFunctionPtr = zeroScaleShortMul;
-        zeroScaleFunctionFloatPtr = zeroScaleFloatMul;
-    }
-
-    long double minR, maxR;
-    long double newRangeR = calcRangeMinMaxBScaleBZero<int16_t>(a_min, a_max, a_bzero, a_bscale,
-                                                                a_zeroScaleFlag, a_type, minR, maxR);
-
-    float min = static_cast<float>(minR);
-    float max = static_cast<float>(maxR);
-    float newRange = static_cast<float>(newRangeR);
-
-    /// int16_t newRange = std::abs(a_max - a_min); /// original version
-
-#if defined(ENABLE_OPENMP)
-///#pragma omp parallel for
-#endif
-    for (size_t i = 0; i < a_size; ++i)
-    {
-        ///int16_t f = a_buffer[i]; /// original way
-        float f = a_buffer[i];
-
-        zeroScaleFunctionFloatPtr(f, a_bzero, a_bscale);
-
-        ///zeroScaleFunctionPtr(f, a_bzero, a_bscale); /// original way
-
-        /// stretch is applied to min/max/range
-        if (stretchIndex > 0)
-        {
-            if (stretchIndex != 3) /// not arcsinh() case
-            {
-                ///f = (f >= 0) ? f : 0;
-
-                f = isGreaterZero(f) ? f : 0.0f;
-            }
-            ///stretchFunctionsPtrMap[stretchIndex].int16PtrFunc(f); /// original way
-
-            stretchFunctionsPtrMap[stretchIndex].floatPtrFunc(f);
-        }
-        if (a_type & FITS_PERCENTILE_TRANSFORM)
-        {
-            if (f > max)
-                f = max;
-            else if (f < min)
-                f = min;
-        }
-        writeBuffer[i] = convertFloat2Grayscale(f, min, newRange);
+    RenderParams params;
+    initRenderParams<int16_t>(params, a_min, a_max, a_bzero, a_bscale, a_zeroScaleFlag, a_type);
 
-        ///writeBuffer[i] = convertShort2Grayscale(f, min, newRange); /// original way
-        ///
-    }
+    selectRenderKernel(8, a_type, a_zeroScaleFlag, false)(a_buffer, a_size, a_destBuffer, params);
 }
 
 void convertBufferByteSZ2RGB(uint8_t* a_buffer, size_t a_size, int8_t a_bzero, int8_t a_bscale, uint8_t* a_destBuffer)
@@ -1342,74 +1476,10 @@ void convertBufferInt2RGB(uint8_t* a_buffer, size_t a_size, uint8_t* a_destBuffe
     if (a_size % sizeof(int32_t) != 0)
         return;
 
-    uint32_t stretchIndex = a_type & FITS_PERCENTILE_TRANSFORM_AND_QUATIENT;
-
-    zeroScaleIntPtr zeroScaleFunctionPtr = zeroScaleIntDummy;
-    zeroScaleDoublePtr zeroScaleFunctionDoublePtr = zeroScaleDoubleDummy;
-
-    uint32_t *writeBuffer = reinterpret_cast<uint32_t*>(a_destBuffer);
-
-    int32_t *tmpBuf = (int32_t*)(a_buffer);
-
-    if (a_zeroScaleFlag)
-    {
-        zeroScaleFunctionPtr = zeroScaleIntMul;
-        zeroScaleFunctionDoublePtr = zeroScaleDoubleDummy;
-    }
-
-    long double minR, maxR;
-    long double newRangeR = calcRangeMinMaxBScaleBZero<int32_t>(a_min, a_max, a_bzero, a_bscale,
-                                                                a_zeroScaleFlag, a_type, minR, maxR);
-
-    double min = static_cast<double>(minR);
-    double max = static_cast<double>(maxR);
-    double newRange = static_cast<double>(newRangeR);
-
-    /// int32_t newRange = std::abs(a_max - a_min);  /// original version
-
-#if defined(ENABLE_OPENMP)
-///#pragma omp parallel for
-#endif
-    for (size_t i = 0; i < a_size / sizeof(int32_t); ++i)
-    {
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-        int32_t ff = swap32(tmpBuf[i]);
-#else
-        int32_t ff = tmpBuf[i];
-#endif
-
-        double f = ff;
-        zeroScaleFunctionDoublePtr(f, a_bzero, a_bscale);
-
-        ///zeroScaleFunctionPtr(f, a_bzero, a_bscale); /// original way
-
-        /// stretch is applied to min/max/range
-        if (stretchIndex > 0)
-        {
-            if (stretchIndex != 3) /// not arcsinh() case
-            {
-                ///f = (f >= 0) ? f : 0;
-
-                f = isGreaterZero(f) ? f : 0.0;
-            }
-            stretchFunctionsPtrMap[stretchIndex].doublePtrFunc(f);
-
-            ///stretchFunctionsPtrMap[stretchIndex].int32PtrFunc(f); /// original way
-        }
-        if (a_type & FITS_PERCENTILE_TRANSFORM)
-        {
-            if (f > max)
-                f = max;
-            else if (f < min)
-                f = min;
-        }
-        writeBuffer[i] = convertDouble2Grayscale(f, min, newRange);
-
-        ///writeBuffer[i] = convertFloat2Grayscale(f, min, newRange);
+    RenderParams params;
+    initRenderParams<int32_t>(params, a_min, a_max, a_bzero, a_bscale, a_zeroScaleFlag, a_type);
 
-        ///writeBuffer[i] = convertInt2Grayscale(f, min, newRange); /// original way
-        ///
-    }
+    selectRenderKernel(32, a_type, a_zeroScaleFlag, false)(a_buffer, a_size / sizeof(int32_t), a_destBuffer, params);
 }
 
 void convertBufferLong2RGB(uint8_t* a_buffer, size_t a_size, int64_t a_min, int64_t a_max,
@@ -1549,72 +1619,368 @@ void convertBufferLong2RGB(uint8_t* a_buffer, size_t a_size, uint8_t* a_destBuff
     if (a_size % sizeof(int64_t) != 0)
         return;
 
-    uint32_t stretchIndex = a_type & FITS_PERCENTILE_TRANSFORM_AND_QUATIENT;
+    RenderParams params;
+    initRenderParams<int64_t>(params, a_min, a_max, a_bzero, a_bscale, a_zeroScaleFlag, a_type);
 
-    uint64_t *writeBuffer = reinterpret_cast<uint64_t*>(a_destBuffer);
+    selectRenderKernel(64, a_type, a_zeroScaleFlag, false)(a_buffer, a_size / sizeof(int64_t), a_destBuffer, params);
+}
 
-    int64_t *tmpBuf = (int64_t*)(a_buffer);
 
-    zeroScaleLongPtr zeroScaleFunctionPtr = zeroScaleLongDummy;
-    zeroScaleLongDoublePtr zeroScaleFunctionLongDoublePtr = zeroScaleLongDoubleDummy;
-    zeroScaleDoublePtr zeroScaleFunctionDoublePtr = zeroScaleDoubleDummy;
+//// render kernels: one function per sample type, stretch, BZERO/BSCALE, percentile clipping and output format combination,
+//// so the per-pixel loops have neither branches nor indirect calls. T is the sample type, W is the type it's converted in.
+template<typename T> static inline T readBigEndianSample(const uint8_t* a_buffer)
+{
+    T sample;
 
-    if (a_zeroScaleFlag)
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+    if constexpr (sizeof(T) == sizeof(uint16_t))
     {
-        zeroScaleFunctionPtr = zeroScaleLongMul;
-        zeroScaleFunctionLongDoublePtr = zeroScaleLongDoubleMul;
-        zeroScaleFunctionDoublePtr = zeroScaleDoubleMul;
+        uint16_t s;
+        std::memcpy(&s, a_buffer, sizeof(s));
+        s = swap16(s);
+        std::memcpy(&sample, &s, sizeof(s));
+    }
+    else if constexpr (sizeof(T) == sizeof(uint32_t))
+    {
+        uint32_t s;
+        std::memcpy(&s, a_buffer, sizeof(s));
+        s = swap32(s);
+        std::memcpy(&sample, &s, sizeof(s));
     }
+    else if constexpr (sizeof(T) == sizeof(uint64_t))
+    {
+        uint64_t s;
+        std::memcpy(&s, a_buffer, sizeof(s));
+        s = swap64(s);
+        std::memcpy(&sample, &s, sizeof(s));
+    }
+    else
+#endif
+        std::memcpy(&sample, a_buffer, sizeof(T));
 
-    long double min, max;
-    long double newRange = calcRangeMinMaxBScaleBZero<int64_t>(a_min, a_max, a_bzero, a_bscale,
-                                                               a_zeroScaleFlag, a_type, min, max);
+    return sample;
+}
 
-    /// int64_t newRange = std::abs(a_max - a_min); /// original version
+/// a_bgra: opaque BGRA uint32_t pixels, otherwise the gray RGB words (uint64_t ones for 64-bit samples)
+/// a_native: the samples are taken from a decoded sample plane, T and W are the same type then
+template<typename T, typename W, uint32_t a_stretch, bool a_zeroScale, bool a_clip, bool a_bgra, bool a_native = false>
+static void renderSamples(const uint8_t* a_buffer, size_t a_count, uint8_t* a_destBuffer, const RenderParams& a_params)
+{
+    const W min = static_cast<W>(a_params.min);
+    const W max = static_cast<W>(a_params.max);
+    const W range = static_cast<W>(a_params.range);
+    const long double bzero = a_params.bzero;
+    const long double bscale = a_params.bscale;
 
-#if defined(ENABLE_OPENMP)
-///#pragma omp parallel for
-#endif
-    for (size_t i = 0; i < a_size / sizeof(int64_t); ++i)
+    size_t i = 0;
+
+    /// the vector kernels convert as many pixels as they can, the rest is converted below
+    if constexpr (a_stretch == FITS_STRETCHING_LINEAR_TRANSFORM || a_stretch == FITS_STRETCHING_SQUARE_ROOT_TRANSFORM)
     {
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-        int64_t ff = swap64(tmpBuf[i]);
-#else
-        int64_t ff = tmpBuf[i];
-#endif
+        constexpr int32_t bitpix = std::is_floating_point_v<T> ? -8 * (int32_t)sizeof(T) : 8 * (int32_t)sizeof(T);
+
+        i = convertPixelsVectorized(bitpix, a_buffer, a_destBuffer, a_count, min, max, range,
+                                    bzero, bscale, a_zeroScale, a_params.type, a_bgra, a_native);
+    }
+
+    for (; i < a_count; ++i)
+    {
+        W f;
 
-        long double f = ff;
-        zeroScaleFunctionLongDoublePtr(f, a_bzero, a_bscale);
+        if constexpr (a_native)
+            std::memcpy(&f, a_buffer + i * sizeof(W), sizeof(W));
+        else
+            f = readBigEndianSample<T>(a_buffer + i * sizeof(T));
 
-        ///zeroScaleFunctionPtr(f, a_bzero, a_bscale); /// original version
+        if constexpr (a_zeroScale)
+            f = bzero + bscale*(long double)f;
 
         /// stretch is applied to min/max/range
-        if (stretchIndex > 0)
-        {
-            if (stretchIndex != 3) /// not arcsinh() case
-            {
-                ///f = (f >= 0) ? f : 0;
+        if constexpr (a_stretch != FITS_STRETCHING_LINEAR_TRANSFORM && a_stretch != FITS_STRETCHING_ARCSINH_TRANSFORM)
+            f = isGreaterZero(f) ? f : (W)0;
 
-                f = isGreaterZero(f) ? f : 0.0L;
-            }
-            stretchFunctionsPtrMap[stretchIndex].longDoublePtrFunc(f);
+        if constexpr (a_stretch == FITS_STRETCHING_LOGARITHMIC_TRANSFORM)
+            stretchLogarithmic(f);
+        else if constexpr (a_stretch == FITS_STRETCHING_SQUARE_ROOT_TRANSFORM)
+            stretchSquareroot(f);
+        else if constexpr (a_stretch == FITS_STRETCHING_ARCSINH_TRANSFORM)
+            stretchArcsinh(f);
 
-            ///stretchFunctionsPtrMap[stretchIndex].int64PtrFunc(f); /// original way
-        }
-        if (a_type & FITS_PERCENTILE_TRANSFORM)
+        if constexpr (a_clip)
         {
             if (f > max)
                 f = max;
             else if (f < min)
                 f = min;
         }
-        writeBuffer[i] = convertLongDouble2Grayscale(f, min, newRange);
 
-        ///writeBuffer[i] = convertLong2Grayscale(f, min, newRange); /// original way
-        ///
+        uint32_t pixel;
+
+        if constexpr (std::is_same_v<W, float>)
+            pixel = convertFloat2Grayscale(f, min, range);
+        else if constexpr (std::is_same_v<W, double>)
+            pixel = convertDouble2Grayscale(f, min, range);
+        else
+            pixel = convertLongDouble2Grayscale(f, min, range);
+
+        if constexpr (a_bgra)   /// RGB -> BGRA, the channels are the same except for the values out of [min, max]
+            reinterpret_cast<uint32_t*>(a_destBuffer)[i] = ((pixel & 0xFF) << 16) | (pixel & 0xFF00) | ((pixel >> 16) & 0xFF) | 0xFF000000;
+        else if constexpr (sizeof(T) == sizeof(uint64_t))
+            reinterpret_cast<uint64_t*>(a_destBuffer)[i] = pixel;
+        else
+            reinterpret_cast<uint32_t*>(a_destBuffer)[i] = pixel;
+    }
+}
+
+/// the kernel index is stretch << 3 | BZERO/BSCALE << 2 | clipping << 1 | BGRA
+template<typename T, typename W, size_t... I> static const renderKernelPtr* getRenderKernels(std::index_sequence<I...>)
+{
+    static const renderKernelPtr kernels[] =
+    {
+        renderSamples<T, W, (I >> 3), ((I >> 2) & 1) != 0, ((I >> 1) & 1) != 0, (I & 1) != 0>...
+    };
+
+    return kernels;
+}
+
+renderKernelPtr selectRenderKernel(int32_t a_bitpix, uint32_t a_type, bool a_zeroScaleFlag, bool a_bgra)
+{
+    const auto kernelsNumber = std::make_index_sequence<(FITS_STRETCHING_ARCSINH_TRANSFORM + 1) * 8>();
+
+    uint32_t stretchIndex = a_type & FITS_PERCENTILE_TRANSFORM_AND_QUATIENT;
+
+    /// unknown stretches are rendered as the linear one
+    if (stretchIndex > FITS_STRETCHING_ARCSINH_TRANSFORM)
+        stretchIndex = FITS_STRETCHING_LINEAR_TRANSFORM;
+
+    size_t index = (stretchIndex << 3) | (a_zeroScaleFlag << 2) | (((a_type & FITS_PERCENTILE_TRANSFORM) != 0) << 1) | a_bgra;
+
+    switch (a_bitpix)
+    {
+        case 8:
+            return getRenderKernels<uint8_t, float>(kernelsNumber)[index];
+        case 16:
+            return getRenderKernels<int16_t, float>(kernelsNumber)[index];
+        case 32:
+            return getRenderKernels<int32_t, double>(kernelsNumber)[index];
+        case 64:
+            return getRenderKernels<int64_t, long double>(kernelsNumber)[index];
+        case -32:
+            return getRenderKernels<float, float>(kernelsNumber)[index];
+        case -64:
+            return getRenderKernels<double, double>(kernelsNumber)[index];
+        default:
+            return nullptr;
+    }
+}
+
+/// the kernel index is stretch << 1 | clipping, the planes are rendered into BGRA pixels only
+template<typename W, size_t... I> static const renderKernelPtr* getPlaneRenderKernels(std::index_sequence<I...>)
+{
+    static const renderKernelPtr kernels[] =
+    {
+        renderSamples<W, W, (I >> 1), false, (I & 1) != 0, true, true>...
+    };
+
+    return kernels;
+}
+
+renderKernelPtr selectPlaneRenderKernel(int32_t a_bitpix, uint32_t a_type)
+{
+    const auto kernelsNumber = std::make_index_sequence<(FITS_STRETCHING_ARCSINH_TRANSFORM + 1) * 2>();
+
+    uint32_t stretchIndex = a_type & FITS_PERCENTILE_TRANSFORM_AND_QUATIENT;
+
+    if (stretchIndex > FITS_STRETCHING_ARCSINH_TRANSFORM)
+        stretchIndex = FITS_STRETCHING_LINEAR_TRANSFORM;
+
+    size_t index = (stretchIndex << 1) | ((a_type & FITS_PERCENTILE_TRANSFORM) != 0);
+
+    switch (a_bitpix)
+    {
+        case 32:
+        case -64:
+            return getPlaneRenderKernels<double>(kernelsNumber)[index];
+        case 64:
+            return getPlaneRenderKernels<long double>(kernelsNumber)[index];
+        case -32:
+            return getPlaneRenderKernels<float>(kernelsNumber)[index];
+        default:
+            return nullptr;
+    }
+}
+
+size_t getSamplePlaneElementSize(int32_t a_bitpix)
+{
+    switch (a_bitpix)
+    {
+        case 32:
+        case -64:
+            return sizeof(double);
+        case 64:
+            return sizeof(long double);
+        case -32:
+            return sizeof(float);
+        default:
+            return 0;
+    }
+}
+
+template<typename T, typename W> static void decodeSamples(const uint8_t* a_buffer, size_t a_count, uint8_t* a_destBuffer,
+                                                           long double a_bzero, long double a_bscale, bool a_zeroScaleFlag)
+{
+    W* writeBuffer = reinterpret_cast<W*>(a_destBuffer);
+
+    if (a_zeroScaleFlag)
+    {
+        for (size_t i = 0; i < a_count; ++i)
+            writeBuffer[i] = a_bzero + a_bscale*(long double)readBigEndianSample<T>(a_buffer + i * sizeof(T));
+    }
+    else
+    {
+        for (size_t i = 0; i < a_count; ++i)
+            writeBuffer[i] = readBigEndianSample<T>(a_buffer + i * sizeof(T));
+    }
+}
+
+int32_t decodeSamplePlane(int32_t a_bitpix, const uint8_t* a_buffer, size_t a_count, uint8_t* a_destBuffer,
+                          long double a_bzero, long double a_bscale, bool a_zeroScaleFlag)
+{
+    switch (a_bitpix)
+    {
+        case 32:
+            decodeSamples<int32_t, double>(a_buffer, a_count, a_destBuffer, a_bzero, a_bscale, a_zeroScaleFlag);
+            break;
+        case 64:
+            decodeSamples<int64_t, long double>(a_buffer, a_count, a_destBuffer, a_bzero, a_bscale, a_zeroScaleFlag);
+            break;
+        case -32:
+            decodeSamples<float, float>(a_buffer, a_count, a_destBuffer, a_bzero, a_bscale, a_zeroScaleFlag);
+            break;
+        case -64:
+            decodeSamples<double, double>(a_buffer, a_count, a_destBuffer, a_bzero, a_bscale, a_zeroScaleFlag);
+            break;
+        default:
+            return FITS_GENERAL_ERROR;
+    }
+
+    return FITS_GENERAL_SUCCESS;
+}
+
+/// the sample bits are the table index, so BZERO = 32768 (unsigned 16-bit data) needs no special handling
+template<typename T> static void renderSamplesLut(const uint8_t* a_buffer, size_t a_count, uint8_t* a_destBuffer,
+                                                  const RenderParams& a_params)
+{
+    const uint32_t* lut = a_params.lut;
+    uint32_t* writeBuffer = reinterpret_cast<uint32_t*>(a_destBuffer);
+
+    for (size_t i = 0; i < a_count; ++i)
+    {
+        if constexpr (sizeof(T) == sizeof(uint16_t))
+            writeBuffer[i] = lut[((uint32_t)a_buffer[2 * i] << 8) | a_buffer[2 * i + 1]];
+        else
+            writeBuffer[i] = lut[a_buffer[i]];
+    }
+}
+
+renderKernelPtr selectRenderLutKernel(int32_t a_bitpix, renderKernelPtr a_kernel, RenderParams& a_params,
+                                      std::vector<uint32_t>& a_lut)
+{
+    if (a_kernel == nullptr || (a_bitpix != 8 && a_bitpix != 16))
+        return a_kernel;
+
+    size_t bytesNum = a_bitpix / 8;
+    size_t lutSize = (size_t)1 << a_bitpix;
+
+    /// all the sample values in the big-endian order of the data
+    std::vector<uint8_t> samples(lutSize * bytesNum);
+
+    for (size_t i = 0; i < lutSize; ++i)
+    {
+        if (bytesNum == sizeof(uint16_t))
+        {
+            samples[2 * i] = (uint8_t)(i >> 8);
+            samples[2 * i + 1] = (uint8_t)i;
+        }
+        else
+            samples[i] = (uint8_t)i;
     }
+
+    a_lut.resize(lutSize);
+    a_params.lut = nullptr;
+
+    a_kernel(samples.data(), lutSize, reinterpret_cast<uint8_t*>(a_lut.data()), a_params);
+
+    a_params.lut = a_lut.data();
+
+    return (a_bitpix == 8) ? renderSamplesLut<uint8_t> : renderSamplesLut<int16_t>;
+}
+
+template<typename T> void initRenderParams(RenderParams& a_params, T a_min, T a_max, long double a_bzero, long double a_bscale,
+                                           bool a_zeroScaleFlag, uint32_t a_type)
+{
+    a_params.range = calcRangeMinMaxBScaleBZero<T>(a_min, a_max, a_bzero, a_bscale, a_zeroScaleFlag, a_type,
+                                                   a_params.min, a_params.max);
+    a_params.bzero = a_bzero;
+    a_params.bscale = a_bscale;
+    a_params.type = a_type;
+}
+
+template void initRenderParams<int16_t>(RenderParams&, int16_t, int16_t, long double, long double, bool, uint32_t);
+template void initRenderParams<int32_t>(RenderParams&, int32_t, int32_t, long double, long double, bool, uint32_t);
+template void initRenderParams<int64_t>(RenderParams&, int64_t, int64_t, long double, long double, bool, uint32_t);
+template void initRenderParams<float>(RenderParams&, float, float, long double, long double, bool, uint32_t);
+template void initRenderParams<double>(RenderParams&, double, double, long double, long double, bool, uint32_t);
+
+size_t getRowBandThreadsNumber(size_t a_bandsNumber)
+{
+    size_t threadsNumber = 1;
+
+#ifdef ENABLE_PARALLEL_RENDERING
+    threadsNumber = std::min({ (size_t)std::max(std::thread::hardware_concurrency(), 1u),
+                               (size_t)FITS_RENDER_MAX_THREADS, std::max<size_t>(a_bandsNumber, 1) });
+#endif
+
+    return threadsNumber;
 }
 
+int32_t processRowBands(size_t a_rowsNumber, size_t a_rowPixels, const processRowBandPtr& a_processBand)
+{
+    size_t bandRows = std::max<size_t>(FITS_RENDER_BAND_PIXELS / std::max<size_t>(a_rowPixels, 1), 1);
+    size_t bandsNumber = (a_rowsNumber + bandRows - 1) / bandRows;
+
+    std::atomic<size_t> nextBand(0);
+    std::atomic<bool> bandFailed(false);
+
+    auto processBands = [&]()
+    {
+        std::vector<uint8_t> scratch;
+
+        try
+        {
+            for (size_t band = nextBand.fetch_add(1); band < bandsNumber; band = nextBand.fetch_add(1))
+            {
+                size_t firstRow = band * bandRows;
+
+                a_processBand(firstRow, std::min(firstRow + bandRows, a_rowsNumber), scratch);
+            }
+        }
+        catch (...)
+        {
+            bandFailed = true;
+        }
+    };
+
+    size_t threadsNumber = getRowBandThreadsNumber(bandsNumber);
+
+    /// the pool is started by the first call with more than one band
+    if (threadsNumber > 1)
+        ThreadPool::getInstance().run(threadsNumber - 1, processBands);
+    else
+        processBands();
+
+    return bandFailed ? FITS_GENERAL_ERROR : FITS_GENERAL_SUCCESS;
+}
 
 std::string char2hex(uint8_t a_char)
 {
@@ -1886,194 +2252,738 @@ void normalizeDoubleBuffer(uint8_t* a_buffer, size_t a_size, double a_min, doubl
     }
 }
 
-void getFloatBufferMinMax(const uint8_t* a_buffer, size_t a_size, float& a_min, float& a_max)
+/// BLANK is defined for the integer BITPIX only, a value out of the sample range can't be found
+template<typename T> static inline bool isBlankApplicable(bool a_blankFlag, int64_t a_blank)
 {
-    // checking for buffer granularity
-    if (a_size % sizeof(float) != 0)
-        return;
-
-    uint32_t *tmpBuf = (uint32_t*)(a_buffer);
+    return a_blankFlag && !std::is_floating_point_v<T> &&
+           a_blank >= (int64_t)std::numeric_limits<T>::lowest() && a_blank <= (int64_t)std::numeric_limits<T>::max();
+}
 
-    float minVal = std::numeric_limits<float>::max();
-    float maxVal = std::numeric_limits<float>::min();
+// Min/max of the valid samples of one chunk, the vector kernels process as many samples as they can and the rest is done below
+template<typename T> static void calcChunkMinMax(const uint8_t* a_buffer, size_t a_count, const MinMaxKernelParams& a_params,
+                                                 MinMaxKernelResult& a_result)
+{
+    constexpr int32_t bitpix = std::is_floating_point_v<T> ? -8 * (int32_t)sizeof(T) : 8 * (int32_t)sizeof(T);
 
-////#if defined(ENABLE_OPENMP)
-////#pragma omp parallel for
-////#endif
-    for (size_t i = 0; i < a_size / sizeof(float); ++i)
+    for (size_t i = calcMinMaxVectorized(bitpix, a_buffer, a_count, a_params, a_result); i < a_count; ++i)
     {
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-        uint32_t s = swap32(tmpBuf[i]);
-#else
-        uint32_t s = tmpBuf[i];
-#endif
-        float f = *((float *)&s);
+        T value = readBigEndianSample<T>(a_buffer + i * sizeof(T));
 
-        if (f > maxVal)
-            maxVal = f;
+        if constexpr (std::is_floating_point_v<T>)
+        {
+            if (!std::isfinite(value))
+            {
+                ++a_result.invalidCount;
+                continue;
+            }
 
-        if (f < minVal)
-            minVal = f;
-    }
+            a_result.minValue = std::min(a_result.minValue, (double)value);
+            a_result.maxValue = std::max(a_result.maxValue, (double)value);
+        }
+        else
+        {
+            if (a_params.bBlank && value == (T)a_params.blank)
+            {
+                ++a_result.invalidCount;
+                continue;
+            }
 
-    a_min = minVal;
-    a_max = maxVal;
+            a_result.minValueL = std::min(a_result.minValueL, (int64_t)value);
+            a_result.maxValueL = std::max(a_result.maxValueL, (int64_t)value);
+        }
+    }
 }
 
-void getDoubleBufferMinMax(const uint8_t* a_buffer, size_t a_size, double& a_min, double& a_max)
+template<typename T> int32_t getBufferMinMax(const uint8_t* a_buffer, size_t a_size, T& a_min, T& a_max, size_t& a_invalidCount,
+                                             bool a_blankFlag, int64_t a_blank)
 {
     // checking for buffer granularity
-    if (a_size % sizeof(double) != 0)
-        return;
+    if (a_buffer == nullptr || a_size % sizeof(T) != 0)
+        return FITS_GENERAL_ERROR;
 
-    uint64_t *tmpBuf = (uint64_t*)(a_buffer);
+    const size_t count = a_size / sizeof(T);
+    const size_t chunkSize = FITS_RENDER_BAND_PIXELS;
+    const size_t chunksNumber = (count + chunkSize - 1) / chunkSize;
 
-    double minVal = std::numeric_limits<double>::max();
-    double maxVal = std::numeric_limits<double>::min();
+    MinMaxKernelParams params;
+    params.blank = a_blank;
+    params.bBlank = isBlankApplicable<T>(a_blankFlag, a_blank);
 
-////#if defined(ENABLE_OPENMP)
-////#pragma omp parallel for
-////#endif
-    for (size_t i = 0; i < a_size / sizeof(double); ++i)
+    const MinMaxKernelResult initResult = { std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(),
+                                            std::numeric_limits<int64_t>::max(), std::numeric_limits<int64_t>::min(), 0 };
+    std::vector<MinMaxKernelResult> chunkResults(chunksNumber, initResult);
+
+    /// every chunk is a "row" of its own result, so threads never share one
+    int32_t retVal = processRowBands(chunksNumber, chunkSize, [&](size_t a_firstChunk, size_t a_lastChunk, std::vector<uint8_t>&)
     {
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-        uint64_t s = swap64(tmpBuf[i]);
-#else
-        uint64_t s = tmpBuf[i];
-#endif
-        double f = *((double *)&s);
+        for (size_t chunk = a_firstChunk; chunk < a_lastChunk; ++chunk)
+        {
+            size_t first = chunk * chunkSize;
 
-        if (f > maxVal)
-            maxVal = f;
+            calcChunkMinMax<T>(a_buffer + first * sizeof(T), std::min(chunkSize, count - first), params, chunkResults[chunk]);
+        }
+    });
 
-        if (f < minVal)
-            minVal = f;
-    }
+    if (retVal != FITS_GENERAL_SUCCESS)
+        return retVal;
 
-    a_min = minVal;
-    a_max = maxVal;
-}
+    MinMaxKernelResult result = initResult;
 
-void getByteBufferMinMax(const uint8_t* a_buffer, size_t a_size, uint8_t& a_min, uint8_t& a_max)
-{
-    uint8_t *tmpBuf = (uint8_t*)(a_buffer);
+    for (const MinMaxKernelResult& chunkResult : chunkResults)
+    {
+        result.minValue = std::min(result.minValue, chunkResult.minValue);
+        result.maxValue = std::max(result.maxValue, chunkResult.maxValue);
+        result.minValueL = std::min(result.minValueL, chunkResult.minValueL);
+        result.maxValueL = std::max(result.maxValueL, chunkResult.maxValueL);
+        result.invalidCount += chunkResult.invalidCount;
+    }
 
-    uint8_t minVal = std::numeric_limits<uint8_t>::max();
-    uint8_t maxVal = std::numeric_limits<uint8_t>::min();
+    a_invalidCount = result.invalidCount;
 
-////#if defined(ENABLE_OPENMP)
-////#pragma omp parallel for
-////#endif
-    for (size_t i = 0; i < a_size / sizeof(uint8_t); ++i)
+    if (result.invalidCount == count)
     {
-        if (tmpBuf[i] > maxVal)
-            maxVal = tmpBuf[i];
+        a_min = a_max = 0;
+
+        return FITS_GENERAL_ERROR;
+    }
 
-        if (tmpBuf[i] < minVal)
-            minVal = tmpBuf[i];
+    if constexpr (std::is_floating_point_v<T>)
+    {
+        a_min = (T)result.minValue;
+        a_max = (T)result.maxValue;
+    }
+    else
+    {
+        a_min = (T)result.minValueL;
+        a_max = (T)result.maxValueL;
     }
 
-    a_min = minVal;
-    a_max = maxVal;
+    return FITS_GENERAL_SUCCESS;
 }
 
-void getShortBufferMinMax(const uint8_t* a_buffer, size_t a_size, int16_t& a_min, int16_t& a_max)
+template int32_t getBufferMinMax<uint8_t>(const uint8_t*, size_t, uint8_t&, uint8_t&, size_t&, bool, int64_t);
+template int32_t getBufferMinMax<int16_t>(const uint8_t*, size_t, int16_t&, int16_t&, size_t&, bool, int64_t);
+template int32_t getBufferMinMax<int32_t>(const uint8_t*, size_t, int32_t&, int32_t&, size_t&, bool, int64_t);
+template int32_t getBufferMinMax<int64_t>(const uint8_t*, size_t, int64_t&, int64_t&, size_t&, bool, int64_t);
+template int32_t getBufferMinMax<float>(const uint8_t*, size_t, float&, float&, size_t&, bool, int64_t);
+template int32_t getBufferMinMax<double>(const uint8_t*, size_t, double&, double&, size_t&, bool, int64_t);
+
+/// the segments of the BITPIX 8, 16 and -32 histograms are double, the others are long double
+template<typename T> using DistribSegmentType = std::conditional_t<sizeof(T) <= sizeof(int16_t) || std::is_same_v<T, float>,
+                                                                   double, long double>;
+
+// Histogram segment of a_value the way get*BufferDistribution() compute it, a_segmentsNumber if it's out
+template<typename T> static inline size_t calcDistribSegmentIndex(T a_value, T a_min, DistribSegmentType<T> a_segmentSize,
+                                                                  size_t a_segmentsNumber)
+{
+    DistribSegmentType<T> offset;
+
+    if constexpr (std::is_floating_point_v<T>)
+        offset = std::fabs(a_value - a_min);
+    else
+        offset = (long double)a_value - (long double)a_min;
+
+    DistribSegmentType<T> index = std::floor(offset / a_segmentSize);
+
+    return index < a_segmentsNumber ? (size_t)index : a_segmentsNumber;
+}
+
+// Min/max, the invalid pixels and the fine histogram of one part of the buffer
+template<typename T> struct BufferStatsPart
+{
+    T                   min;
+    T                   max;
+    size_t              invalidCount;
+    std::vector<size_t> bins;
+    std::vector<T>      outliers;       /// the valid values out of the provisional range
+    bool                outliersOverflow;
+};
+
+template<typename T> int32_t getBufferStats(const uint8_t* a_buffer, size_t a_size, T& a_min, T& a_max, size_t& a_invalidCount,
+                                            Histogram& a_histogram, bool a_blankFlag, int64_t a_blank, size_t a_sampleStride)
 {
     // checking for buffer granularity
-    if (a_size % sizeof(int16_t) != 0)
-        return;
+    if (a_buffer == nullptr || a_size % sizeof(T) != 0 || a_sampleStride == 0)
+        return FITS_GENERAL_ERROR;
 
-    int16_t *tmpBuf = (int16_t*)(a_buffer);
+    /// only every a_sampleStride-th sample is counted, the indexes below are the ones of the counted samples
+    const size_t count = (a_size / sizeof(T) + a_sampleStride - 1) / a_sampleStride;
+    const size_t sampleBytes = a_sampleStride * sizeof(T);
+    const bool bBlank = isBlankApplicable<T>(a_blankFlag, a_blank);
+    const T blank = (T)a_blank;
 
-    int16_t minVal = std::numeric_limits<int16_t>::max();
-    int16_t maxVal = std::numeric_limits<int16_t>::min();
+    auto isValid = [&](T a_value)
+    {
+        if constexpr (std::is_floating_point_v<T>)
+            return std::isfinite(a_value);
+        else
+            return !bBlank || a_value != blank;
+    };
 
-////#if defined(ENABLE_OPENMP)
-////#pragma omp parallel for
-////#endif
-    for (size_t i = 0; i < a_size / sizeof(int16_t); ++i)
+    if (a_histogram.getBinsNumber() == 0)
+        a_histogram.setBins(FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER, a_histogram.getSpacing());
+
+    const size_t segmentsNumber = a_histogram.getBinsNumber();
+    const bool bLinear = a_histogram.getSpacing() == FITS_HISTOGRAM_SPACING_LINEAR;
+
+    //// The fine histogram has a bin per value from lowest to lowest + binsNumber - 1, it gives the exact segments.
+    //// It covers every value of BITPIX 8 and 16. The integers of a wider type are binned only if a sample of the pixels
+    //// spans less than binsNumber values, the values out of it are kept aside. The others are counted with a second pass.
+    size_t binsNumber = segmentsNumber * FITS_STATS_FINE_BINS_FACTOR;
+    int64_t lowestL = 0;
+    bool bFineBins = false;
+
+    if constexpr (sizeof(T) <= sizeof(int16_t))
     {
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-        int16_t s = swap16(tmpBuf[i]);
-#else
-        int16_t s = tmpBuf[i];
-#endif
+        lowestL = std::numeric_limits<T>::lowest();
+        binsNumber = (size_t)1 << (8 * sizeof(T));
+        bFineBins = true;
+    }
+    else if constexpr (!std::is_floating_point_v<T>)
+    {
+        const size_t stride = std::max<size_t>(count / FITS_STATS_SAMPLE_PIXELS, 1);
 
-        if (s > maxVal)
-            maxVal = s;
+        bool bSampled = false;
+        T sampleMin = 0, sampleMax = 0;
 
-        if (s < minVal)
-            minVal = s;
+        for (size_t i = 0; i < count; i += stride)
+        {
+            T value = readBigEndianSample<T>(a_buffer + i * sampleBytes);
+
+            if (!isValid(value))
+                continue;
+
+            sampleMin = bSampled ? std::min(sampleMin, value) : value;
+            sampleMax = bSampled ? std::max(sampleMax, value) : value;
+            bSampled = true;
+        }
+
+        uint64_t sampleRange = (uint64_t)(int64_t)sampleMax - (uint64_t)(int64_t)sampleMin;
+
+        lowestL = sampleMin;
+        bFineBins = sampleRange < binsNumber;
+    }
+
+    if (!bFineBins)
+        binsNumber = 0;
+
+    /// one part per thread, each has its private bins
+    const size_t partsNumber = getRowBandThreadsNumber((count + FITS_RENDER_BAND_PIXELS - 1) / FITS_RENDER_BAND_PIXELS);
+    const size_t partSize = (count + partsNumber - 1) / partsNumber;
+
+    std::vector<BufferStatsPart<T>> parts(partsNumber);
+
+    int32_t retVal = processRowBands(partsNumber, std::max<size_t>(partSize, FITS_RENDER_BAND_PIXELS),
+                                     [&](size_t a_firstPart, size_t a_lastPart, std::vector<uint8_t>&)
+    {
+        for (size_t partIndex = a_firstPart; partIndex < a_lastPart; ++partIndex)
+        {
+            BufferStatsPart<T>& part = parts[partIndex];
+
+            const size_t first = std::min(partIndex * partSize, count);
+            const size_t last = std::min(first + partSize, count);
+            const size_t maxOutliers = (last - first) / FITS_STATS_OUTLIERS_DIVIDER;
+
+            T minValue = std::numeric_limits<T>::max();
+            T maxValue = std::numeric_limits<T>::lowest();
+            size_t invalidCount = 0;
+
+            part.bins.assign(binsNumber, 0);
+            part.outliersOverflow = false;
+
+            size_t* bins = part.bins.data();
+
+            for (size_t i = first; i < last; ++i)
+            {
+                T value = readBigEndianSample<T>(a_buffer + i * sampleBytes);
+
+                if (!isValid(value))
+                {
+                    ++invalidCount;
+                    continue;
+                }
+
+                minValue = std::min(minValue, value);
+                maxValue = std::max(maxValue, value);
+
+                if (!bFineBins)
+                    continue;
+
+                size_t bin = (uint64_t)(int64_t)value - (uint64_t)lowestL;
+
+                if (bin < binsNumber)
+                    bins[bin]++;
+                else if (part.outliers.size() < maxOutliers)
+                    part.outliers.push_back(value);
+                else
+                    part.outliersOverflow = true;
+            }
+
+            part.min = minValue;
+            part.max = maxValue;
+            part.invalidCount = invalidCount;
+        }
+    });
+
+    if (retVal != FITS_GENERAL_SUCCESS)
+        return retVal;
+
+    size_t invalidCount = 0;
+    bool outliersOverflow = false;
+    T minValue = std::numeric_limits<T>::max();
+    T maxValue = std::numeric_limits<T>::lowest();
+
+    for (size_t i = 0; i < partsNumber; ++i)
+    {
+        invalidCount += parts[i].invalidCount;
+        outliersOverflow |= parts[i].outliersOverflow;
+
+        /// a part without valid pixels keeps the initial values which can't win
+        minValue = std::min(minValue, parts[i].min);
+        maxValue = std::max(maxValue, parts[i].max);
+
+        if (i > 0)
+        {
+            for (size_t j = 0; j < binsNumber; ++j)
+                parts[0].bins[j] += parts[i].bins[j];
+
+            std::vector<size_t>().swap(parts[i].bins);
+        }
+    }
+
+    a_histogram.clear();
+
+    a_invalidCount = invalidCount;
+
+    if (invalidCount == count)
+    {
+        a_min = a_max = 0;
+
+        return FITS_GENERAL_ERROR;
+    }
+
+    a_min = minValue;
+    a_max = maxValue;
+
+    a_histogram.setRange(minValue, maxValue);
+
+    DistribStats* stats = a_histogram.getBins();
+
+    DistribSegmentType<T> range;
+
+    if constexpr (std::is_floating_point_v<T>)
+        range = std::fabs(maxValue - minValue);
+    else
+        range = (long double)maxValue - (long double)minValue;
+
+    DistribSegmentType<T> segmentSize = range / (DistribSegmentType<T>)segmentsNumber;
+
+    /// the same as get*BufferDistribution(), nothing is counted for a flat image
+    if (areEqual(segmentSize, (DistribSegmentType<T>)0.0))
+        return FITS_GENERAL_SUCCESS;
+
+    auto segmentIndex = [&](T a_value)
+    {
+        return bLinear ? calcDistribSegmentIndex<T>(a_value, minValue, segmentSize, segmentsNumber) : a_histogram.getBinIndex(a_value);
+    };
+
+    if (!bFineBins || outliersOverflow || !bLinear)
+    {
+        //// no fine histogram, too many values out of the provisional range or bins of different widths,
+        //// the histogram is counted again with the final range
+        std::vector<std::vector<size_t>> segments(partsNumber);
+
+        retVal = processRowBands(partsNumber, std::max<size_t>(partSize, FITS_RENDER_BAND_PIXELS),
+                                 [&](size_t a_firstPart, size_t a_lastPart, std::vector<uint8_t>&)
+        {
+            for (size_t partIndex = a_firstPart; partIndex < a_lastPart; ++partIndex)
+            {
+                const size_t first = std::min(partIndex * partSize, count);
+                const size_t last = std::min(first + partSize, count);
+
+                std::vector<size_t>& partSegments = segments[partIndex];
+                partSegments.assign(segmentsNumber + 1, 0);
+
+                for (size_t i = first; i < last; ++i)
+                {
+                    T value = readBigEndianSample<T>(a_buffer + i * sampleBytes);
+
+                    if (isValid(value))
+                        partSegments[segmentIndex(value)]++;
+                }
+            }
+        });
+
+        if (retVal != FITS_GENERAL_SUCCESS)
+            return retVal;
+
+        for (const std::vector<size_t>& partSegments : segments)
+        {
+            for (size_t i = 0; i < segmentsNumber; ++i)
+                stats[i].count += partSegments[i];
+        }
+
+        return FITS_GENERAL_SUCCESS;
+    }
+
+    /// every fine bin is one value, its count goes to the segment of the value
+    const std::vector<size_t>& bins = parts[0].bins;
+
+    for (size_t i = 0; i < binsNumber; ++i)
+    {
+        if (bins[i] == 0)
+            continue;
+
+        T value = (T)(int64_t)((uint64_t)lowestL + i);
+        size_t index = calcDistribSegmentIndex<T>(value, minValue, segmentSize, segmentsNumber);
+
+        if (index < segmentsNumber)
+            stats[index].count += bins[i];
     }
 
-    a_min = minVal;
-    a_max = maxVal;
+    for (const BufferStatsPart<T>& part : parts)
+    {
+        for (T value : part.outliers)
+        {
+            size_t index = calcDistribSegmentIndex<T>(value, minValue, segmentSize, segmentsNumber);
+
+            if (index < segmentsNumber)
+                stats[index].count++;
+        }
+    }
+
+    return FITS_GENERAL_SUCCESS;
 }
 
-void getIntBufferMinMax(const uint8_t* a_buffer, size_t a_size, int32_t& a_min, int32_t& a_max)
+template int32_t getBufferStats<uint8_t>(const uint8_t*, size_t, uint8_t&, uint8_t&, size_t&, Histogram&, bool, int64_t, size_t);
+template int32_t getBufferStats<int16_t>(const uint8_t*, size_t, int16_t&, int16_t&, size_t&, Histogram&, bool, int64_t, size_t);
+template int32_t getBufferStats<int32_t>(const uint8_t*, size_t, int32_t&, int32_t&, size_t&, Histogram&, bool, int64_t, size_t);
+template int32_t getBufferStats<int64_t>(const uint8_t*, size_t, int64_t&, int64_t&, size_t&, Histogram&, bool, int64_t, size_t);
+template int32_t getBufferStats<float>(const uint8_t*, size_t, float&, float&, size_t&, Histogram&, bool, int64_t, size_t);
+template int32_t getBufferStats<double>(const uint8_t*, size_t, double&, double&, size_t&, Histogram&, bool, int64_t, size_t);
+
+//// percentile selection: the samples are mapped to unsigned keys of the same order and the key of a rank is found
+//// 16 bits at a time, counting only the samples whose higher bits are already known
+template<typename T> using SampleKeyType = std::conditional_t<sizeof(T) == 1, uint8_t, std::conditional_t<sizeof(T) == 2, uint16_t,
+                                           std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>>>;
+
+template<typename T> static inline SampleKeyType<T> sampleToKey(T a_value)
 {
-    // checking for buffer granularity
-    if (a_size % sizeof(int32_t) != 0)
-        return;
+    typedef SampleKeyType<T> K;
 
-    int32_t *tmpBuf = (int32_t*)(a_buffer);
+    constexpr K signBit = (K)1 << (8 * sizeof(K) - 1);
+
+    /// -0.0 gets the key of +0.0, it would be below the key of a +0.0 min otherwise
+    if constexpr (std::is_floating_point_v<T>)
+        a_value = a_value == 0 ? 0 : a_value;
+
+    K key;
+    std::memcpy(&key, &a_value, sizeof(K));
+
+    if constexpr (std::is_floating_point_v<T>)
+        return (key & signBit) ? (K)~key : (K)(key | signBit);
+    else if constexpr (std::is_signed_v<T>)
+        return key ^ signBit;
+    else
+        return key;
+}
+
+template<typename T> static inline T keyToSample(SampleKeyType<T> a_key)
+{
+    typedef SampleKeyType<T> K;
+
+    constexpr K signBit = (K)1 << (8 * sizeof(K) - 1);
+
+    if constexpr (std::is_floating_point_v<T>)
+        a_key = (a_key & signBit) ? (K)(a_key & ~signBit) : (K)~a_key;
+    else if constexpr (std::is_signed_v<T>)
+        a_key ^= signBit;
+
+    T value;
+    std::memcpy(&value, &a_key, sizeof(T));
+
+    return value;
+}
 
-    int32_t minVal = std::numeric_limits<int32_t>::max();
-    int32_t maxVal = std::numeric_limits<int32_t>::min();
+// The samples of a_ranks (counted among the valid samples) found by radix selection on all the cores. The keys are
+// counted relative to the key of a_min, so only the bits of the key range are selected.
+template<typename T> static int32_t selectBufferSamples(const uint8_t* a_buffer, size_t a_count, bool a_blankFlag, int64_t a_blank,
+                                                        T a_min, T a_max, const size_t (&a_ranks)[2], T (&a_values)[2])
+{
+    typedef SampleKeyType<T> K;
+
+    constexpr uint32_t digitBits = std::min<uint32_t>(8 * sizeof(K), 16);
+    constexpr size_t digitsNumber = (size_t)1 << digitBits;
+
+    const bool bBlank = isBlankApplicable<T>(a_blankFlag, a_blank);
+    const T blank = (T)a_blank;
 
-////#if defined(ENABLE_OPENMP)
-////#pragma omp parallel for
-////#endif
-    for (size_t i = 0; i < a_size / sizeof(int32_t); ++i)
+    auto isValid = [&](T a_value)
     {
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-        int32_t s = swap32(tmpBuf[i]);
-#else
-        int32_t s = tmpBuf[i];
-#endif
+        if constexpr (std::is_floating_point_v<T>)
+            return std::isfinite(a_value);
+        else
+            return !bBlank || a_value != blank;
+    };
+
+    const K minKey = sampleToKey<T>(a_min);
+    const uint32_t keyBits = std::bit_width((K)(sampleToKey<T>(a_max) - minKey));
+
+    const size_t partsNumber = getRowBandThreadsNumber((a_count + FITS_RENDER_BAND_PIXELS - 1) / FITS_RENDER_BAND_PIXELS);
+    const size_t partSize = (a_count + partsNumber - 1) / partsNumber;
+    const size_t partPixels = std::max<size_t>(partSize, FITS_RENDER_BAND_PIXELS);
+
+    K prefixes[2] = { 0, 0 };
+    size_t ranks[2] = { a_ranks[0], a_ranks[1] };
+    uint32_t resolvedBits = 0;
+    bool bCollect = false;
+
+    //// the prefix is compared by shifting in two steps, keyBits - resolvedBits may be the whole key
+    auto hasPrefix = [&](K a_key, int32_t a_target)
+    {
+        return ((a_key >> (keyBits - resolvedBits - 1)) >> 1) == ((prefixes[a_target] >> (keyBits - resolvedBits - 1)) >> 1);
+    };
+
+    while (resolvedBits < keyBits && !bCollect)
+    {
+        const uint32_t levelBits = std::min(digitBits, keyBits - resolvedBits);
+        const uint32_t shift = keyBits - resolvedBits - levelBits;
+        const size_t digitMask = ((size_t)1 << levelBits) - 1;
+
+        std::vector<std::vector<size_t>> parts(partsNumber);
+
+        int32_t retVal = processRowBands(partsNumber, partPixels, [&](size_t a_firstPart, size_t a_lastPart, std::vector<uint8_t>&)
+        {
+            for (size_t partIndex = a_firstPart; partIndex < a_lastPart; ++partIndex)
+            {
+                const size_t first = std::min(partIndex * partSize, a_count);
+                const size_t last = std::min(first + partSize, a_count);
 
-        if (s > maxVal)
-            maxVal = s;
+                std::vector<size_t>& counts = parts[partIndex];
+                counts.assign(2 * digitsNumber, 0);
 
-        if (s < minVal)
-            minVal = s;
+                for (size_t i = first; i < last; ++i)
+                {
+                    T value = readBigEndianSample<T>(a_buffer + i * sizeof(T));
+
+                    if (!isValid(value))
+                        continue;
+
+                    K key = sampleToKey<T>(value) - minKey;
+                    size_t digit = (key >> shift) & digitMask;
+
+                    if (hasPrefix(key, 0))
+                        counts[digit]++;
+
+                    if (hasPrefix(key, 1))
+                        counts[digitsNumber + digit]++;
+                }
+            }
+        });
+
+        if (retVal != FITS_GENERAL_SUCCESS)
+            return retVal;
+
+        for (size_t i = 1; i < partsNumber; ++i)
+        {
+            for (size_t j = 0; j < 2 * digitsNumber; ++j)
+                parts[0][j] += parts[i][j];
+        }
+
+        bCollect = true;
+
+        for (int32_t target = 0; target < 2; ++target)
+        {
+            const size_t* counts = parts[0].data() + target * digitsNumber;
+            size_t digit = 0;
+
+            while (digit < digitMask && ranks[target] >= counts[digit])
+                ranks[target] -= counts[digit++];
+
+            prefixes[target] |= (K)digit << shift;
+
+            bCollect &= counts[digit] <= FITS_PERCENTILE_COLLECT_LIMIT;
+        }
+
+        resolvedBits += levelBits;
+    }
+
+    if (resolvedBits < keyBits)
+    {
+        //// few samples are left, they are collected and sorted partially
+        std::vector<std::vector<K>> parts(partsNumber * 2);
+
+        int32_t retVal = processRowBands(partsNumber, partPixels, [&](size_t a_firstPart, size_t a_lastPart, std::vector<uint8_t>&)
+        {
+            for (size_t partIndex = a_firstPart; partIndex < a_lastPart; ++partIndex)
+            {
+                const size_t first = std::min(partIndex * partSize, a_count);
+                const size_t last = std::min(first + partSize, a_count);
+
+                for (size_t i = first; i < last; ++i)
+                {
+                    T value = readBigEndianSample<T>(a_buffer + i * sizeof(T));
+
+                    if (!isValid(value))
+                        continue;
+
+                    K key = sampleToKey<T>(value) - minKey;
+
+                    if (hasPrefix(key, 0))
+                        parts[partIndex * 2].push_back(key);
+
+                    if (hasPrefix(key, 1))
+                        parts[partIndex * 2 + 1].push_back(key);
+                }
+            }
+        });
+
+        if (retVal != FITS_GENERAL_SUCCESS)
+            return retVal;
+
+        for (int32_t target = 0; target < 2; ++target)
+        {
+            std::vector<K> keys;
+
+            for (size_t i = 0; i < partsNumber; ++i)
+                keys.insert(keys.end(), parts[i * 2 + target].begin(), parts[i * 2 + target].end());
+
+            if (ranks[target] >= keys.size())
+                return FITS_GENERAL_ERROR;
+
+            std::nth_element(keys.begin(), keys.begin() + ranks[target], keys.end());
+            prefixes[target] = keys[ranks[target]];
+        }
     }
 
-    a_min = minVal;
-    a_max = maxVal;
+    a_values[0] = keyToSample<T>(prefixes[0] + minKey);
+    a_values[1] = keyToSample<T>(prefixes[1] + minKey);
+
+    return FITS_GENERAL_SUCCESS;
 }
 
-void getLongBufferMinMax(const uint8_t* a_buffer, size_t a_size, int64_t& a_min, int64_t& a_max)
+template<typename T> int32_t getBufferPercentileMinMax(const uint8_t* a_buffer, size_t a_size, float a_percentile, uint32_t a_method,
+                                                       T& a_newMin, T& a_newMax, bool a_blankFlag, int64_t a_blank)
 {
     // checking for buffer granularity
-    if (a_size % sizeof(int64_t) != 0)
-        return;
+    if (a_buffer == nullptr || a_size % sizeof(T) != 0 || a_size == 0)
+        return FITS_GENERAL_ERROR;
+
+    const size_t count = a_size / sizeof(T);
 
-    int64_t *tmpBuf = (int64_t*)(a_buffer);
+    /// the same percentiles calcPercentileMinMax() uses
+    const float percentileDelta = (100.0f - a_percentile) / 2.0f;
+    const double percentiles[2] = { std::clamp(percentileDelta, 0.0f, 100.0f) / 100.0,
+                                    std::clamp(a_percentile + percentileDelta, 0.0f, 100.0f) / 100.0 };
 
-    int64_t minVal = std::numeric_limits<int64_t>::max();
-    int64_t maxVal = std::numeric_limits<int64_t>::min();
+    T values[2];
 
-////#if defined(ENABLE_OPENMP)
-////#pragma omp parallel for
-////#endif
-    for (size_t i = 0; i < a_size / sizeof(int64_t); ++i)
+    if (a_method == FITS_PERCENTILE_METHOD_SAMPLED)
     {
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-        int64_t s = swap64(tmpBuf[i]);
-#else
-        uint64_t s = tmpBuf[i];
-#endif
+        const size_t stride = std::max<size_t>(count / FITS_PERCENTILE_SAMPLE_PIXELS, 1);
+        const bool bBlank = isBlankApplicable<T>(a_blankFlag, a_blank);
+
+        std::vector<T> samples;
+        samples.reserve(count / stride + 1);
+
+        for (size_t i = 0; i < count; i += stride)
+        {
+            T value = readBigEndianSample<T>(a_buffer + i * sizeof(T));
+
+            if constexpr (std::is_floating_point_v<T>)
+            {
+                if (!std::isfinite(value))
+                    continue;
+            }
+            else if (bBlank && value == (T)a_blank)
+                continue;
+
+            samples.push_back(value);
+        }
+
+        if (samples.empty())
+            return FITS_GENERAL_ERROR;
+
+        for (int32_t i = 0; i < 2; ++i)
+        {
+            auto nth = samples.begin() + std::llround(percentiles[i] * (samples.size() - 1));
+
+            std::nth_element(samples.begin(), nth, samples.end());
+            values[i] = *nth;
+        }
+    }
+    else
+    {
+        T minValue, maxValue;
+        size_t invalidCount = 0;
+
+        /// the valid samples are counted first, the ranks depend on their number
+        if (getBufferMinMax<T>(a_buffer, a_size, minValue, maxValue, invalidCount, a_blankFlag, a_blank) != FITS_GENERAL_SUCCESS)
+            return FITS_GENERAL_ERROR;
 
-        if (s > maxVal)
-            maxVal = s;
+        const size_t validCount = count - invalidCount;
+        const size_t ranks[2] = { (size_t)std::llround(percentiles[0] * (validCount - 1)),
+                                  (size_t)std::llround(percentiles[1] * (validCount - 1)) };
 
-        if (s < minVal)
-            minVal = s;
+        int32_t retVal = selectBufferSamples<T>(a_buffer, count, a_blankFlag, a_blank, minValue, maxValue, ranks, values);
+
+        if (retVal != FITS_GENERAL_SUCCESS)
+            return retVal;
     }
 
-    a_min = minVal;
-    a_max = maxVal;
+    a_newMin = values[0];
+    a_newMax = values[1];
+
+    return FITS_GENERAL_SUCCESS;
+}
+
+template int32_t getBufferPercentileMinMax<uint8_t>(const uint8_t*, size_t, float, uint32_t, uint8_t&, uint8_t&, bool, int64_t);
+template int32_t getBufferPercentileMinMax<int16_t>(const uint8_t*, size_t, float, uint32_t, int16_t&, int16_t&, bool, int64_t);
+template int32_t getBufferPercentileMinMax<int32_t>(const uint8_t*, size_t, float, uint32_t, int32_t&, int32_t&, bool, int64_t);
+template int32_t getBufferPercentileMinMax<int64_t>(const uint8_t*, size_t, float, uint32_t, int64_t&, int64_t&, bool, int64_t);
+template int32_t getBufferPercentileMinMax<float>(const uint8_t*, size_t, float, uint32_t, float&, float&, bool, int64_t);
+template int32_t getBufferPercentileMinMax<double>(const uint8_t*, size_t, float, uint32_t, double&, double&, bool, int64_t);
+
+void getFloatBufferMinMax(const uint8_t* a_buffer, size_t a_size, float& a_min, float& a_max)
+{
+    size_t invalidCount = 0;
+
+    getBufferMinMax<float>(a_buffer, a_size, a_min, a_max, invalidCount);
+}
+
+void getDoubleBufferMinMax(const uint8_t* a_buffer, size_t a_size, double& a_min, double& a_max)
+{
+    size_t invalidCount = 0;
+
+    getBufferMinMax<double>(a_buffer, a_size, a_min, a_max, invalidCount);
+}
+
+void getByteBufferMinMax(const uint8_t* a_buffer, size_t a_size, uint8_t& a_min, uint8_t& a_max)
+{
+    size_t invalidCount = 0;
+
+    getBufferMinMax<uint8_t>(a_buffer, a_size, a_min, a_max, invalidCount);
+}
+
+void getShortBufferMinMax(const uint8_t* a_buffer, size_t a_size, int16_t& a_min, int16_t& a_max)
+{
+    size_t invalidCount = 0;
+
+    getBufferMinMax<int16_t>(a_buffer, a_size, a_min, a_max, invalidCount);
+}
+
+void getIntBufferMinMax(const uint8_t* a_buffer, size_t a_size, int32_t& a_min, int32_t& a_max)
+{
+    size_t invalidCount = 0;
+
+    getBufferMinMax<int32_t>(a_buffer, a_size, a_min, a_max, invalidCount);
+}
+
+void getLongBufferMinMax(const uint8_t* a_buffer, size_t a_size, int64_t& a_min, int64_t& a_max)
+{
+    size_t invalidCount = 0;
+
+    getBufferMinMax<int64_t>(a_buffer, a_size, a_min, a_max, invalidCount);
 }
 
 void getFloatBufferDistribution(const uint8_t* a_buffer, size_t a_size, float a_min, float a_max, size_t& a_count, float& a_percent)
@@ -2151,7 +3061,7 @@ void getDoubleBufferDistribution(const uint8_t* a_buffer, size_t a_size, double
 }
 
 void getFloatBufferDistribution(const uint8_t* a_buffer, size_t a_size, float a_min, float a_max,
-                                DistribStats (&a_stats)[FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER])
+                                DistribStats* a_stats, size_t a_binsNumber)
 {
     // checking for buffer granularity
     if (a_size % sizeof(float) != 0)
@@ -2162,7 +3072,7 @@ void getFloatBufferDistribution(const uint8_t* a_buffer, size_t a_size, float a_
     size_t pixelCount = a_size / sizeof(float);
 
     double rangeF = std::fabs(a_max - a_min);
-    double segmentSizeF = rangeF/(double)FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER;
+    double segmentSizeF = rangeF/(double)a_binsNumber;
 
     if (areEqual(segmentSizeF, 0.0))
         return;
@@ -2181,7 +3091,7 @@ void getFloatBufferDistribution(const uint8_t* a_buffer, size_t a_size, float a_
 
         uint32_t index = std::floor(std::fabs(f - a_min) / segmentSizeF);
 
-        if (index >= FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER)
+        if (index >= a_binsNumber)
             continue;
 
         a_stats[index].count++;
@@ -2189,7 +3099,7 @@ void getFloatBufferDistribution(const uint8_t* a_buffer, size_t a_size, float a_
 }
 
 void getDoubleBufferDistribution(const uint8_t* a_buffer, size_t a_size, double a_min, double a_max,
-                                 DistribStats (&a_stats)[FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER])
+                                 DistribStats* a_stats, size_t a_binsNumber)
 {
     // checking for buffer granularity
     if (a_size % sizeof(double) != 0)
@@ -2200,7 +3110,7 @@ void getDoubleBufferDistribution(const uint8_t* a_buffer, size_t a_size, double
     size_t pixelCount = a_size / sizeof(double);
 
     long double rangeF = std::fabs(a_max - a_min);
-    long double segmentSizeF = rangeF/(long double)FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER;
+    long double segmentSizeF = rangeF/(long double)a_binsNumber;
 
     if (areEqual(segmentSizeF, 0.0L))
         return;
@@ -2219,7 +3129,7 @@ void getDoubleBufferDistribution(const uint8_t* a_buffer, size_t a_size, double
 
         uint32_t index = std::floor(std::fabs(f - a_min) / segmentSizeF);
 
-        if (index >= FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER)
+        if (index >= a_binsNumber)
             continue;
 
         a_stats[index].count++;
@@ -2253,14 +3163,14 @@ void getByteBufferDistribution(const uint8_t* a_buffer, size_t a_size, int8_t a_
 }
 
 void getByteBufferDistribution(const uint8_t* a_buffer, size_t a_size, int8_t a_min, int8_t a_max,
-                               DistribStats (&a_stats)[FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER])
+                               DistribStats* a_stats, size_t a_binsNumber)
 {
     int8_t* tmpBuf = (int8_t*)(a_buffer);
 
     size_t pixelCount = a_size / sizeof(int8_t);
 
     double rangeF = std::abs(a_max - a_min);
-    double segmentSizeF = rangeF/(double)FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER;
+    double segmentSizeF = rangeF/(double)a_binsNumber;
 
     if (areEqual(segmentSizeF, 0.0))
         return;
@@ -2272,7 +3182,7 @@ void getByteBufferDistribution(const uint8_t* a_buffer, size_t a_size, int8_t a_
     {
         uint32_t index = std::floor(std::abs(tmpBuf[i] - a_min) / segmentSizeF);
 
-        if (index >= FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER)
+        if (index >= a_binsNumber)
             continue;
 
         a_stats[index].count++;
@@ -2280,12 +3190,12 @@ void getByteBufferDistribution(const uint8_t* a_buffer, size_t a_size, int8_t a_
 }
 
 void getUByteBufferDistribution(const uint8_t* a_buffer, size_t a_size, uint8_t a_min, uint8_t a_max,
-                               DistribStats (&a_stats)[FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER])
+                               DistribStats* a_stats, size_t a_binsNumber)
 {
     size_t pixelCount = a_size / sizeof(uint8_t);
 
     double rangeF = std::abs(a_max - a_min);
-    double segmentSizeF = rangeF/(double)FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER;
+    double segmentSizeF = rangeF/(double)a_binsNumber;
 
     if (areEqual(segmentSizeF, 0.0))
         return;
@@ -2297,7 +3207,7 @@ void getUByteBufferDistribution(const uint8_t* a_buffer, size_t a_size, uint8_t
     {
         uint32_t index = std::floor(std::abs(a_buffer[i] - a_min) / segmentSizeF);
 
-        if (index >= FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER)
+        if (index >= a_binsNumber)
             continue;
 
         a_stats[index].count++;
@@ -2342,7 +3252,7 @@ void getShortBufferDistribution(const uint8_t* a_buffer, size_t a_size, int16_t
 }
 
 void getShortBufferDistribution(const uint8_t* a_buffer, size_t a_size, int16_t a_min, int16_t a_max,
-                                DistribStats (&a_stats)[FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER])
+                                DistribStats* a_stats, size_t a_binsNumber)
 {
     // checking for buffer granularity
     if (a_size % sizeof(int16_t) != 0)
@@ -2353,7 +3263,7 @@ void getShortBufferDistribution(const uint8_t* a_buffer, size_t a_size, int16_t
     size_t pixelCount = a_size / sizeof(int16_t);
 
     double rangeF = std::fabs(a_max - a_min);
-    double segmentSizeF = rangeF/(double)FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER;
+    double segmentSizeF = rangeF/(double)a_binsNumber;
 
     if (areEqual(segmentSizeF, 0.0))
         return;
@@ -2372,7 +3282,7 @@ void getShortBufferDistribution(const uint8_t* a_buffer, size_t a_size, int16_t
 
         uint32_t index = std::floor(std::fabs(s - a_min) / segmentSizeF);
 
-        if (index >= FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER)
+        if (index >= a_binsNumber)
             continue;
 
         a_stats[index].count++;
@@ -2417,7 +3327,7 @@ void getIntBufferDistribution(const uint8_t* a_buffer, size_t a_size, int32_t a_
 }
 
 void getIntBufferDistribution(const uint8_t* a_buffer, size_t a_size, int32_t a_min, int32_t a_max,
-                              DistribStats (&a_stats)[FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER])
+                              DistribStats* a_stats, size_t a_binsNumber)
 {
     // checking for buffer granularity
     if (a_size % sizeof(int32_t) != 0)
@@ -2428,7 +3338,7 @@ void getIntBufferDistribution(const uint8_t* a_buffer, size_t a_size, int32_t a_
     size_t pixelCount = a_size / sizeof(int32_t);
 
     long double rangeF = std::fabs(a_max - a_min);
-    long double segmentSizeF = rangeF/(long double)FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER;
+    long double segmentSizeF = rangeF/(long double)a_binsNumber;
 
     if (areEqual(segmentSizeF, 0.0L))
         return;
@@ -2447,7 +3357,7 @@ void getIntBufferDistribution(const uint8_t* a_buffer, size_t a_size, int32_t a_
 
         uint32_t index = std::floor(std::fabs(s - a_min) / segmentSizeF);
 
-        if (index >= FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER)
+        if (index >= a_binsNumber)
             continue;
 
         a_stats[index].count++;
@@ -2492,7 +3402,7 @@ void getLongBufferDistribution(const uint8_t* a_buffer, size_t a_size, int64_t a
 }
 
 void getLongBufferDistribution(const uint8_t* a_buffer, size_t a_size, int64_t a_min, int64_t a_max,
-                               DistribStats (&a_stats)[FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER])
+                               DistribStats* a_stats, size_t a_binsNumber)
 {
     // checking for buffer granularity
     if (a_size % sizeof(int64_t) != 0)
@@ -2503,7 +3413,7 @@ void getLongBufferDistribution(const uint8_t* a_buffer, size_t a_size, int64_t a
     size_t pixelCount = a_size / sizeof(int64_t);
 
     long double rangeF = std::fabs(a_max - a_min);
-    long double segmentSizeF = rangeF/(long double)FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER;
+    long double segmentSizeF = rangeF/(long double)a_binsNumber;
 
     if (areEqual(segmentSizeF, 0.0L))
         return;
@@ -2522,18 +3432,18 @@ void getLongBufferDistribution(const uint8_t* a_buffer, size_t a_size, int64_t a
 
         uint32_t index = std::floor(std::fabs(f - a_min) / segmentSizeF);
 
-        if (index >= FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER)
+        if (index >= a_binsNumber)
             continue;
 
         a_stats[index].count++;
     }
 }
 
-float getMaxDistribPercent(const DistribStats (&a_stats)[FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER], int32_t& a_segment)
+float getMaxDistribPercent(const DistribStats* a_stats, size_t a_binsNumber, int32_t& a_segment)
 {
     float maxPercent = 0.0;
 
-    for (int32_t i = 0; i < FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER; ++i)
+    for (int32_t i = 0; i < (int32_t)a_binsNumber; ++i)
     {
         if (a_stats[i].percent > maxPercent)
         {
@@ -2545,7 +3455,7 @@ float getMaxDistribPercent(const DistribStats (&a_stats)[FITS_VALUE_DISTRIBUTION
     return maxPercent;
 }
 
-float getMaxDistribPercentRange(const DistribStats (&a_stats)[FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER],
+float getMaxDistribPercentRange(const DistribStats* a_stats, size_t a_binsNumber,
                                 int32_t& a_startSegment, int32_t& a_endSegment, float& a_startPercent, float& a_endPercent,
                                 float a_percent)
 {
@@ -2553,12 +3463,12 @@ float getMaxDistribPercentRange(const DistribStats (&a_stats)[FITS_VALUE_DISTRIB
 
     float maxPercent = 0.0, startPercent = 0.0, endPercent = 0.0;
 
-    maxPercent = getMaxDistribPercent(a_stats, maxSegment);
+    maxPercent = getMaxDistribPercent(a_stats, a_binsNumber, maxSegment);
 
     startSegment = endSegment = maxSegment;
     startPercent = endPercent = maxPercent;
 
-    for (int32_t i = maxSegment + 1; i < FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER; ++i)
+    for (int32_t i = maxSegment + 1; i < (int32_t)a_binsNumber; ++i)
     {
         if (a_stats[i].percent >= a_percent)
         {
@@ -2586,61 +3496,58 @@ float getMaxDistribPercentRange(const DistribStats (&a_stats)[FITS_VALUE_DISTRIB
 }
 
 template<typename T> void getBufferDistributionMinMax(const uint8_t* a_buffer, size_t a_size, float a_percent, T a_min, T a_max,
-                                                      T& a_minNew, T& a_maxNew,
-                                                      DistribStats (&a_stats)[FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER],
+                                                      T& a_minNew, T& a_maxNew, Histogram& a_histogram,
                                                       bool a_isDistribCounted)
 {
-    //// commented this out as double type suits better in corner cases of integer divisions
-    ////T rangeF = std::fabs(a_max - a_min);
-    ////T segmentSizeF = rangeF/(T)FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER;
-
-    long double rangeF = std::abs(a_max - a_min);
-    long double segmentSizeF = rangeF/(T)FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER;
-
     if (!a_isDistribCounted)
     {
-        if (std::is_same<T, float>::value)
-            getFloatBufferDistribution(a_buffer, a_size, a_min, a_max, a_stats);
-        else if (std::is_same<T, double>::value)
-            getDoubleBufferDistribution(a_buffer, a_size, a_min, a_max, a_stats);
-        else if (std::is_same<T, int8_t>::value || std::is_same<T, uint8_t>::value)
-            getUByteBufferDistribution(a_buffer, a_size, a_min, a_max, a_stats);
-        else if (std::is_same<T, int16_t>::value)
-            getShortBufferDistribution(a_buffer, a_size, a_min, a_max, a_stats);
-        else if (std::is_same<T, int32_t>::value)
-            getIntBufferDistribution(a_buffer, a_size, a_min, a_max, a_stats);
-        else if (std::is_same<T, int64_t>::value)
-            getLongBufferDistribution(a_buffer, a_size, a_min, a_max, a_stats);
-        else
-            return;
-    }
-
-    double totalCount = a_size / sizeof(T);
-    a_stats[0].percent = (double)a_stats[0].count / totalCount;
-    a_stats[0].cdf = a_stats[0].count; /// initial CDF (cumulative distribution function) value
+        a_histogram.clear();
 
-    for (int32_t i = 1; i < FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER; ++i)
-    {
-        a_stats[i].percent = (double)a_stats[i].count / totalCount;
-        a_stats[i].cdf = a_stats[i-1].cdf + a_stats[i].count; /// CDF (cumulative distribution function) value
+        if (a_histogram.getSpacing() != FITS_HISTOGRAM_SPACING_LINEAR)
+        {
+            T tmpMin, tmpMax;
+            size_t invalidCount;
 
-        ///std::cout << "[INFO]: (F/D) index = " << i << " , a_stats[i].count = " << a_stats[i].count <<
-        ///             " , percent = " << a_stats[i].percent << " , a_stats[i].cdf = " << a_stats[i].cdf << std::endl;
+            getBufferStats<T>(a_buffer, a_size, tmpMin, tmpMax, invalidCount, a_histogram);
+        }
+        else
+        {
+            a_histogram.setRange(a_min, a_max);
+
+            if (std::is_same<T, float>::value)
+                getFloatBufferDistribution(a_buffer, a_size, a_min, a_max, a_histogram.getBins(), a_histogram.getBinsNumber());
+            else if (std::is_same<T, double>::value)
+                getDoubleBufferDistribution(a_buffer, a_size, a_min, a_max, a_histogram.getBins(), a_histogram.getBinsNumber());
+            else if (std::is_same<T, int8_t>::value || std::is_same<T, uint8_t>::value)
+                getUByteBufferDistribution(a_buffer, a_size, a_min, a_max, a_histogram.getBins(), a_histogram.getBinsNumber());
+            else if (std::is_same<T, int16_t>::value)
+                getShortBufferDistribution(a_buffer, a_size, a_min, a_max, a_histogram.getBins(), a_histogram.getBinsNumber());
+            else if (std::is_same<T, int32_t>::value)
+                getIntBufferDistribution(a_buffer, a_size, a_min, a_max, a_histogram.getBins(), a_histogram.getBinsNumber());
+            else if (std::is_same<T, int64_t>::value)
+                getLongBufferDistribution(a_buffer, a_size, a_min, a_max, a_histogram.getBins(), a_histogram.getBinsNumber());
+            else
+                return;
+        }
     }
 
+    a_histogram.calcPercents(a_size / sizeof(T));
+
     int32_t startSegment = 0, endSegment = 0;
     float startPercent = 0.0, endPercent = 0.0;
 
-    getMaxDistribPercentRange(a_stats, startSegment, endSegment, startPercent, endPercent, a_percent);
+    getMaxDistribPercentRange(a_histogram.getBins(), a_histogram.getBinsNumber(), startSegment, endSegment,
+                              startPercent, endPercent, a_percent);
 
     ///std::cout << "[INFO]: (F/D) startSegment = " << startSegment << " , endSegment = " << endSegment <<
     ///             " , startPercent = " << startPercent << " , endPercent = " << endPercent << std::endl;
 
-    a_minNew = a_min + startSegment*segmentSizeF;
-    a_maxNew = a_minNew + (endSegment - startSegment + 1)*segmentSizeF;
+    //// the bin borders, the bins of the log and asinh histograms are of different widths
+    long double tmpMinNew = a_histogram.getBinStart(startSegment);
+    long double tmpMaxNew = a_histogram.getBinStart(endSegment + 1);
 
-    double tmpMinNew = a_min + startSegment*segmentSizeF;
-    double tmpMaxNew = a_minNew + (endSegment - startSegment + 1)*segmentSizeF;
+    a_minNew = tmpMinNew;
+    a_maxNew = tmpMaxNew;
 
     //// this check is especially against integer truncating case where the range values lost their
     //// original values due to division/multiplication of integers, so we explicitly check this case and
@@ -2653,44 +3560,24 @@ template<typename T> void getBufferDistributionMinMax(const uint8_t* a_buffer, s
     /////////////////////////////////////////////////////////////////////////////////////////////////////
 }
 
-template void getBufferDistributionMinMax<float>(const uint8_t*, size_t, float, float, float, float&,
-                                                 float&, DistribStats (&)[FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER],
-                                                 bool a_isDistribCounted);
-
-template void getBufferDistributionMinMax<double>(const uint8_t*, size_t, float, double, double, double&,
-                                                  double&, DistribStats (&)[FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER],
-                                                  bool a_isDistribCounted);
+template void getBufferDistributionMinMax<float>(const uint8_t*, size_t, float, float, float, float&, float&, Histogram&, bool);
+template void getBufferDistributionMinMax<double>(const uint8_t*, size_t, float, double, double, double&, double&, Histogram&, bool);
+template void getBufferDistributionMinMax<uint8_t>(const uint8_t*, size_t, float, uint8_t, uint8_t, uint8_t&, uint8_t&, Histogram&, bool);
+template void getBufferDistributionMinMax<int16_t>(const uint8_t*, size_t, float, int16_t, int16_t, int16_t&, int16_t&, Histogram&, bool);
+template void getBufferDistributionMinMax<int32_t>(const uint8_t*, size_t, float, int32_t, int32_t, int32_t&, int32_t&, Histogram&, bool);
+template void getBufferDistributionMinMax<int64_t>(const uint8_t*, size_t, float, int64_t, int64_t, int64_t&, int64_t&, Histogram&, bool);
 
-template void getBufferDistributionMinMax<int8_t>(const uint8_t*, size_t, float, int8_t, int8_t, int8_t&,
-                                                  int8_t&, DistribStats (&)[FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER],
-                                                  bool a_isDistribCounted);
-
-template void getBufferDistributionMinMax<uint8_t>(const uint8_t*, size_t, float, uint8_t, uint8_t, uint8_t&,
-                                                   uint8_t&, DistribStats (&)[FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER],
-                                                   bool a_isDistribCounted);
-
-template void getBufferDistributionMinMax<int16_t>(const uint8_t*, size_t, float, int16_t, int16_t, int16_t&,
-                                                   int16_t&, DistribStats (&)[FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER],
-                                                   bool a_isDistribCounted);
-
-template void getBufferDistributionMinMax<int32_t>(const uint8_t*, size_t, float, int32_t, int32_t, int32_t&,
-                                                   int32_t&, DistribStats (&)[FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER],
-                                                   bool a_isDistribCounted);
-
-template void getBufferDistributionMinMax<int64_t>(const uint8_t*, size_t, float, int64_t, int64_t, int64_t&,
-                                                   int64_t&, DistribStats (&)[FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER],
-                                                   bool a_isDistribCounted);
-
-template<typename T> T calcPercentile(libnfits::DistribStats const* a_distribStats, T a_min, T a_max,
-                                     float a_percentile, size_t a_pixelNum)
+template<typename T> T calcPercentile(const Histogram& a_histogram, float a_percentile, size_t a_pixelNum)
 {
+    const DistribStats* distribStats = a_histogram.getBins();
+
     int32_t percentilePos = std::round((a_percentile/100.0f) * a_pixelNum);
 
     int32_t binPos = 0;
 
-    for (size_t i = 0; i < FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER; ++i)
+    for (size_t i = 0; i < a_histogram.getBinsNumber(); ++i)
     {
-        if (a_distribStats[i].cdf > percentilePos)
+        if (distribStats[i].cdf > percentilePos)
         {
             binPos = i;
             break;
@@ -2700,30 +3587,23 @@ template<typename T> T calcPercentile(libnfits::DistribStats const* a_distribSta
     ///if (binPos == -1)   /// No suitable histogram bin found. Not sure if such case can occurr, but still checking.
     ///    return;         /// Will return a_newMin = a_newMax = 0;
 
-    long double binStartVal = a_min, binEndVal = a_max; ///T
-
-    long double range = a_max - a_min; ///T
-
-    long double step = (long double)range / FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER;
-
-    binStartVal += (step * binPos);
-
-    binEndVal = binStartVal + step;
+    long double binStartVal = a_histogram.getBinStart(binPos);
+    long double binEndVal = a_histogram.getBinStart(binPos + 1);
 
-    size_t cdfPrev = binPos > 0 ? a_distribStats[binPos - 1].cdf : 0;
+    size_t cdfPrev = binPos > 0 ? distribStats[binPos - 1].cdf : 0;
 
     long double fraction;
-    if (a_distribStats[binPos].count == 0)
+    if (distribStats[binPos].count == 0)
         fraction = 0.0L;
     else
-        fraction = static_cast<long double>((percentilePos - cdfPrev)) / a_distribStats[binPos].count;
+        fraction = static_cast<long double>((percentilePos - cdfPrev)) / distribStats[binPos].count;
 
-    long double percentileVal = binStartVal + fraction * step;
+    long double percentileVal = binStartVal + fraction * (binEndVal - binStartVal);
 
     return static_cast<T>(percentileVal);
 }
 
-template<typename T> void calcPercentileMinMax(libnfits::DistribStats const* a_distribStats, T a_min, T a_max,
+template<typename T> void calcPercentileMinMax(const Histogram& a_histogram, T a_min, T a_max,
                                                float a_percentile, T& a_newMin, T& a_newMax, size_t a_pixelNum)
 {
     a_newMin = a_newMax = 0;
@@ -2734,9 +3614,9 @@ template<typename T> void calcPercentileMinMax(libnfits::DistribStats const* a_d
 
     float percentileMax = a_percentile + percentileDelta;
 
-    a_newMin = calcPercentile<T>(a_distribStats, a_min, a_max, percentileMin, a_pixelNum);
+    a_newMin = calcPercentile<T>(a_histogram, percentileMin, a_pixelNum);
 
-    a_newMax = calcPercentile<T>(a_distribStats, a_min, a_max, percentileMax, a_pixelNum);
+    a_newMax = calcPercentile<T>(a_histogram, percentileMax, a_pixelNum);
 
     /// this is to cover the corner case occurring during very short distrubution range, e.g. for some int32 cases
     if (std::is_same<T, double>::value || std::is_same<T, long double>::value || std::is_same<T, float>::value)
@@ -2757,11 +3637,11 @@ template<typename T> void calcPercentileMinMax(libnfits::DistribStats const* a_d
     }
 }
 
-template void calcPercentileMinMax<float>(libnfits::DistribStats const*, float, float, float, float&, float&, size_t);
-template void calcPercentileMinMax<double>(libnfits::DistribStats const*, double, double, float, double&, double&, size_t);
-template void calcPercentileMinMax<int16_t>(libnfits::DistribStats const*, int16_t, int16_t, float, int16_t&, int16_t&, size_t);
-template void calcPercentileMinMax<int32_t>(libnfits::DistribStats const*, int32_t, int32_t, float, int32_t&, int32_t&, size_t);
-template void calcPercentileMinMax<int64_t>(libnfits::DistribStats const*, int64_t, int64_t, float, int64_t&, int64_t&, size_t);
+template void calcPercentileMinMax<float>(const Histogram&, float, float, float, float&, float&, size_t);
+template void calcPercentileMinMax<double>(const Histogram&, double, double, float, double&, double&, size_t);
+template void calcPercentileMinMax<int16_t>(const Histogram&, int16_t, int16_t, float, int16_t&, int16_t&, size_t);
+template void calcPercentileMinMax<int32_t>(const Histogram&, int32_t, int32_t, float, int32_t&, int32_t&, size_t);
+template void calcPercentileMinMax<int64_t>(const Histogram&, int64_t, int64_t, float, int64_t&, int64_t&, size_t);
 
 //// use for debug purposes only, slow functions
 int32_t dumpFloatDataBuffer(const uint8_t* a_buffer, size_t a_size, const std::string& a_filename, uint32_t a_rowSize)
@@ -2,6 +2,8 @@
 #define LIBNFITS_HELPERFUNCTIONS_H
 
 #include <string>
+#include <string_view>
+#include <charconv>
 #include <vector>
 #include <algorithm>
 #include <sstream>
@@ -10,13 +12,21 @@
 #include <ctime>
 #include <chrono>
 #include <cmath>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
 
 #include "defs.h"
+#include "histogram.h"
+#include "pixelkernels.h"
 
 
 namespace libnfits
 {
 
+class GZIPIndex;
+
 struct RGBPixel
 {
     uint8_t red;
@@ -24,11 +34,16 @@ struct RGBPixel
     uint8_t blue;
 };
 
-struct DistribStats
+// Shared state between the inflating thread and the consumer of the decompressed data
+struct GZIPInflateProgress
 {
-    size_t  count;
-    float   percent;
-    size_t  cdf;     /// cumulative distribution function for percentile calculation
+    int8_t*                 buffer = nullptr;       /// the output buffer and its capacity, published under the mutex once allocated
+    size_t                  capacity = 0;
+    std::atomic<size_t>     availableSize = 0;      /// number of the decompressed bytes ready in the buffer
+    std::atomic<int32_t>    status = FITS_GZIP_INFLATE_RUNNING;
+    std::atomic<bool>       cancel = false;
+    std::mutex              mutex;
+    std::condition_variable condition;
 };
 
 template<typename ... many> void LOG(const std::string& a_str, many ... a_args)
@@ -260,14 +275,49 @@ inline uint8_t char2alphanum(uint8_t a_char)
     return (a_char >= 0x20 && a_char < 0x7F) ? a_char : '.';
 }
 
+//// 0.299*R + 0.587*G + 0.114*B rounded, in integers so the vector kernels get the same brightness
 inline uint8_t calcPixelBrightness(uint8_t a_red, uint8_t a_green, uint8_t a_blue)
 {
-    return std::round(0.299*(float)a_red + 0.587*(float)a_green + 0.114*(float)a_blue);
+    return (299*(uint32_t)a_red + 587*(uint32_t)a_green + 114*(uint32_t)a_blue + 500) / 1000;
 }
 
 inline uint8_t calcPixelBrightness(RGBPixel& a_pixel)
 {
-    return std::round(0.299*(float)a_pixel.red + 0.587*(float)a_pixel.green + 0.114*(float)a_pixel.blue);
+    return calcPixelBrightness(a_pixel.red, a_pixel.green, a_pixel.blue);
+}
+
+//// The brightest pixels get human-eye pleasant colors by their dominant channel. The float terms of the original
+//// formulas, e.g. 240 - (blue/255)*138, are computed exactly in integers, so the vector kernels get the same colors.
+inline void convertRGB2EyeComfortColors(uint8_t a_red, uint8_t a_green, uint8_t a_blue,
+                                        uint8_t& a_newRed, uint8_t& a_newGreen, uint8_t& a_newBlue)
+{
+    const uint8_t rgbThreshold = 0x7f;
+
+    a_newRed = a_red;
+    a_newGreen = a_green;
+    a_newBlue = a_blue;
+
+    if (rgbThreshold > a_red && rgbThreshold > a_green && rgbThreshold > a_blue)
+        return;
+
+    if (a_blue > a_red && a_blue > a_green)
+    {
+        a_newRed = 0xff / 2;
+        a_newGreen = (65025 - 153*(uint32_t)a_blue) / 510;
+        a_newBlue = (0xff - a_blue) / 2;
+    }
+    else if (a_green > a_blue && a_green > a_red)
+    {
+        a_newRed = 0xff;
+        a_newGreen = (61200 - 138*(uint32_t)a_blue) / 255;
+        a_newBlue = 0xff - a_blue;
+    }
+    else if (a_red > a_blue && a_red > a_green)
+    {
+        a_newGreen = 0xff;
+        a_newRed = 0xff - a_blue;
+        a_newBlue = (61200 - 138*(uint32_t)a_green) / 255;
+    }
 }
 
 inline uint8_t convertRGB2Grayscale(uint8_t a_red, uint8_t a_green, uint8_t a_blue)
@@ -328,6 +378,26 @@ template<typename T> T convertStringMulti(const std::string& a_strData, bool& a_
     return retVal;
 }
 
+// Allocation-free numeric conversion, accepts the leading '+' like convertStringMulti() does
+template<typename T> T convertStringViewNumber(std::string_view a_strData, bool& a_successFlag)
+{
+    T retVal{};
+
+    if (!a_strData.empty() && a_strData.front() == '+')
+        a_strData.remove_prefix(1);
+
+    std::from_chars_result res = std::from_chars(a_strData.data(), a_strData.data() + a_strData.length(), retVal);
+
+    a_successFlag = (res.ec == std::errc());
+
+    // "inf" and "nan" are not valid FITS numbers
+    if constexpr (std::is_floating_point_v<T>)
+        if (a_successFlag && !std::isfinite(retVal))
+            a_successFlag = false;
+
+    return retVal;
+}
+
 template<typename T> std::string int2hex(T a_value)
 {
   std::stringstream strStream;
@@ -420,14 +490,20 @@ bool recordValueSyntaxCheck(const std::string& a_strData);
 
 bool recordKeywordSyntaxCheck(const std::string& a_strData);
 
-bool recordSyntaxCheck(const std::string& a_strData);
+bool recordSyntaxCheck(std::string_view a_strData);
+
+int32_t findFirstCharOutOfQuotes(std::string_view a_strData, const int8_t a_sym);
+
+std::string_view trimStringViewRight(std::string_view a_strData, const int8_t a_sym);
 
-int32_t findFirstCharOutOfQuotes(const std::string& a_strData, const int8_t a_sym);
+std::string_view trimStringViewLeftRight(std::string_view a_strData, const int8_t a_sym);
 
-bool isValueContinued(const std::string& a_strData);
+bool isValueContinued(std::string_view a_strData);
 
 std::string getStringFromBuffer(const uint8_t* a_buffer, size_t a_offset, size_t a_length = FITS_HEADER_RECORD_SIZE);
 
+uint64_t getKeywordField(std::string_view a_strData);
+
 
 
 //// compression-decompression functions declaration block
@@ -453,6 +529,11 @@ size_t decompressData(const int8_t* a_inputBuffer, int8_t*& a_outputBuffer, size
 
 size_t compressDecompressData(const int8_t* a_inputBuffer, int8_t*& a_outputBuffer, size_t a_bufferSize,
                               const std::string& a_strMethod = FITS_COMPRESSIION_GZIP, bool a_compressFlag = true);
+
+size_t estimateGZIPDecompressedSize(const int8_t* a_inputBuffer, size_t a_bufferSize);
+
+size_t decompressGZIPData(const int8_t* a_inputBuffer, int8_t*& a_outputBuffer, size_t a_bufferSize, GZIPIndex* a_index = nullptr,
+                          GZIPInflateProgress* a_progress = nullptr);
 //// end of compression-decompression functions declaration block
 
 
@@ -839,6 +920,10 @@ inline uint32_t convertFloat2Grayscale(float a_value, float a_min, float a_range
 {
     uint32_t retVal = 0;
 
+    /// non-finite values are black, the vector kernels make them black as well
+    if (!std::isfinite(a_value))
+        return retVal;
+
     ///a_stetchFuncPtr(a_value); /// original version. Now stretch is applied to min/max/range in the caller function
 
     //uint32_t tmpVal = static_cast<uint32_t>((std::fabs(a_value - a_min)/range) * 255.0); /// #1
@@ -858,6 +943,10 @@ inline uint32_t convertDouble2Grayscale(double a_value, double a_min, double a_r
 {
     uint32_t retVal = 0;
 
+    /// non-finite values are black, the vector kernels make them black as well
+    if (!std::isfinite(a_value))
+        return retVal;
+
     ///a_stetchFuncPtr(a_value);  /// original version. Now stretch is applied to min/max/range in the caller function
 
     uint32_t tmpVal = static_cast<uint32_t>((std::abs(a_value - a_min)/a_range) * 255.0); /// #3 - seems is the best
@@ -875,6 +964,10 @@ inline uint32_t convertLongDouble2Grayscale(long double a_value, long double a_m
 {
     uint32_t retVal = 0;
 
+    /// non-finite values are black, the vector kernels make them black as well
+    if (!std::isfinite(a_value))
+        return retVal;
+
     ///a_stetchFuncPtr(a_value);  /// original version. Now stretch is applied to min/max/range in the caller function
 
     uint32_t tmpVal = static_cast<uint32_t>((std::abs(a_value - a_min)/a_range) * 255.0); /// #3 - seems is the best
@@ -1160,6 +1253,51 @@ void convertBufferLong2RGB(uint8_t* a_buffer, size_t a_size, uint8_t* a_destBuff
                            long double a_bzero = FITS_BZERO_DEFAULT_VALUE, long double a_bscale = FITS_BSCALE_DEFAULT_VALUE,
                            bool a_zeroScaleFlag = false, uint32_t a_type = FITS_FLOAT_DOUBLE_NO_TRANSFORM);
 
+//// render kernels specialised at compile time for every sample type, stretch, BZERO/BSCALE, clipping and output format,
+//// the kernel is selected once per image (or buffer) instead of dispatching per pixel
+struct RenderParams
+{
+    long double min;        /// after BZERO/BSCALE and the stretch
+    long double max;
+    long double range;
+    long double bzero;
+    long double bscale;
+    uint32_t    type;
+    const uint32_t* lut = nullptr;  /// the pixels of all the sample values, see selectRenderLutKernel()
+};
+
+/// a_count samples of a_buffer are converted into a_destBuffer, they may be the same buffer for BITPIX -32/-64
+typedef void (*renderKernelPtr)(const uint8_t* a_buffer, size_t a_count, uint8_t* a_destBuffer, const RenderParams& a_params);
+
+template<typename T> void initRenderParams(RenderParams& a_params, T a_min, T a_max, long double a_bzero, long double a_bscale,
+                                           bool a_zeroScaleFlag, uint32_t a_type);
+
+/// a_bgra selects the opaque BGRA uint32_t output, otherwise the output is the one of the convertBuffer*2RGB functions
+renderKernelPtr selectRenderKernel(int32_t a_bitpix, uint32_t a_type, bool a_zeroScaleFlag, bool a_bgra);
+
+/// BITPIX 8 and 16 samples have at most 65536 values: their pixels are rendered once with a_kernel into a_lut and the
+/// returned kernel only swaps the samples and loads the table entries. a_kernel is returned for other BITPIX values.
+renderKernelPtr selectRenderLutKernel(int32_t a_bitpix, renderKernelPtr a_kernel, RenderParams& a_params,
+                                      std::vector<uint32_t>& a_lut);
+
+/// Sample planes keep the samples of BITPIX 32, 64, -32 and -64 decoded (native-endian, BZERO/BSCALE applied) in the type
+/// the kernels convert them in, the element size is 0 for BITPIX 8 and 16 which are rendered through the table above.
+size_t getSamplePlaneElementSize(int32_t a_bitpix);
+int32_t decodeSamplePlane(int32_t a_bitpix, const uint8_t* a_buffer, size_t a_count, uint8_t* a_destBuffer,
+                          long double a_bzero, long double a_bscale, bool a_zeroScaleFlag);
+/// BGRA kernels rendering the decoded samples, the BZERO/BSCALE values of a_params are not used
+renderKernelPtr selectPlaneRenderKernel(int32_t a_bitpix, uint32_t a_type);
+
+/// a_processBand(a_firstRow, a_lastRow, a_scratch) is called for bands of rows on all the cores (the calling thread and
+/// the ThreadPool threads), a_scratch is a buffer of the thread kept between its bands. Each row belongs to one band,
+/// so the result doesn't depend on the number of threads. FITS_GENERAL_ERROR is returned if a band threw an exception.
+typedef std::function<void(size_t a_firstRow, size_t a_lastRow, std::vector<uint8_t>& a_scratch)> processRowBandPtr;
+
+int32_t processRowBands(size_t a_rowsNumber, size_t a_rowPixels, const processRowBandPtr& a_processBand);
+
+/// the number of threads processRowBands() uses for a_bandsNumber bands
+size_t getRowBandThreadsNumber(size_t a_bandsNumber);
+
 //// functions to convert buffers to grayscale
 void convertBufferRGB2Grayscale(uint8_t* a_buffer, size_t a_size);
 
@@ -1169,6 +1307,18 @@ void convertBufferRGB322Grayscale(uint8_t** a_buffer, uint32_t a_width, uint32_t
 
 void convertBufferRGB32Flat2Grayscale(uint8_t* a_buffer, uint32_t a_width, uint32_t a_height);
 
+//// functions to adjust the opaque BGRA words of the RGB32 flat buffers, the vector kernels process as many words as they can
+/// the levels (already clamped to the kernel range) and their tables, bLevels is set
+void setColorKernelLevels(ColorKernelParams& a_params, const float (&a_quatients)[3]);
+
+void adjustRGB32FlatPixels(uint32_t* a_pixels, size_t a_count, const ColorKernelParams& a_params);
+
+/// adjustRGB32FlatPixels() for bands of the rows on all the cores
+int32_t adjustBufferRGB32FlatColors(uint8_t* a_buffer, uint32_t a_width, uint32_t a_height, const ColorKernelParams& a_params);
+
+/// the statistics are merged into a_result, see ColorKernelResult
+void calcRGB32FlatPixelsColorStats(const uint32_t* a_pixels, size_t a_count, ColorKernelResult& a_result);
+
 
 //// hex manipulation functions
 std::string char2hex(uint8_t a_char);
@@ -1182,6 +1332,24 @@ int32_t convertBuffer2HexString(const uint8_t* a_buffer, uint8_t* a_output, size
 std::string convertBuffer2HexString(const uint8_t* a_buffer, size_t size, uint32_t a_align);
 
 //// min-max counting functions
+/// Min/max of the samples which are neither NaN, infinite nor BLANK (for the integer BITPIX only if a_blankFlag is set),
+/// a_invalidCount is the number of the skipped samples. FITS_GENERAL_ERROR is returned if there are no valid samples.
+template<typename T> int32_t getBufferMinMax(const uint8_t* a_buffer, size_t a_size, T& a_min, T& a_max, size_t& a_invalidCount,
+                                             bool a_blankFlag = false, int64_t a_blank = 0);
+
+/// getBufferMinMax() and the counts of the histogram getBufferDistributionMinMax() uses, the segments are the same as the
+/// ones of get*BufferDistribution(). The pixels of BITPIX 8 and 16, and of BITPIX 32 and 64 of a narrow range, are counted
+/// in one pass with a bin per value. The others and the log and asinh histograms are counted with a second pass. The bins of a_histogram are kept, its range is set to the min/max. With a_sampleStride above 1
+/// only every a_sampleStride-th sample is counted, a_invalidCount and the counts are then the ones of the counted samples.
+template<typename T> int32_t getBufferStats(const uint8_t* a_buffer, size_t a_size, T& a_min, T& a_max, size_t& a_invalidCount,
+                                            Histogram& a_histogram, bool a_blankFlag = false, int64_t a_blank = 0,
+                                            size_t a_sampleStride = 1);
+
+/// The clipping min/max of a_percentile percent of the valid samples, the same percentiles as calcPercentileMinMax() takes.
+/// FITS_PERCENTILE_METHOD_EXACT gives the exact samples of these ranks, FITS_PERCENTILE_METHOD_SAMPLED the ones of a sample.
+template<typename T> int32_t getBufferPercentileMinMax(const uint8_t* a_buffer, size_t a_size, float a_percentile, uint32_t a_method,
+                                                       T& a_newMin, T& a_newMax, bool a_blankFlag = false, int64_t a_blank = 0);
+
 void getByteBufferMinMax(const uint8_t* a_buffer, size_t a_size, uint8_t& a_min, uint8_t& a_max);
 
 void getShortBufferMinMax(const uint8_t* a_buffer, size_t a_size, int16_t& a_min, int16_t& a_max);
@@ -1199,49 +1367,48 @@ void getDoubleBufferMinMax(const uint8_t* a_buffer, size_t a_size, double& a_min
 void getFloatBufferDistribution(const uint8_t* a_buffer, size_t a_size, float a_min, float a_max, size_t& a_count, float& a_percent);
 
 void getFloatBufferDistribution(const uint8_t* a_buffer, size_t a_size, float a_min, float a_max,
-                                DistribStats (&a_stats)[FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER]);
+                                DistribStats* a_stats, size_t a_binsNumber = FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER);
 
 
 void getDoubleBufferDistribution(const uint8_t* a_buffer, size_t a_size, double a_min, double a_max, size_t& a_count, float& a_percent);
 
 void getDoubleBufferDistribution(const uint8_t* a_buffer, size_t a_size, double a_min, double a_max,
-                                 DistribStats (&a_stats)[FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER]);
+                                 DistribStats* a_stats, size_t a_binsNumber = FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER);
 
 
 void getByteBufferDistribution(const uint8_t* a_buffer, size_t a_size, int8_t a_min, int8_t a_max, size_t& a_count, float& a_percent);
 
 void getByteBufferDistribution(const uint8_t* a_buffer, size_t a_size, int8_t a_min, int8_t a_max,
-                               DistribStats (&a_stats)[FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER]);
+                               DistribStats* a_stats, size_t a_binsNumber = FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER);
 
 void getUByteBufferDistribution(const uint8_t* a_buffer, size_t a_size, uint8_t a_min, uint8_t a_max,
-                                DistribStats (&a_stats)[FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER]);
+                                DistribStats* a_stats, size_t a_binsNumber = FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER);
 
 void getShortBufferDistribution(const uint8_t* a_buffer, size_t a_size, int16_t a_min, int16_t a_max, size_t& a_count, float& a_percent);
 
 void getShortBufferDistribution(const uint8_t* a_buffer, size_t a_size, int16_t a_min, int16_t a_max,
-                                DistribStats (&a_stats)[FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER]);
+                                DistribStats* a_stats, size_t a_binsNumber = FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER);
 
 
 void getIntBufferDistribution(const uint8_t* a_buffer, size_t a_size, int32_t a_min, int32_t a_max, size_t& a_count, float& a_percent);
 
 void getIntBufferDistribution(const uint8_t* a_buffer, size_t a_size, int32_t a_min, int32_t a_max,
-                              DistribStats (&a_stats)[FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER]);
+                              DistribStats* a_stats, size_t a_binsNumber = FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER);
 
 
 void getLongBufferDistribution(const uint8_t* a_buffer, size_t a_size, int64_t a_min, int64_t a_max, size_t& a_count, float& a_percent);
 
 void getLongBufferDistribution(const uint8_t* a_buffer, size_t a_size, int64_t a_min, int64_t a_max,
-                               DistribStats (&a_stats)[FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER]);
+                               DistribStats* a_stats, size_t a_binsNumber = FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER);
 
-float getMaxDistribPercent(const DistribStats (&a_stats)[FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER], int32_t& a_segment);
+float getMaxDistribPercent(const DistribStats* a_stats, size_t a_binsNumber, int32_t& a_segment);
 
-float getMaxDistribPercentRange(const DistribStats (&a_stats)[FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER],
+float getMaxDistribPercentRange(const DistribStats* a_stats, size_t a_binsNumber,
                                 int32_t& a_startSegment, int32_t& a_endSegment, float& a_startPercent, float& a_endPercent,
                                 float a_percent = FITS_VALUE_DISTRIBUTION_RANGE_MIN_THREASHOLD);
 
 template<typename T> void getBufferDistributionMinMax(const uint8_t* a_buffer, size_t a_size, float a_percent, T a_min, T a_max,
-                                                      T& a_minNew, T& a_maxNew,
-                                                      DistribStats (&a_stats)[FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER],
+                                                      T& a_minNew, T& a_maxNew, Histogram& a_histogram,
                                                       bool a_isDistribCounted = false);
 
 inline void zeroScaleFloatMul(float& a_value, long double a_bzero, long double a_bscale)
@@ -1300,11 +1467,10 @@ inline void zeroScaleLongDummy(int64_t& a_value, long double a_bzero, long doubl
 {
 }
 
-template<typename T> void calcPercentileMinMax(libnfits::DistribStats const* a_distribStats, T a_min, T a_max,
+template<typename T> void calcPercentileMinMax(const Histogram& a_histogram, T a_min, T a_max,
                                                float a_percentile, T& a_newMin, T& a_newMax, size_t a_pixelNum);
 
-template<typename T> T calcPercentile(libnfits::DistribStats const* a_distribStats, T a_min, T a_max,
-                                      float a_percentile, size_t a_pixelNum);
+template<typename T> T calcPercentile(const Histogram& a_histogram, float a_percentile, size_t a_pixelNum);
 
 template<typename T> long double calcRangeMinMaxBScaleBZero(T a_min, T a_max,
                                        long double a_bzero, long double a_bscale,
@@ -5,30 +5,123 @@
 #include <sys/mman.h>
 #endif
 
+#if defined(LIBNFITS_HAVE_LIBURING)
+#include <liburing.h>
+#endif
+
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <vector>
+
 namespace libnfits
 {
 
 MapFile::MapFile():
-    m_memoryBuffer(nullptr), m_fileName(""), m_fileSize(0), m_rwFlag(false), m_fileDesc(0)
+    m_memoryBuffer(nullptr), m_fileName(""), m_fileSize(0), m_rwFlag(false), m_fileDesc(0),
+    m_ioStrategy(FITS_IO_STRATEGY_DEFAULT), m_ioAccessPattern(FITS_IO_ACCESS_NORMAL), m_loadedIOStrategy(FITS_UNDEFINED_VALUE),
+    m_callbackFunc(nullptr), m_callbackFuncParam(nullptr)
 {
 #if defined(__WIN32__) || defined(__WIN64__)
     m_fileHandle = nullptr;
     m_mapHandle = nullptr;
     m_pMapAddress = nullptr;
 #endif
+
+    // the strategy can be changed per host without rebuilding
+    const char* ioStrategyName = std::getenv(FITS_IO_STRATEGY_ENV_VARIABLE);
+
+    if (ioStrategyName != nullptr && getIOStrategyByName(ioStrategyName) != FITS_UNDEFINED_VALUE)
+        m_ioStrategy = getIOStrategyByName(ioStrategyName);
 }
 
 MapFile::~MapFile()
 {
-    delete [] m_memoryBuffer;
+    if (m_memoryBuffer != nullptr)
+        closeFile();
+}
+
+// Small files are read at once, as mapping them costs more in page faults than copying. Larger files are mapped: with
+// readahead hints if read through once, without readahead if only parts are used, otherwise prefaulted if not too large.
+// O_DIRECT, huge pages and the concurrent reading of the large files are never chosen automatically, they pay off only
+// for cold cache reads on fast storage. With the file in the page cache, copying it costs more than mapping it.
+int32_t MapFile::selectIOStrategy(size_t a_fileSize, int32_t a_ioAccessPattern)
+{
+    if (a_fileSize < FITS_IO_SMALL_FILE_SIZE)
+        return FITS_IO_STRATEGY_READ;
+
+    if (a_ioAccessPattern == FITS_IO_ACCESS_SEQUENTIAL)
+        return FITS_IO_STRATEGY_MMAP_SEQUENTIAL;
+
+    if (a_ioAccessPattern == FITS_IO_ACCESS_RANDOM)
+        return FITS_IO_STRATEGY_MMAP;
+
+    if (a_fileSize <= FITS_IO_POPULATE_MAX_SIZE)
+        return FITS_IO_STRATEGY_MMAP_POPULATE;
+
+    return FITS_IO_STRATEGY_MMAP_SEQUENTIAL;
+}
+
+int32_t MapFile::getIOStrategyByName(const std::string& a_name)
+{
+    static const std::pair<const char*, int32_t> ioStrategyNames[] =
+    {
+        { "auto",               FITS_IO_STRATEGY_AUTO },
+        { "mmap",               FITS_IO_STRATEGY_MMAP },
+        { "mmap-sequential",    FITS_IO_STRATEGY_MMAP_SEQUENTIAL },
+        { "mmap-populate",      FITS_IO_STRATEGY_MMAP_POPULATE },
+        { "read",               FITS_IO_STRATEGY_READ },
+        { "read-direct",        FITS_IO_STRATEGY_READ_DIRECT },
+        { "read-hugepages",     FITS_IO_STRATEGY_READ_HUGE_PAGES }
+    };
+
+    for (const auto& ioStrategyName : ioStrategyNames)
+        if (a_name == ioStrategyName.first)
+            return ioStrategyName.second;
+
+    return FITS_UNDEFINED_VALUE;
+}
+
+void MapFile::setIOStrategy(int32_t a_ioStrategy)
+{
+    m_ioStrategy = a_ioStrategy;
+}
+
+int32_t MapFile::getIOStrategy() const
+{
+    return m_ioStrategy;
+}
+
+void MapFile::setIOAccessPattern(int32_t a_ioAccessPattern)
+{
+    m_ioAccessPattern = a_ioAccessPattern;
+}
+
+int32_t MapFile::getIOAccessPattern() const
+{
+    return m_ioAccessPattern;
+}
+
+int32_t MapFile::getLoadedIOStrategy() const
+{
+    return m_loadedIOStrategy;
+}
+
+void MapFile::setCallbackFunction(CallbackFunctionPtr a_callbackFunc, void* a_callbackFuncParam)
+{
+    m_callbackFunc = a_callbackFunc;
+    m_callbackFuncParam = a_callbackFuncParam;
 }
 
 #if defined(__unix__) || defined(__APPLE__)
-int32_t MapFile::mapFileToMemoryU()
+int32_t MapFile::mapFileToMemoryU(int32_t a_ioStrategy)
 {
     struct stat sb;
 
@@ -41,18 +134,44 @@ int32_t MapFile::mapFileToMemoryU()
     // getting the file size
     int32_t statRes = fstat(m_fileDesc, &sb);
     if (statRes != FITS_FILE_OPEN_STAT_SUCCESS)
-       return FITS_MEMORY_MAP_FILE_FSTAT_ERROR;
+    {
+        close(m_fileDesc);
+
+        return FITS_MEMORY_MAP_FILE_FSTAT_ERROR;
+    }
 
     m_fileSize = sb.st_size;
 
     // setting the RW or R-only mode
     int32_t rwFlag = (m_rwFlag) ? PROT_READ | PROT_WRITE : PROT_READ;
+    int32_t mapFlags = MAP_PRIVATE;
+
+#if defined(MAP_POPULATE)
+    if (a_ioStrategy == FITS_IO_STRATEGY_MMAP_POPULATE)
+        mapFlags |= MAP_POPULATE;
+#endif
 
     // mapping the file, getting the pointer and converting it
-    m_memoryBuffer = (uint8_t*)mmap(NULL, m_fileSize, rwFlag, MAP_PRIVATE, m_fileDesc, 0);
+    m_memoryBuffer = (uint8_t*)mmap(NULL, m_fileSize, rwFlag, mapFlags, m_fileDesc, 0);
 
     if (m_memoryBuffer == MAP_FAILED)
+    {
+        m_memoryBuffer = nullptr;
+        close(m_fileDesc);
+
         return FITS_MEMORY_MAP_FILE_MAP_ERROR;
+    }
+
+    // the hints are only advisory, failing to set them is not an error
+    if (a_ioStrategy == FITS_IO_STRATEGY_MMAP_SEQUENTIAL)
+    {
+        madvise(m_memoryBuffer, m_fileSize, MADV_SEQUENTIAL);
+        madvise(m_memoryBuffer, m_fileSize, MADV_WILLNEED);
+    }
+    else if (a_ioStrategy == FITS_IO_STRATEGY_MMAP && m_ioAccessPattern == FITS_IO_ACCESS_RANDOM)
+        madvise(m_memoryBuffer, m_fileSize, MADV_RANDOM);
+
+    m_loadedIOStrategy = a_ioStrategy;
 
     return FITS_MEMORY_MAP_FILE_SUCCESS;
 }
@@ -73,6 +192,352 @@ int32_t MapFile::unmapFileFromMemoryU()
 
     return FITS_MEMORY_MAP_FILE_SUCCESS;
 }
+
+// Reads the whole file into a heap, O_DIRECT aligned or huge pages backed buffer, depending on a_ioStrategy
+int32_t MapFile::readFileToMemoryU(int32_t a_ioStrategy)
+{
+    int32_t flag = O_RDONLY;
+
+#if defined(O_DIRECT)
+    if (a_ioStrategy == FITS_IO_STRATEGY_READ_DIRECT)
+        flag |= O_DIRECT;
+#else
+    if (a_ioStrategy == FITS_IO_STRATEGY_READ_DIRECT)
+        a_ioStrategy = FITS_IO_STRATEGY_READ;
+#endif
+
+#if !defined(MADV_HUGEPAGE)
+    if (a_ioStrategy == FITS_IO_STRATEGY_READ_HUGE_PAGES)
+        a_ioStrategy = FITS_IO_STRATEGY_READ;
+#endif
+
+    m_fileDesc = open(m_fileName.c_str(), flag);
+
+    // not every file system supports O_DIRECT (e.g. tmpfs), the file is read the regular way then
+    if (m_fileDesc == FILE_READ_ERROR && errno == EINVAL && a_ioStrategy == FITS_IO_STRATEGY_READ_DIRECT)
+    {
+        a_ioStrategy = FITS_IO_STRATEGY_READ;
+        m_fileDesc = open(m_fileName.c_str(), O_RDONLY);
+    }
+
+    if (m_fileDesc == FILE_READ_ERROR)
+        return FITS_MEMORY_MAP_FILE_OPEN_ERROR;
+
+    struct stat sb;
+
+    if (fstat(m_fileDesc, &sb) != FITS_FILE_OPEN_STAT_SUCCESS)
+    {
+        close(m_fileDesc);
+
+        return FITS_MEMORY_MAP_FILE_FSTAT_ERROR;
+    }
+
+    m_fileSize = sb.st_size;
+    m_loadedIOStrategy = a_ioStrategy;
+
+    size_t bufferSize = m_fileSize;
+
+    if (a_ioStrategy == FITS_IO_STRATEGY_READ_DIRECT)
+    {
+        // O_DIRECT transfers whole aligned blocks, the last one may go past the end of the file
+        bufferSize = (m_fileSize / FITS_IO_DIRECT_ALIGNMENT + 1) * FITS_IO_DIRECT_ALIGNMENT;
+        m_memoryBuffer = (uint8_t*)std::aligned_alloc(FITS_IO_DIRECT_ALIGNMENT, bufferSize);
+    }
+#if defined(MADV_HUGEPAGE)
+    else if (a_ioStrategy == FITS_IO_STRATEGY_READ_HUGE_PAGES)
+    {
+        bufferSize = (m_fileSize / FITS_IO_HUGE_PAGE_SIZE + 1) * FITS_IO_HUGE_PAGE_SIZE;
+        m_memoryBuffer = (uint8_t*)mmap(NULL, bufferSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if (m_memoryBuffer == MAP_FAILED)
+            m_memoryBuffer = nullptr;
+        else
+            madvise(m_memoryBuffer, bufferSize, MADV_HUGEPAGE);
+    }
+#endif
+    else
+    {
+        m_memoryBuffer = new (std::nothrow) uint8_t[m_fileSize];
+
+#if defined(POSIX_FADV_SEQUENTIAL)
+        posix_fadvise(m_fileDesc, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    }
+
+    if (m_memoryBuffer == nullptr)
+    {
+        close(m_fileDesc);
+        m_loadedIOStrategy = FITS_UNDEFINED_VALUE;
+
+        return FITS_MEMORY_MAP_FILE_MAP_ERROR;
+    }
+
+    size_t bytesRead = 0;
+
+#if defined(ENABLE_PARALLEL_FILE_READING)
+    if (m_fileSize >= FITS_IO_PARALLEL_MIN_SIZE)
+        bytesRead = readFileParallelU(a_ioStrategy == FITS_IO_STRATEGY_READ_DIRECT ? bufferSize : m_fileSize);
+#endif
+
+    // read() may transfer less than requested, e.g. Linux reads at most ~2 GB per call
+    while (bytesRead < m_fileSize)
+    {
+        ssize_t res = read(m_fileDesc, m_memoryBuffer + bytesRead, std::min(bufferSize - bytesRead, FITS_IO_READ_CHUNK_SIZE));
+
+        if (res < 0 && errno == EINTR)
+            continue;
+
+        if (res <= 0)
+            break;
+
+        bytesRead += res;
+    }
+
+    close(m_fileDesc);
+
+    if (bytesRead < m_fileSize)
+    {
+        freeReadBufferU();
+
+        return FITS_MEMORY_MAP_FILE_OPEN_ERROR;
+    }
+
+    return FITS_MEMORY_MAP_FILE_SUCCESS;
+}
+
+void MapFile::reportReadProgress(size_t a_bytesRead, int32_t& a_lastPercent)
+{
+    if (m_callbackFunc == nullptr)
+        return;
+
+    int32_t percent = std::min(a_bytesRead, m_fileSize) * 100 / std::max(m_fileSize, (size_t)1);
+
+    if (percent != a_lastPercent)
+    {
+        a_lastPercent = percent;
+        m_callbackFunc(percent, m_callbackFuncParam);
+    }
+}
+
+// Reads the first a_readSize bytes of the file into m_memoryBuffer with many FITS_IO_PARALLEL_CHUNK_SIZE requests at once,
+// so that the device queue is kept busy. Returns 0 if any request failed, then the file is read in the regular way.
+size_t MapFile::readFileParallelU(size_t a_readSize)
+{
+#if defined(LIBNFITS_HAVE_LIBURING)
+    size_t bytesRead = readFileURingU(a_readSize);
+
+    // io_uring may be unavailable at runtime (old kernel, disabled by the system settings or seccomp)
+    if (bytesRead != 0)
+        return bytesRead;
+#endif
+
+    return readFileThreadsU(a_readSize);
+}
+
+size_t MapFile::readFileThreadsU(size_t a_readSize)
+{
+    std::atomic<size_t> nextOffset = 0;
+    std::atomic<size_t> bytesRead = 0;
+    std::atomic<bool> bError = false;
+
+    int32_t lastPercent = FITS_UNDEFINED_VALUE;
+
+    // the calling thread reads too and is the only one reporting the progress
+    auto readChunks = [&](bool a_bReportProgress)
+    {
+        while (!bError)
+        {
+            size_t offset = nextOffset.fetch_add(FITS_IO_PARALLEL_CHUNK_SIZE);
+
+            if (offset >= a_readSize)
+                break;
+
+            size_t length = std::min(a_readSize - offset, FITS_IO_PARALLEL_CHUNK_SIZE);
+
+            while (length > 0)
+            {
+                ssize_t res = pread(m_fileDesc, m_memoryBuffer + offset, length, offset);
+
+                if (res < 0 && errno == EINTR)
+                    continue;
+
+                if (res < 0)
+                    bError = true;
+
+                // end of the file, only possible for the aligned O_DIRECT size
+                if (res <= 0)
+                    break;
+
+                offset += res;
+                length -= res;
+                bytesRead += res;
+            }
+
+            if (a_bReportProgress)
+                reportReadProgress(bytesRead, lastPercent);
+        }
+    };
+
+    size_t chunks = (a_readSize + FITS_IO_PARALLEL_CHUNK_SIZE - 1) / FITS_IO_PARALLEL_CHUNK_SIZE;
+    size_t threadsNumber = std::min({ (size_t)std::max(std::thread::hardware_concurrency(), 1u),
+                                      (size_t)FITS_IO_PARALLEL_MAX_THREADS, chunks });
+
+    std::vector<std::thread> threads;
+
+    for (size_t i = 1; i < threadsNumber; ++i)
+        threads.emplace_back(readChunks, false);
+
+    readChunks(true);
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    if (bError || bytesRead < m_fileSize)
+        return 0;
+
+    return bytesRead;
+}
+
+#if defined(LIBNFITS_HAVE_LIBURING)
+size_t MapFile::readFileURingU(size_t a_readSize)
+{
+    struct ReadRequest
+    {
+        size_t offset;
+        size_t length;
+    };
+
+    struct io_uring ring;
+
+    if (io_uring_queue_init(FITS_IO_PARALLEL_QUEUE_DEPTH, &ring, 0) < 0)
+        return 0;
+
+    std::vector<ReadRequest> requests(FITS_IO_PARALLEL_QUEUE_DEPTH);
+    std::vector<uint32_t> freeSlots;
+
+    for (uint32_t i = 0; i < FITS_IO_PARALLEL_QUEUE_DEPTH; ++i)
+        freeSlots.push_back(i);
+
+    size_t nextOffset = 0, bytesRead = 0;
+    int32_t lastPercent = FITS_UNDEFINED_VALUE;
+    bool bError = false;
+
+    auto queueRead = [&](uint32_t a_slot)
+    {
+        struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+
+        io_uring_prep_read(sqe, m_fileDesc, m_memoryBuffer + requests[a_slot].offset, requests[a_slot].length, requests[a_slot].offset);
+        sqe->user_data = a_slot;
+    };
+
+    while (!bError)
+    {
+        while (!freeSlots.empty() && nextOffset < a_readSize)
+        {
+            uint32_t slot = freeSlots.back();
+            freeSlots.pop_back();
+
+            requests[slot].offset = nextOffset;
+            requests[slot].length = std::min(a_readSize - nextOffset, FITS_IO_PARALLEL_CHUNK_SIZE);
+            nextOffset += requests[slot].length;
+
+            queueRead(slot);
+        }
+
+        if (freeSlots.size() == FITS_IO_PARALLEL_QUEUE_DEPTH)
+            break;
+
+        struct io_uring_cqe* cqe = nullptr;
+
+        int32_t resSubmit = io_uring_submit_and_wait(&ring, 1);
+
+        if (resSubmit < 0 && resSubmit != -EINTR)
+        {
+            bError = true;
+            break;
+        }
+
+        unsigned head, completed = 0;
+
+        io_uring_for_each_cqe(&ring, head, cqe)
+        {
+            uint32_t slot = (uint32_t)cqe->user_data;
+            int32_t res = cqe->res;
+
+            ++completed;
+
+            if (res == -EINTR || res == -EAGAIN)
+                queueRead(slot);
+            else if (res < 0)
+            {
+                bError = true;
+                freeSlots.push_back(slot);
+            }
+            else if (res > 0 && (size_t)res < requests[slot].length)
+            {
+                // short read, the rest of the request is queued again
+                requests[slot].offset += res;
+                requests[slot].length -= res;
+                bytesRead += res;
+
+                queueRead(slot);
+            }
+            else
+            {
+                // res == 0 is the end of the file, only possible for the aligned O_DIRECT size
+                bytesRead += res;
+                freeSlots.push_back(slot);
+            }
+        }
+
+        io_uring_cq_advance(&ring, completed);
+
+        reportReadProgress(bytesRead, lastPercent);
+    }
+
+    // after an error the buffer must not be released while the kernel may still write into it
+    io_uring_submit(&ring);
+
+    while (freeSlots.size() < FITS_IO_PARALLEL_QUEUE_DEPTH)
+    {
+        struct io_uring_cqe* cqe = nullptr;
+
+        int32_t resWait = io_uring_wait_cqe(&ring, &cqe);
+
+        if (resWait == -EINTR)
+            continue;
+
+        if (resWait < 0)
+            break;
+
+        freeSlots.push_back((uint32_t)cqe->user_data);
+        io_uring_cqe_seen(&ring, cqe);
+    }
+
+    io_uring_queue_exit(&ring);
+
+    if (bError || bytesRead < m_fileSize)
+        return 0;
+
+    return bytesRead;
+}
+#endif
+
+void MapFile::freeReadBufferU()
+{
+    if (m_memoryBuffer != nullptr)
+    {
+        if (m_loadedIOStrategy == FITS_IO_STRATEGY_READ_DIRECT)
+            std::free(m_memoryBuffer);
+        else if (m_loadedIOStrategy == FITS_IO_STRATEGY_READ_HUGE_PAGES)
+            munmap(m_memoryBuffer, (m_fileSize / FITS_IO_HUGE_PAGE_SIZE + 1) * FITS_IO_HUGE_PAGE_SIZE);
+        else
+            delete [] m_memoryBuffer;
+    }
+
+    m_memoryBuffer = nullptr;
+    m_loadedIOStrategy = FITS_UNDEFINED_VALUE;
+}
 #elif defined(__WIN32__) || defined(__WIN64__)
 int32_t MapFile::mapFileToMemoryW()
 {
@@ -129,11 +594,35 @@ int32_t MapFile::unmapFileFromMemoryW()
 int32_t MapFile::loadFile(const std::string& a_fileName, bool a_rwFlag)
 {
     m_fileName = a_fileName;
+    m_rwFlag = a_rwFlag;
+
+    int32_t ioStrategy = m_ioStrategy;
+
+    if (ioStrategy == FITS_IO_STRATEGY_AUTO)
+    {
+        struct stat sb;
+
+        if (stat(m_fileName.c_str(), &sb) != FITS_FILE_OPEN_STAT_SUCCESS)
+            return FITS_MEMORY_MAP_FILE_FSTAT_ERROR;
+
+        ioStrategy = selectIOStrategy(sb.st_size, m_ioAccessPattern);
+    }
 
 #if defined(__unix__) || defined(__APPLE__)
-    return mapFileToMemoryU();
+    if (ioStrategy >= FITS_IO_STRATEGY_READ)
+        return readFileToMemoryU(ioStrategy);
+
+    return mapFileToMemoryU(ioStrategy);
 #elif defined(__WIN32__) || defined(__WIN64__)
-    return mapFileToMemoryW();
+    if (ioStrategy >= FITS_IO_STRATEGY_READ)
+        return loadFileRead(a_fileName);
+
+    int32_t retVal = mapFileToMemoryW();
+
+    if (retVal == FITS_MEMORY_MAP_FILE_SUCCESS)
+        m_loadedIOStrategy = FITS_IO_STRATEGY_MMAP;
+
+    return retVal;
 #else
     return FITS_MEMORY_MAP_FILE_MAP_ERROR;
 #endif
@@ -153,6 +642,9 @@ ssize_t MapFile::loadFileRead(const std::string& a_fileName)
 {
     m_fileName = a_fileName;
 
+#if defined(__unix__) || defined(__APPLE__)
+    return readFileToMemoryU(FITS_IO_STRATEGY_READ);
+#else
     m_fileDesc = open(a_fileName.c_str(), O_RDONLY);
     if (m_fileDesc == FILE_READ_ERROR)
         return FITS_MEMORY_MAP_FILE_OPEN_ERROR;
@@ -182,6 +674,8 @@ ssize_t MapFile::loadFileRead(const std::string& a_fileName)
     if (bytesRead != m_fileSize)
         return returnFileReadError();
 
+    m_loadedIOStrategy = FITS_IO_STRATEGY_READ;
+
     /// Closing the file
     int32_t res = close(m_fileDesc);
 
@@ -189,6 +683,7 @@ ssize_t MapFile::loadFileRead(const std::string& a_fileName)
         return FITS_MEMORY_MAP_FILE_MAP_ERROR;
     else
         return FITS_MEMORY_MAP_FILE_SUCCESS;
+#endif
 }
 
 int32_t MapFile::closeFileRead()
@@ -212,9 +707,14 @@ int32_t MapFile::closeFileRead()
     }
     */
 
+#if defined(__unix__) || defined(__APPLE__)
+    freeReadBufferU();
+#else
     delete [] m_memoryBuffer;
 
     m_memoryBuffer = nullptr;
+    m_loadedIOStrategy = FITS_UNDEFINED_VALUE;
+#endif
 
     return FITS_MEMORY_MAP_FILE_SUCCESS;
     //retVal;
@@ -222,18 +722,31 @@ int32_t MapFile::closeFileRead()
 
 int32_t MapFile::closeFile()
 {
+    if (m_loadedIOStrategy == FITS_UNDEFINED_VALUE)
+        return FITS_MEMORY_MAP_FILE_IO_ERROR;
+
+    // the buffers of the read() strategies are released in the same way for all of them
+    if (m_loadedIOStrategy >= FITS_IO_STRATEGY_READ)
+        return closeFileRead();
+
 #if defined(__unix__) || defined(__APPLE__)
     int32_t resUnmap = unmapFileFromMemoryU();
 
     if (resUnmap == FITS_MEMORY_MAP_FILE_SUCCESS)
+    {
         m_memoryBuffer = nullptr;
+        m_loadedIOStrategy = FITS_UNDEFINED_VALUE;
+    }
 
     return resUnmap;
 #elif defined(__WIN32__) || defined(__WIN64__)
     int32_t resUnmap = unmapFileFromMemoryW();
 
     if (resUnmap == FITS_MEMORY_MAP_FILE_SUCCESS)
+    {
         m_memoryBuffer = nullptr;
+        m_loadedIOStrategy = FITS_UNDEFINED_VALUE;
+    }
 
     return resUnmap;
 #else
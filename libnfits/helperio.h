@@ -4,6 +4,8 @@
 #include <cstdint>
 #include <string>
 
+#include "defs.h"
+
 #if defined(__WIN32__) || defined(__WIN64__)
 #include <windows.h>
 #endif
@@ -13,6 +15,7 @@
 namespace libnfits
 {
 
+// Loads the whole file into memory, either by mapping it or by reading it into a buffer, see FITS_IO_STRATEGY_*
 class MapFile
 {
 private:
@@ -22,6 +25,13 @@ private:
     size_t          m_fileSize;
     bool            m_rwFlag;
 
+    int32_t         m_ioStrategy;           /// requested strategy, may be FITS_IO_STRATEGY_AUTO
+    int32_t         m_ioAccessPattern;
+    int32_t         m_loadedIOStrategy;     /// strategy used for the currently loaded file, FITS_UNDEFINED_VALUE if none
+
+    CallbackFunctionPtr m_callbackFunc;     /// reports the percentage of the file read
+    void*           m_callbackFuncParam;
+
 #if defined(__WIN32__) || defined(__WIN64__)
     HANDLE          m_fileHandle;
     HANDLE          m_mapHandle;
@@ -30,8 +40,16 @@ private:
 
 private:
 #if defined(__unix__) || defined(__APPLE__)
-    int32_t mapFileToMemoryU();
+    int32_t mapFileToMemoryU(int32_t a_ioStrategy);
     int32_t unmapFileFromMemoryU();
+    int32_t readFileToMemoryU(int32_t a_ioStrategy);
+    void freeReadBufferU();
+    size_t readFileParallelU(size_t a_readSize);
+    size_t readFileThreadsU(size_t a_readSize);
+#if defined(LIBNFITS_HAVE_LIBURING)
+    size_t readFileURingU(size_t a_readSize);
+#endif
+    void reportReadProgress(size_t a_bytesRead, int32_t& a_lastPercent);
 #elif defined(__WIN32__) || defined(__WIN64__)
     int32_t mapFileToMemoryW();
     int32_t unmapFileFromMemoryW();
@@ -48,6 +66,16 @@ public:
     uint8_t* getMappedFileBuffer() const;
     size_t getFileSize() const;
 
+    void setIOStrategy(int32_t a_ioStrategy);
+    int32_t getIOStrategy() const;
+    void setIOAccessPattern(int32_t a_ioAccessPattern);
+    int32_t getIOAccessPattern() const;
+    int32_t getLoadedIOStrategy() const;
+    void setCallbackFunction(CallbackFunctionPtr a_callbackFunc, void* a_callbackFuncParam);
+
+    static int32_t selectIOStrategy(size_t a_fileSize, int32_t a_ioAccessPattern);
+    static int32_t getIOStrategyByName(const std::string& a_name);
+
 private:
     int32_t returnFileReadError();
 };
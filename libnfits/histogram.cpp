@@ -0,0 +1,137 @@
+#include <cmath>
+
+#include "histogram.h"
+
+namespace libnfits
+{
+
+Histogram::Histogram():
+    m_spacing(FITS_HISTOGRAM_SPACING_LINEAR), m_min(0.0L), m_max(0.0L), m_softening(0.0L), m_rangeSoftening(1.0L),
+    m_transformedMin(0.0L), m_binWidth(0.0L)
+{
+
+}
+
+Histogram::Histogram(size_t a_binsNumber, uint32_t a_spacing):
+    Histogram()
+{
+    setBins(a_binsNumber, a_spacing);
+}
+
+void Histogram::setBins(size_t a_binsNumber, uint32_t a_spacing)
+{
+    m_bins.assign(a_binsNumber, { 0, 0.0f, 0 });
+    m_spacing = a_spacing;
+
+    setRange(m_min, m_max);
+}
+
+void Histogram::setSoftening(long double a_softening)
+{
+    m_softening = a_softening;
+
+    setRange(m_min, m_max);
+}
+
+void Histogram::setRange(long double a_min, long double a_max)
+{
+    m_min = a_min;
+    m_max = a_max;
+
+    m_rangeSoftening = m_softening > 0.0L ? m_softening : (m_max - m_min) * FITS_HISTOGRAM_SOFTENING_FACTOR;
+
+    if (!(m_rangeSoftening > 0.0L) || !std::isfinite(m_rangeSoftening))
+        m_rangeSoftening = 1.0L;
+
+    m_transformedMin = transform(m_min);
+    m_binWidth = m_bins.empty() ? 0.0L : (transform(m_max) - m_transformedMin) / (long double)m_bins.size();
+}
+
+void Histogram::clear()
+{
+    for (DistribStats& bin : m_bins)
+        bin = { 0, 0.0f, 0 };
+}
+
+long double Histogram::transform(long double a_value) const
+{
+    if (m_spacing == FITS_HISTOGRAM_SPACING_LOG)
+        return std::log1p((a_value - m_min) / m_rangeSoftening);
+    else if (m_spacing == FITS_HISTOGRAM_SPACING_ASINH)
+        return std::asinh(a_value / m_rangeSoftening);
+    else
+        return a_value;
+}
+
+long double Histogram::inverseTransform(long double a_value) const
+{
+    if (m_spacing == FITS_HISTOGRAM_SPACING_LOG)
+        return m_min + std::expm1(a_value) * m_rangeSoftening;
+    else if (m_spacing == FITS_HISTOGRAM_SPACING_ASINH)
+        return std::sinh(a_value) * m_rangeSoftening;
+    else
+        return a_value;
+}
+
+size_t Histogram::getBinsNumber() const
+{
+    return m_bins.size();
+}
+
+uint32_t Histogram::getSpacing() const
+{
+    return m_spacing;
+}
+
+long double Histogram::getMin() const
+{
+    return m_min;
+}
+
+long double Histogram::getMax() const
+{
+    return m_max;
+}
+
+DistribStats* Histogram::getBins()
+{
+    return m_bins.data();
+}
+
+const DistribStats* Histogram::getBins() const
+{
+    return m_bins.data();
+}
+
+size_t Histogram::getBinIndex(long double a_value) const
+{
+    if (!(m_binWidth > 0.0L))
+        return m_bins.size();
+
+    long double position = std::floor((transform(a_value) - m_transformedMin) / m_binWidth);
+
+    return (position >= 0.0L && position < (long double)m_bins.size()) ? (size_t)position : m_bins.size();
+}
+
+long double Histogram::getBinStart(size_t a_index) const
+{
+    if (a_index >= m_bins.size())
+        return m_max;
+
+    return inverseTransform(m_transformedMin + (long double)a_index * m_binWidth);
+}
+
+void Histogram::calcPercents(size_t a_totalCount)
+{
+    size_t cdf = 0;
+
+    for (DistribStats& bin : m_bins)
+    {
+        cdf += bin.count;
+
+        bin.percent = a_totalCount != 0 ? (double)bin.count / (double)a_totalCount : 0.0f;
+        bin.cdf = cdf;  /// CDF (cumulative distribution function) value
+    }
+}
+
+}
@@ -0,0 +1,66 @@
+#ifndef LIBNFITS_HISTOGRAM_H
+#define LIBNFITS_HISTOGRAM_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "defs.h"
+
+namespace libnfits
+{
+
+struct DistribStats
+{
+    size_t  count;
+    float   percent;
+    size_t  cdf;     /// cumulative distribution function for percentile calculation
+};
+
+// Value distribution of the pixels between min and max with a run-time number of bins. The linear bins are of
+// the same width, the log and asinh ones are of the same width after log1p((value - min)/softening) or
+// asinh(value/softening), so the values near the min (log) or near 0 (asinh) get narrower bins.
+// The bins are allocated by setBins(), a default constructed histogram has none.
+class Histogram
+{
+private:
+    std::vector<DistribStats>   m_bins;
+    uint32_t                    m_spacing;
+    long double                 m_min;
+    long double                 m_max;
+    long double                 m_softening;        /// 0 is the range multiplied by FITS_HISTOGRAM_SOFTENING_FACTOR
+    long double                 m_rangeSoftening;   /// the softening in use for the current range
+    long double                 m_transformedMin;
+    long double                 m_binWidth;         /// the width of a bin after the transform
+
+    long double transform(long double a_value) const;
+    long double inverseTransform(long double a_value) const;
+
+public:
+    Histogram();
+    Histogram(size_t a_binsNumber, uint32_t a_spacing = FITS_HISTOGRAM_SPACING_LINEAR);
+
+    void setBins(size_t a_binsNumber, uint32_t a_spacing = FITS_HISTOGRAM_SPACING_LINEAR);
+    void setSoftening(long double a_softening);
+    void setRange(long double a_min, long double a_max);
+    void clear();
+
+    size_t getBinsNumber() const;
+    uint32_t getSpacing() const;
+    long double getMin() const;
+    long double getMax() const;
+
+    DistribStats* getBins();
+    const DistribStats* getBins() const;
+
+    /// getBinsNumber() for the values out of [min, max), the max itself too as get*BufferDistribution() do
+    size_t getBinIndex(long double a_value) const;
+    /// the lowest value of the bin, getBinStart(getBinsNumber()) is the max
+    long double getBinStart(size_t a_index) const;
+
+    /// percents and cdf of the counted bins
+    void calcPercents(size_t a_totalCount);
+};
+
+}
+#endif // LIBNFITS_HISTOGRAM_H
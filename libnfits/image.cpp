@@ -1,5 +1,8 @@
+#include <algorithm>
 #include <cstring>
 #include <cmath>
+#include <new>
+#include <numeric>
 
 #include "image.h"
 #include "pngfile.h"
@@ -10,18 +13,18 @@ namespace libnfits
 
 Image::Image():
     m_dataBuffer(nullptr),
-    m_rgbDataBuffer(nullptr), m_rgb32DataBuffer(nullptr), m_rgb32FlatDataBuffer(nullptr),
-    m_rgbDataBackupBuffer(nullptr), m_rgb32DataBackupBuffer(nullptr), m_rgb32FlatDataBackupBuffer(nullptr), m_maxDataBufferSize(0), m_baseOffset(0),
-    m_width(0), m_height(0), m_colorDepth(0), m_bitpix(0), m_isCompressed(false), m_isDistribCounted(false),
-    m_bzero(FITS_BZERO_DEFAULT_VALUE), m_isMinMaxCounted(false),
+    m_rgbDataBuffer(nullptr), m_rgb32DataBuffer(nullptr), m_rgb32FlatDataBuffer(nullptr), m_maxDataBufferSize(0), m_baseOffset(0),
+    m_width(0), m_height(0), m_colorDepth(0), m_bitpix(0), m_isCompressed(false), m_isDistribCounted(false), m_isSamplePlaneCaching(false),
+    m_isRendered(false),
+    m_bzero(FITS_BZERO_DEFAULT_VALUE), m_isMinMaxCounted(false), m_isBlankDefined(false), m_blankValue(0), m_invalidPixelsCount(0),
+    m_isStatsApproximate(false),
+    m_selectedPercent(-1.0f), m_selectedPercentileMethod(FITS_PERCENTILE_METHOD_HISTOGRAM),
     m_bscale(FITS_BSCALE_DEFAULT_VALUE), m_title(""), m_callbackFunc(nullptr), m_callbackFuncParam(nullptr),
-    m_transformType(FITS_FLOAT_DOUBLE_NO_TRANSFORM), m_percentThreshold(-1.0f)
+    m_transformType(FITS_FLOAT_DOUBLE_NO_TRANSFORM), m_percentThreshold(-1.0f),
+    m_histogramBinsNumber(FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER), m_histogramSpacing(FITS_HISTOGRAM_SPACING_LINEAR)
 {
     m_colorStats = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
 
-    for (int32_t i = 0; i < FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER; ++i)
-        m_distribStats[i] = { 0, 0.0 };
-
     resetDistribValues();
 }
 
@@ -36,6 +39,13 @@ Image::Image(const uint8_t* a_dataBuffer, uint32_t a_witdth, uint32_t a_height,
     m_isCompressed = a_isCompressed;
     m_isDistribCounted = false;
     m_isMinMaxCounted = false;
+    m_isSamplePlaneCaching = false;
+    m_isRendered = false;
+    m_isBlankDefined = false;
+    m_blankValue = 0;
+    m_invalidPixelsCount = 0;
+    m_isStatsApproximate = false;
+    m_selectedPercent = -1.0f;
     m_title = a_title;
     m_maxDataBufferSize = 0;
     m_baseOffset = 0;
@@ -46,17 +56,13 @@ Image::Image(const uint8_t* a_dataBuffer, uint32_t a_witdth, uint32_t a_height,
     m_rgbDataBuffer = nullptr;
     m_rgb32DataBuffer = nullptr;
     m_rgb32FlatDataBuffer = nullptr;
-    m_rgbDataBackupBuffer = nullptr;
-    m_rgb32DataBackupBuffer = nullptr;
-    m_rgb32FlatDataBackupBuffer = nullptr;
     m_transformType = FITS_FLOAT_DOUBLE_NO_TRANSFORM;
     m_percentThreshold = -1.0f;
+    m_histogramBinsNumber = FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER;
+    m_histogramSpacing = FITS_HISTOGRAM_SPACING_LINEAR;
 
     m_colorStats = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
 
-    for (int32_t i = 0; i < FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER; ++i)
-        m_distribStats[i] = { 0, 0.0 };
-
     resetDistribValues();
 }
 
@@ -78,6 +84,8 @@ uint32_t Image::getHeight() const
 void Image::setData(const uint8_t* a_dataBuffer)
 {
     m_dataBuffer = (uint8_t*)a_dataBuffer;
+    m_selectedPercent = -1.0f;
+    m_isRendered = false;
 }
 
 uint8_t* Image::getData() const
@@ -85,6 +93,19 @@ uint8_t* Image::getData() const
     return m_dataBuffer;
 }
 
+void Image::setSamplePlaneCaching(bool a_flag)
+{
+    m_isSamplePlaneCaching = a_flag;
+
+    if (!a_flag)
+        SamplePlaneCache::getInstance().remove(this);
+}
+
+bool Image::isSamplePlaneCaching() const
+{
+    return m_isSamplePlaneCaching;
+}
+
 void Image::setCallbackFunction(CallbackFunctionPtr a_callbackFunc, void* a_callbackFuncParam)
 {
     m_callbackFunc = a_callbackFunc;
@@ -202,6 +223,8 @@ void Image::reset()
 {
     deleteAllData();
 
+    SamplePlaneCache::getInstance().remove(this);
+
     m_width = 0;
     m_height = 0;
     m_colorDepth = 0;
@@ -213,94 +236,23 @@ void Image::reset()
     m_isCompressed = false;
     m_isDistribCounted = false;
     m_isMinMaxCounted = false;
+    m_isRendered = false;
+    m_isBlankDefined = false;
+    m_blankValue = 0;
+    m_invalidPixelsCount = 0;
+    m_isStatsApproximate = false;
+    m_selectedPercent = -1.0f;
     m_callbackFunc = nullptr;
     m_title.clear();
 
     m_colorStats = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
 
-    for (int32_t i = 0; i < FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER; ++i)
-        m_distribStats[i] = { 0, 0.0 };
+    m_histogram.reset();
 
     resetDistribValues();
 
     m_transformType = FITS_FLOAT_DOUBLE_NO_TRANSFORM;
-}
-
-void Image::backupRGBData()
-{
-    uint8_t bytesNum = 3;
-
-    // calculating the PNG pixel buffer size. This way is more understandable in terms of logic
-    size_t bufRowSize = m_width * bytesNum * (m_colorDepth / (sizeof(uint8_t) * 8)) * sizeof(uint8_t);
-
-    // the backup image already exists
-    if (m_rgbDataBackupBuffer == nullptr)
-    {
-        m_rgbDataBackupBuffer = new uint8_t*[m_height]();
-
-        for (uint32_t y = 0; y < m_height; ++y)
-            m_rgbDataBackupBuffer[y] = new uint8_t[bufRowSize];
-    }
-
-    copyRGBData(m_rgbDataBackupBuffer, m_rgbDataBuffer);
-}
-
-void Image::backupRGB32Data()
-{
-    uint8_t bytesNum = 4;
-
-    // calculating the PNG pixel buffer size. This way is more understandable in terms of logic
-    size_t bufRowSize = m_width * bytesNum * (m_colorDepth / (sizeof(uint8_t) * 8)) * sizeof(uint8_t);
-
-    // the backup image already exists
-    if (m_rgb32DataBackupBuffer == nullptr)
-    {
-        m_rgb32DataBackupBuffer = new uint8_t*[m_height]();
-
-        for (uint32_t y = 0; y < m_height; ++y)
-            m_rgb32DataBackupBuffer[y] = new uint8_t[bufRowSize];
-    }
-
-    copyRGB32Data(m_rgb32DataBackupBuffer, m_rgb32DataBuffer);
-}
-
-void Image::backupRGB32FlatData()
-{
-    uint8_t bytesNum = 4;
-
-    // calculating the PNG pixel buffer size. This way is more understandable in terms of logic
-    size_t bufSize = m_width * m_height * bytesNum * (m_colorDepth / (sizeof(uint8_t) * 8)) * sizeof(uint8_t);
-
-    // the backup image already exists
-    if (m_rgb32FlatDataBackupBuffer == nullptr)
-        m_rgb32FlatDataBackupBuffer = new uint8_t[bufSize];
-
-    copyRGB32FlatData(m_rgb32FlatDataBackupBuffer, m_rgb32FlatDataBuffer);
-}
-
-void Image::restoreRGBData()
-{
-    if (m_rgbDataBackupBuffer != nullptr)
-        copyRGBData(m_rgbDataBuffer, m_rgbDataBackupBuffer);
-}
-
-void Image::restoreGB32Data()
-{
-    if (m_rgb32DataBackupBuffer != nullptr)
-        copyRGB32Data(m_rgb32DataBuffer, m_rgb32DataBackupBuffer);
-}
-
-void Image::restoreRGB32FlatData()
-{
-    if (m_rgb32FlatDataBackupBuffer != nullptr)
-        copyRGB32FlatData(m_rgb32FlatDataBuffer, m_rgb32FlatDataBackupBuffer);
-}
-
-void Image::deleteAllBackupRGBData()
-{
-    _deleteRGBData(m_rgbDataBackupBuffer);
-    _deleteRGB32Data(m_rgb32DataBackupBuffer);
-    _deleteRGB32FlatData(m_rgb32FlatDataBackupBuffer);
+    m_renderSettings = ImageRenderSettings();
 }
 
 void Image::_deleteRGBData(uint8_t**& a_rgbDataBuffer)
@@ -358,7 +310,6 @@ void Image::deleteRGB32FlatData()
 void Image::deleteAllData()
 {
     deleteAllRGBData();
-    deleteAllBackupRGBData();
 }
 
 int32_t Image::createRGBData(uint32_t a_transformType, int32_t a_percent)
@@ -384,98 +335,66 @@ int32_t Image::createRGBData(uint32_t a_transformType, int32_t a_percent)
     if (m_rgbDataBuffer == nullptr)
         return FITS_GENERAL_ERROR;
 
-    uint8_t* tmpRow = new uint8_t[tmpBufRowSize];
-
-    uint8_t* tmpDestRow = nullptr;
-
-    uint8_t* tmpFinalRow = tmpRow;
-
-    if (m_bitpix == 16 || m_bitpix == 8)
-    {
-        //tmpDestRow = new uint8_t[tmpBufRowSize * (bytesNum == 2 ? 2 : 1)];
-        tmpDestRow = new uint8_t[tmpBufRowSize * (32/std::abs(m_bitpix))];
-        tmpFinalRow = tmpDestRow;
-    }
+    //// 8 and 16-bit values are converted into 32-bit words of an extra row
+    size_t tmpDestRowSize = (m_bitpix == 16 || m_bitpix == 8) ? tmpBufRowSize * (32/std::abs(m_bitpix)) : 0;
 
     m_transformType = a_transformType;
 
     calcBufferDistribution(a_percent);
 
-    // Writing the buffer containing pixel data
+    // Writing the buffer containing pixel data, the rows are converted by bands on all the cores
     try
     {
         //uint32_t indexBase = bytesNum * (bytesNum == 2 ? 2 : 1);
         uint32_t indexBase = bytesNum * (bytesNum <= 2 ? 32/std::abs(m_bitpix) : 1);
 
-        for (int64_t y = m_height - 1; y >= 0; --y) //// this loop is for correcting Y-axis upside down showing
+        for (uint32_t y = 0; y < m_height; ++y)
         {
-            //libnfits::LOG(" in createRGBData() 1 , y = % , bufRowSize = % , tmpBufRowSize = %" , y, bufRowSize, tmpBufRowSize);
             m_rgbDataBuffer[y] = new uint8_t[bufRowSize];
             std::memset(m_rgbDataBuffer[y] , 0, bufRowSize);
+        }
 
-            //// this memcpy is for correcting Y-axis upside down showing
-            size_t offset = (m_height - 1 - y) * tmpBufRowSize;
+        retVal = processRowBands(m_height, m_width, [&](size_t a_firstRow, size_t a_lastRow, std::vector<uint8_t>& a_scratch)
+        {
+            //// temporary rows of the thread, the 32-bit words row goes first to stay aligned
+            a_scratch.resize(tmpDestRowSize + tmpBufRowSize);
 
-            //// checking if the memory-mapped file is corrupted and not all data is available
-            //// e.g. data required by the HDUs is bigger then the file itself
-            if ((m_baseOffset + offset + tmpBufRowSize) > m_maxDataBufferSize)
-                continue;
-            ////
+            uint8_t* tmpDestRow = (tmpDestRowSize != 0) ? a_scratch.data() : nullptr;
+            uint8_t* tmpRow = a_scratch.data() + tmpDestRowSize;
+            uint8_t* tmpFinalRow = (tmpDestRow != nullptr) ? tmpDestRow : tmpRow;
 
-            //// This case should not occur as FITS doesn't officially support 24-bit data values.
-            //// Moreover, only bytesNum  is 3 and 4 are checked in this function.
-            //// The (bytesNum == 3) is kept just in case if 24-bit data value support will be added one day.
-            //// Otherwise, ideally this part of code should be removed
-            /*
-            if (bytesNum == 3)
+            for (size_t row = a_firstRow; row < a_lastRow; ++row)
             {
-                //// this memcpy is for correcting Y-axis upside down showing
-                std::memcpy(m_rgbDataBuffer[m_height - 1 - y], m_dataBuffer + ((m_height - 1 - y) * bufRowSize), bufRowSize);
+                size_t y = m_height - 1 - row;   //// this is for correcting Y-axis upside down showing
+                size_t offset = row * tmpBufRowSize;
 
-                for (uint32_t x = 0; x < m_width; ++x)
-                {
-                    uint8_t b = m_rgbDataBuffer[y][x*3];
-                    uint8_t g = m_rgbDataBuffer[y][x*3 + 1];
-                    uint8_t r = m_rgbDataBuffer[y][x*3 + 2];
-
-                    m_rgbDataBuffer[y][x*3]     = r;
-                    m_rgbDataBuffer[y][x*3 + 1] = g;
-                    m_rgbDataBuffer[y][x*3 + 2] = b;
-                }
-            }
-            else if (bytesNum == 4 || bytesNum == 8)
-            */
-            //{
-                //std::memcpy(tmpRow, m_dataBuffer + (y * tmpBufRowSize), tmpBufRowSize);
+                //// checking if the memory-mapped file is corrupted and not all data is available
+                //// e.g. data required by the HDUs is bigger then the file itself
+                if ((m_baseOffset + offset + tmpBufRowSize) > m_maxDataBufferSize)
+                    continue;
+                ////
 
-            //// this memcpy is for correcting Y-axis upside down showing
-            std::memcpy(tmpRow, m_dataBuffer + offset, tmpBufRowSize);
+                std::memcpy(tmpRow, m_dataBuffer + offset, tmpBufRowSize);
 
-            convertBufferAllTypes2RGB(tmpRow, tmpBufRowSize, tmpDestRow);
+                convertBufferAllTypes2RGB(tmpRow, tmpBufRowSize, tmpDestRow);
 
-            for (uint32_t x = 0; x < m_width; ++x)
-            {
-                uint64_t indexSource = x*indexBase;
-                uint64_t indexDest = x*3;
+                for (uint32_t x = 0; x < m_width; ++x)
+                {
+                    uint64_t indexSource = x*indexBase;
+                    uint64_t indexDest = x*3;
 
-                m_rgbDataBuffer[y][indexDest]     = tmpFinalRow[indexSource];
-                m_rgbDataBuffer[y][indexDest + 1] = tmpFinalRow[indexSource + 1];
-                m_rgbDataBuffer[y][indexDest + 2] = tmpFinalRow[indexSource + 2];
+                    m_rgbDataBuffer[y][indexDest]     = tmpFinalRow[indexSource];
+                    m_rgbDataBuffer[y][indexDest + 1] = tmpFinalRow[indexSource + 1];
+                    m_rgbDataBuffer[y][indexDest + 2] = tmpFinalRow[indexSource + 2];
+                }
             }
-            //}
-        }
+        });
     }
     catch (...)
     {
         retVal = FITS_GENERAL_ERROR;
     }
 
-    if (tmpRow != nullptr)
-        delete [] tmpRow;
-
-    if (tmpDestRow != nullptr)
-        delete [] tmpDestRow;
-
     return retVal;
 }
 
@@ -505,75 +424,71 @@ int32_t Image::createRGB32Data(uint32_t a_transformType, int32_t a_percent)
     if (m_rgb32DataBuffer == nullptr)
         return FITS_GENERAL_ERROR;
 
-    uint8_t* tmpRow = new uint8_t[tmpBufRowSize];
-
-    uint8_t* tmpDestRow = nullptr;
-
-    uint8_t* tmpFinalRow = tmpRow;
-
-    if (m_bitpix == 16 || m_bitpix == 8)
-    {
-        //tmpDestRow = new uint8_t[tmpBufRowSize * (bytesNum == 2 ? 2 : 1)];
-        tmpDestRow = new uint8_t[tmpBufRowSize * (32/std::abs(m_bitpix))];
-        tmpFinalRow = tmpDestRow;
-    }
+    //// 8 and 16-bit values are converted into 32-bit words of an extra row
+    size_t tmpDestRowSize = (m_bitpix == 16 || m_bitpix == 8) ? tmpBufRowSize * (32/std::abs(m_bitpix)) : 0;
 
     m_transformType = a_transformType;
 
     calcBufferDistribution(a_percent);
 
-    // Writing the buffer containing pixel data
+    // Writing the buffer containing pixel data, the rows are converted by bands on all the cores
     try
     {
         //uint32_t indexBase = bytesNum * (bytesNum == 2 ? 2 : 1);
         uint32_t indexBase = bytesNum * (bytesNum <= 2 ? 32/std::abs(m_bitpix) : 1);
 
-        for (int64_t y = m_height - 1; y >= 0; --y) //// this loop is for correcting Y-axis upside down showing
+        for (uint32_t y = 0; y < m_height; ++y)
         {
             m_rgb32DataBuffer[y] = new uint8_t[bufRowSize];
             std::memset(m_rgb32DataBuffer[y] , 0, bufRowSize);
+        }
 
-            //// this memcpy is for correcting Y-axis upside down showing
-            size_t offset = (m_height - 1 - y) * tmpBufRowSize;
+        retVal = processRowBands(m_height, m_width, [&](size_t a_firstRow, size_t a_lastRow, std::vector<uint8_t>& a_scratch)
+        {
+            //// temporary rows of the thread, the 32-bit words row goes first to stay aligned
+            a_scratch.resize(tmpDestRowSize + tmpBufRowSize);
 
-            //// checking if the memory-mapped file is corrupted and not all data is available
-            //// e.g. data required by the HDUs is bigger then the file itself
-            if ((m_baseOffset + offset + tmpBufRowSize) > m_maxDataBufferSize)
-                continue;
-            ////
+            uint8_t* tmpDestRow = (tmpDestRowSize != 0) ? a_scratch.data() : nullptr;
+            uint8_t* tmpRow = a_scratch.data() + tmpDestRowSize;
+            uint8_t* tmpFinalRow = (tmpDestRow != nullptr) ? tmpDestRow : tmpRow;
 
-            //// this memcpy is for correcting Y-axis upside down showing
-            std::memcpy(tmpRow, m_dataBuffer + offset, tmpBufRowSize);
+            for (size_t row = a_firstRow; row < a_lastRow; ++row)
+            {
+                size_t y = m_height - 1 - row;   //// this is for correcting Y-axis upside down showing
+                size_t offset = row * tmpBufRowSize;
 
-            convertBufferAllTypes2RGB(tmpRow, tmpBufRowSize, tmpDestRow);
+                //// checking if the memory-mapped file is corrupted and not all data is available
+                //// e.g. data required by the HDUs is bigger then the file itself
+                if ((m_baseOffset + offset + tmpBufRowSize) > m_maxDataBufferSize)
+                    continue;
+                ////
 
-            for (uint32_t x = 0; x < m_width; ++x)
-            {
-                uint64_t indexSource = x*indexBase;
-                uint64_t indexDest = x*4;
+                std::memcpy(tmpRow, m_dataBuffer + offset, tmpBufRowSize);
+
+                convertBufferAllTypes2RGB(tmpRow, tmpBufRowSize, tmpDestRow);
+
+                for (uint32_t x = 0; x < m_width; ++x)
+                {
+                    uint64_t indexSource = x*indexBase;
+                    uint64_t indexDest = x*4;
 
-                m_rgb32DataBuffer[y][indexDest]     = tmpFinalRow[indexSource + 2];
-                m_rgb32DataBuffer[y][indexDest + 1] = tmpFinalRow[indexSource + 1];
-                m_rgb32DataBuffer[y][indexDest + 2] = tmpFinalRow[indexSource];
-                m_rgb32DataBuffer[y][indexDest + 3] = 0xff;
+                    m_rgb32DataBuffer[y][indexDest]     = tmpFinalRow[indexSource + 2];
+                    m_rgb32DataBuffer[y][indexDest + 1] = tmpFinalRow[indexSource + 1];
+                    m_rgb32DataBuffer[y][indexDest + 2] = tmpFinalRow[indexSource];
+                    m_rgb32DataBuffer[y][indexDest + 3] = 0xff;
+                }
             }
-        }
+        });
     }
     catch (...)
     {
         retVal = FITS_GENERAL_ERROR;
     }
 
-    if (tmpRow != nullptr)
-        delete [] tmpRow;
-
-    if (tmpDestRow != nullptr)
-        delete [] tmpDestRow;
-
     return retVal;
 }
 
-int32_t Image::createRGB32FlatData(uint32_t a_transformType, float a_percent)
+int32_t Image::createRGB32FlatData(uint32_t a_transformType, float a_percent, uint32_t a_percentileMethod)
 {
     int32_t retVal = FITS_GENERAL_SUCCESS;
 
@@ -606,61 +521,18 @@ int32_t Image::createRGB32FlatData(uint32_t a_transformType, float a_percent)
 #else
         m_rgb32FlatDataBuffer = new uint8_t[flatBufSize];
 #endif
-        std::memset(m_rgb32FlatDataBuffer, 0, flatBufSize);
+        //// the rows are cleared or rendered by the row bands below, not all at once here
     }
 
     if (m_rgb32FlatDataBuffer == nullptr)
         return FITS_GENERAL_ERROR;
 
-#if defined(__unix__)
-    /// May need to use cache-line size aligment for further performance improvements.
-    /// Currently does not work properly for Windows builds, tested only for Linux
-
-    ///uint8_t* tmpRow = new (std::align_val_t{std::hardware_destructive_interference_size}) uint8_t[tmpBufRowSize];
-
-    uint8_t* tmpRow = new uint8_t[tmpBufRowSize];
-#else
-    uint8_t* tmpRow = new uint8_t[tmpBufRowSize];
-#endif
-
-    uint8_t* tmpDestRow = nullptr;
-
-    uint8_t* tmpFinalRow = tmpRow;
-
-    ///if (m_bitpix == 8 || m_bitpix == 16 || m_bitpix == 32 || m_bitpix == 64)
-    if (m_bitpix >= 8 && m_bitpix <= 32)
-    {
-        //tmpDestRow = new uint8_t[tmpBufRowSize * (bytesNum == 2 ? 2 : 1)];
-#if defined(__unix__)
-        /// May need to use cache-line size aligment for further performance improvements.
-        /// Currently does not work properly for Windows builds, tested only for Linux
-
-        ///tmpDestRow = new (std::align_val_t{std::hardware_destructive_interference_size}) uint8_t[tmpBufRowSize * (32/m_bitpix)]; /// original version
-
-        tmpDestRow = new uint8_t[tmpBufRowSize * (32/m_bitpix)]; /// original version
-#else
-        tmpDestRow = new uint8_t[tmpBufRowSize * (32/m_bitpix)]; /// original version
-#endif
-        tmpFinalRow = tmpDestRow;
-
-    }
-    else if (m_bitpix == 64)  /// new fixed version for 64-bit HDUs
-    {
-#if defined(__unix__)
-        /// May need to use cache-line size aligment for further performance improvements.
-        /// Currently does not work properly for Windows builds, tested only for Linux
-
-        ///tmpDestRow = new (std::align_val_t{std::hardware_destructive_interference_size}) uint8_t[tmpBufRowSize]; /// new fixed version for 64-bit HDUs
-
-        tmpDestRow = new uint8_t[tmpBufRowSize]; /// new fixed version for 64-bit HDUs
-#else
-        tmpDestRow = new uint8_t[tmpBufRowSize]; /// new fixed version for 64-bit HDUs
-#endif
-        tmpFinalRow = tmpDestRow;
-    }
-
     m_transformType = a_transformType;
 
+    m_renderSettings.transformType = a_transformType;
+    m_renderSettings.percent = a_percent;
+    m_renderSettings.percentileMethod = a_percentileMethod;
+
     m_finalClippedMinValue = m_finalMinValue;
     m_finalClippedMaxValue = m_finalMaxValue;
     m_finalClippedMinValueL = m_finalMinValueL;
@@ -674,7 +546,12 @@ int32_t Image::createRGB32FlatData(uint32_t a_transformType, float a_percent)
     {
         m_percentThreshold = a_percent - FITS_PERCENTILE_THRESHOLD_OFFSET;
 
-        if (!areEqual(m_percentThreshold, 100.0f))
+        if (!areEqual(m_percentThreshold, 100.0f) && a_percentileMethod != FITS_PERCENTILE_METHOD_HISTOGRAM &&
+            selectPercentileMinMax(a_percentileMethod) == FITS_GENERAL_SUCCESS)
+        {
+            /// the clipped min/max are the selected pixels, the histogram is the fallback
+        }
+        else if (!areEqual(m_percentThreshold, 100.0f) && m_histogram)
         {
             double min, max;
             ///float minF, maxF;
@@ -684,36 +561,36 @@ int32_t Image::createRGB32FlatData(uint32_t a_transformType, float a_percent)
 
             if (m_bitpix == 8 || m_bitpix == 16)
             {
-                calcPercentileMinMax<int16_t>(m_distribStats, m_finalMinValueL, m_finalMaxValueL, m_percentThreshold,
+                calcPercentileMinMax<int16_t>(*m_histogram, m_finalMinValueL, m_finalMaxValueL, m_percentThreshold,
                                               min16, max16, m_width * m_height);
                 minL = min16;
                 maxL = max16;
             }
             else if (m_bitpix == -32)
             {
-                calcPercentileMinMax<double>(m_distribStats, m_finalMinValue, m_finalMaxValue, m_percentThreshold,
+                calcPercentileMinMax<double>(*m_histogram, m_finalMinValue, m_finalMaxValue, m_percentThreshold,
                                              min, max, m_width * m_height);
             }
             else if (m_bitpix == 32)
             {
-                calcPercentileMinMax<int32_t>(m_distribStats, m_finalMinValueL, m_finalMaxValueL, m_percentThreshold,
+                calcPercentileMinMax<int32_t>(*m_histogram, m_finalMinValueL, m_finalMaxValueL, m_percentThreshold,
                                               min32, max32, m_width * m_height);
                 minL = min32;
                 maxL = max32;
             }
             else if (m_bitpix == -64)
             {
-                calcPercentileMinMax<double>(m_distribStats, m_finalMinValue, m_finalMaxValue, m_percentThreshold,
+                calcPercentileMinMax<double>(*m_histogram, m_finalMinValue, m_finalMaxValue, m_percentThreshold,
                                              min, max, m_width * m_height);
             }
             else if (m_bitpix == 64)
             {
-                calcPercentileMinMax<int64_t>(m_distribStats, m_finalMinValueL, m_finalMaxValueL, m_percentThreshold,
+                calcPercentileMinMax<int64_t>(*m_histogram, m_finalMinValueL, m_finalMaxValueL, m_percentThreshold,
                                               minL, maxL, m_width * m_height);
             }
 
 
-            ///calcPercentileMinMax<float>(m_distribStats, m_finalMinValue, m_finalMaxValue, m_percentThreshold,
+            ///calcPercentileMinMax<float>(*m_histogram, m_finalMinValue, m_finalMaxValue, m_percentThreshold,
             ///                            min, max, m_width * m_height);
 
             m_finalClippedMinValue = min;
@@ -748,52 +625,112 @@ int32_t Image::createRGB32FlatData(uint32_t a_transformType, float a_percent)
     /// end of new histogram-based percentile calculation
     ///////////////////////////////////////////////////////////////
 
-    // Writing the buffer containing pixel data
+    // Writing the buffer containing pixel data: the samples are converted straight into the final pixels, no temporary rows.
+    // The kernel specialised for BITPIX, the stretch, BZERO/BSCALE and clipping is selected once for all rows.
+    // Re-rendering starts from the decoded samples if they are cached. The rows are rendered by bands on all the cores.
+    // The adjustments of m_renderSettings are applied to the table of the BITPIX 8 and 16 pixels once, to the rendered
+    // rows of the other ones.
     try
     {
-        //uint32_t indexBase = bytesNum * (bytesNum == 2 ? 2 : 1);
-        uint32_t indexBase = bytesNum * (bytesNum <= 2 ? 32/std::abs(m_bitpix) : 1);
+        size_t rowSamples = tmpBufRowSize / bytesNum;
+        std::shared_ptr<const SamplePlane> samplePlane = acquireSamplePlane(tmpBufRowSize, rowSamples);
 
-        for (int64_t y = m_height - 1; y >= 0; --y) //// this loop is for correcting Y-axis upside down showing
-        {
-            //// this memcpy is for correcting Y-axis upside down showing
-            size_t offset = (m_height - 1 - y) * tmpBufRowSize;
+        RenderParams renderParams;
+        std::vector<uint32_t> renderLut;
+        renderKernelPtr renderKernel = prepareRenderKernel(renderParams, renderLut, samplePlane != nullptr);
 
-            //// checking if the memory-mapped file is corrupted and not all data is available
-            //// e.g. data required by the HDUs is bigger then the file itself
-            if ((m_baseOffset + offset + tmpBufRowSize) > m_maxDataBufferSize)
-                break;
-            ////
-            std::memcpy(tmpRow, m_dataBuffer + offset, tmpBufRowSize);
+        ColorKernelParams colorParams;
+        bool isRowAdjusted = getColorKernelParams(colorParams);
 
-            convertBufferAllTypes2RGB(tmpRow, tmpBufRowSize, tmpDestRow);
+        if (isRowAdjusted && !renderLut.empty())
+        {
+            adjustRGB32FlatPixels(renderLut.data(), renderLut.size(), colorParams);
+            isRowAdjusted = false;
+        }
 
-            uint64_t y_width = y*m_width;
+        size_t planeRowSize = rowSamples * getSamplePlaneElementSize(m_bitpix);
 
-            for (uint32_t x = 0; x < m_width; ++x)
+        retVal = processRowBands(m_height, m_width, [&](size_t a_firstRow, size_t a_lastRow, std::vector<uint8_t>&)
+        {
+            for (size_t row = a_firstRow; row < a_lastRow; ++row)
             {
-                uint64_t indexSource = x*indexBase;
-                uint64_t indexDest = 4*(y_width + x); //4*(y*m_width + x);
+                size_t y = m_height - 1 - row;   //// this is for correcting Y-axis upside down showing
+                size_t offset = row * tmpBufRowSize;
+
+                uint32_t* destRow = reinterpret_cast<uint32_t*>(m_rgb32FlatDataBuffer) + y * m_width;
 
-                m_rgb32FlatDataBuffer[indexDest]     = tmpFinalRow[indexSource + 2];
-                m_rgb32FlatDataBuffer[indexDest + 1] = tmpFinalRow[indexSource + 1];
-                m_rgb32FlatDataBuffer[indexDest + 2] = tmpFinalRow[indexSource];
-                m_rgb32FlatDataBuffer[indexDest + 3] = 0xff;
+                //// checking if the memory-mapped file is corrupted and not all data is available
+                //// e.g. data required by the HDUs is bigger then the file itself, the rows (or all of them for
+                //// an unsupported BITPIX) stay blank
+                if (renderKernel == nullptr || (m_baseOffset + offset + tmpBufRowSize) > m_maxDataBufferSize)
+                {
+                    std::memset(destRow, 0, (size_t)m_width * sizeof(uint32_t));
+                    continue;
+                }
+                ////
+
+                const uint8_t* srcRow = m_dataBuffer + offset;
+
+                if (samplePlane != nullptr)
+                    srcRow = samplePlane->data.get() + row * planeRowSize;
+
+                renderKernel(srcRow, rowSamples, reinterpret_cast<uint8_t*>(destRow), renderParams);
+
+                if (isRowAdjusted)
+                    adjustRGB32FlatPixels(destRow, m_width, colorParams);
             }
-        }
+        });
+
+        m_isRendered = true;
     }
     catch (...)
     {
+        std::memset(m_rgb32FlatDataBuffer, 0, flatBufSize);
         retVal = FITS_GENERAL_ERROR;
     }
 
-    if (tmpRow != nullptr)
-        delete [] tmpRow;
+    return retVal;
+}
 
-    if (tmpDestRow != nullptr)
-        delete [] tmpDestRow;
+// The image is rendered again only if the settings differ from the ones it is shown with
+int32_t Image::render(const ImageRenderSettings& a_settings)
+{
+    if (m_rgb32FlatDataBuffer != nullptr && a_settings == m_renderSettings)
+        return FITS_GENERAL_SUCCESS;
 
-    return retVal;
+    m_renderSettings = a_settings;
+
+    deleteRGB32FlatData();
+
+    return createRGB32FlatData(a_settings.transformType, a_settings.percent, a_settings.percentileMethod);
+}
+
+const ImageRenderSettings& Image::getRenderSettings() const
+{
+    return m_renderSettings;
+}
+
+// The adjustments of m_renderSettings, false if there are none
+bool Image::getColorKernelParams(ColorKernelParams& a_params) const
+{
+    a_params = {};
+
+    float quatients[3];
+
+    for (int32_t channel = 0; channel < 3; ++channel)
+        quatients[channel] = std::clamp(m_renderSettings.levels[channel], (float)MIN_RGB_CHANNEL_CHANGE_FACTOR,
+                                        (float)MAX_RGB_CHANNEL_CHANGE_FACTOR);
+
+    setColorKernelLevels(a_params, quatients);
+
+    a_params.bLevels = !(areEqual(m_renderSettings.levels[0], 1.0f) && areEqual(m_renderSettings.levels[1], 1.0f) &&
+                         areEqual(m_renderSettings.levels[2], 1.0f));
+
+    a_params.bGrayscale = m_renderSettings.grayscale;
+    a_params.bEyeComfort = m_renderSettings.eyeComfort;
+    a_params.brightnessThreshold = m_renderSettings.brightnessThreshold;
+
+    return a_params.bLevels || a_params.bGrayscale || a_params.bEyeComfort || a_params.brightnessThreshold != 0;
 }
 
 uint8_t** Image::getRGBData() const
@@ -988,6 +925,21 @@ int32_t Image::change32FlatBLevel(float a_quatient)
     return _changeRGB32FlatColorChannelLevel(2, a_quatient);
 }
 
+// All three channels are scaled in place in one pass over the rows of all the cores by the color kernels. The R, G and
+// B factors are for the channels 0, 1 and 2 (the bits 0-7, 8-15 and 16-23 of the pixel words) as in
+// _changeRGB32FlatColorChannelLevel(). render() sets the levels without changing the pixels.
+int32_t Image::change32FlatLevels(float a_rQuatient, float a_gQuatient, float a_bQuatient)
+{
+    ColorKernelParams params = {};
+    float quatients[3] = { a_rQuatient, a_gQuatient, a_bQuatient };
+
+    for (int32_t channel = 0; channel < 3; ++channel)
+        quatients[channel] = std::clamp(quatients[channel], (float)MIN_RGB_CHANNEL_CHANGE_FACTOR, (float)MAX_RGB_CHANNEL_CHANGE_FACTOR);
+
+    setColorKernelLevels(params, quatients);
+
+    return adjustBufferRGB32FlatColors(m_rgb32FlatDataBuffer, m_width, m_height, params);
+}
 
 int32_t Image::convertRGB2Grayscale()
 {
@@ -1129,105 +1081,65 @@ void Image::calcRGB32DataColorStats()
     m_colorStats = { sumR, sumG, sumB, countR, countG, countB, avgR, avgG, avgB, minR, minG, minB, maxR, maxG, maxB };
 }
 
+// The pixels are split into one part per thread, the vector kernels count the statistics of the parts
 void Image::calcRGB32FlatDataColorStats()
 {
-    uint64_t sumR = 0, sumG = 0, sumB = 0;
-    uint64_t countR = 0, countG = 0, countB = 0;
-    uint8_t avgR = 0, avgG = 0, avgB = 0;
-    uint8_t minR = 0xff, minG = 0xff, minB = 0xff;
-    uint8_t maxR = 0, maxG = 0, maxB = 0;
+    ColorKernelResult stats = { {}, {}, { 0xff, 0xff, 0xff }, {} };
 
     if (m_rgb32FlatDataBuffer != nullptr)
     {
-        for (uint32_t y = 0; y < m_height; ++y)
-            for (uint32_t x = 0; x < m_width; ++x)
-            {
-                uint8_t val;
+        const uint32_t* pixels = reinterpret_cast<const uint32_t*>(m_rgb32FlatDataBuffer);
+        const size_t count = (size_t)m_width * m_height;
+        const size_t partsNumber = getRowBandThreadsNumber((count + FITS_RENDER_BAND_PIXELS - 1) / FITS_RENDER_BAND_PIXELS);
+        const size_t partSize = (count + partsNumber - 1) / partsNumber;
 
-                val = m_rgb32FlatDataBuffer[4*(y*m_width + x) + 2];
-                if (val > 0) ++countR;
-                if (val > maxR) maxR = val;
-                if (val < minR) minR = val;
-                sumR += val;
+        std::vector<ColorKernelResult> parts(partsNumber, stats);
 
-                val = m_rgb32FlatDataBuffer[4*(y*m_width + x) + 1];
-                if (val > 0) ++countG;
-                if (val > maxG) maxG = val;
-                if (val < minG) minG = val;
-                sumG += val;
+        processRowBands(partsNumber, std::max<size_t>(partSize, FITS_RENDER_BAND_PIXELS),
+                        [&](size_t a_firstPart, size_t a_lastPart, std::vector<uint8_t>&)
+        {
+            for (size_t partIndex = a_firstPart; partIndex < a_lastPart; ++partIndex)
+            {
+                const size_t first = std::min(partIndex * partSize, count);
+                const size_t last = std::min(first + partSize, count);
 
-                val = m_rgb32FlatDataBuffer[4*(y*m_width + x)];
-                if (val > 0) ++countB;
-                if (val > maxB) maxB = val;
-                if (val < minB) minB = val;
-                sumB += val;
+                calcRGB32FlatPixelsColorStats(pixels + first, last - first, parts[partIndex]);
             }
+        });
 
-        if (countR > 0) avgR = sumR / countR;
-        if (countG > 0) avgG = sumG / countG;
-        if (countB > 0) avgB = sumB / countB;
+        for (const ColorKernelResult& part : parts)
+        {
+            for (size_t channel = 0; channel < 3; ++channel)
+            {
+                stats.sum[channel] += part.sum[channel];
+                stats.count[channel] += part.count[channel];
+                stats.min[channel] = std::min(stats.min[channel], part.min[channel]);
+                stats.max[channel] = std::max(stats.max[channel], part.max[channel]);
+            }
+        }
     }
 
-    m_colorStats = { sumR, sumG, sumB, countR, countG, countB, avgR, avgG, avgB, minR, minG, minB, maxR, maxG, maxB };
+    //// the channel 2 is red, 0 is blue
+    m_colorStats = { stats.sum[2], stats.sum[1], stats.sum[0], stats.count[2], stats.count[1], stats.count[0],
+                     (uint8_t)(stats.count[2] > 0 ? stats.sum[2] / stats.count[2] : 0),
+                     (uint8_t)(stats.count[1] > 0 ? stats.sum[1] / stats.count[1] : 0),
+                     (uint8_t)(stats.count[0] > 0 ? stats.sum[0] / stats.count[0] : 0),
+                     stats.min[2], stats.min[1], stats.min[0], stats.max[2], stats.max[1], stats.max[0] };
 }
 
 void Image::_convertRGB2AltColors(uint8_t a_red, uint8_t a_green, uint8_t a_blue,
                                   uint8_t& a_newRed, uint8_t& a_newGreen, uint8_t& a_newBlue)
 {
-    const uint8_t rgbThreshold = 0x7f;
-    const uint8_t avgQuatient = 2;
-
-    a_newRed = a_red;
-    a_newGreen = a_green;
-    a_newBlue = a_blue;
-
-    // finding the brightest objects and converting their colors to human-eye pleasant ones
-    if (greater3(a_red, a_green, a_blue, rgbThreshold))
-    {
-        if (a_blue > a_red && a_blue > a_green)
-        {
-            a_newRed = 0xff / avgQuatient;
-            a_newGreen = (255 - ((float)a_blue / 0xff) * (255 - 102)) / avgQuatient;
-            a_newBlue = (0xff - a_blue) / avgQuatient;
-        }
-        else if (a_green > a_blue && a_green > a_red)
-        {
-            a_newRed = 0xff;
-            a_newGreen = 240 - ((float)a_blue / 0xff) * (240 - 102);
-            a_newBlue = 0xff - a_blue;
-        }
-        else if (a_red > a_blue && a_red > a_green)
-        {
-            a_newGreen = 0xff;
-            a_newRed = 0xff - a_blue;
-            a_newBlue = 240 - ((float)a_green / 0xff) * (240 - 102);
-        }
-    }
+    convertRGB2EyeComfortColors(a_red, a_green, a_blue, a_newRed, a_newGreen, a_newBlue);
 }
 
 void Image::_convertBufferRGB32Flat2EyeComfortColors()
 {
-    if (m_rgb32FlatDataBuffer == nullptr)
-        return;
-
-#if defined(ENABLE_OPENMP)
-#pragma omp parallel for collapse(2)
-#endif
-    for (uint32_t y = 0; y < m_height; ++y)
-        for (uint32_t x = 0; x < m_width; ++x)
-        {
-            uint8_t red, green, blue;
-
-            size_t indexBase = 4*(y*m_width + x);
+    ColorKernelParams params = {};
 
-            _convertRGB2AltColors(m_rgb32FlatDataBuffer[indexBase + 2], m_rgb32FlatDataBuffer[indexBase + 1],
-                                  m_rgb32FlatDataBuffer[indexBase], red, green, blue);
+    params.bEyeComfort = true;
 
-            m_rgb32FlatDataBuffer[indexBase] = blue;
-            m_rgb32FlatDataBuffer[indexBase + 1] = green;
-            m_rgb32FlatDataBuffer[indexBase + 2] = red;
-            m_rgb32FlatDataBuffer[indexBase + 3] = 0xff;
-        }
+    adjustBufferRGB32FlatColors(m_rgb32FlatDataBuffer, m_width, m_height, params);
 }
 
 int32_t Image::convertRGB32Flat2EyeComfortColors()
@@ -1331,28 +1243,14 @@ void Image::processRGB32BrightnessFilter(uint8_t a_threshold)
     }
 }
 
+// The brightness is the one of the red channel 2 and the blue channel 0 as in the eye comfort colors
 void Image::processRGBB32FlatBrightnessFilter(uint8_t a_threshold)
 {
-    if (m_rgb32FlatDataBuffer == nullptr)
-        return;
-
-    for (int32_t y = 0; y < m_height; ++y)
-    {
-        for (int32_t x = 0; x < m_width; ++x)
-        {
-            uint64_t indexDest = 4*(y*m_width + x);
+    ColorKernelParams params = {};
 
-            uint8_t brightness = calcPixelBrightness(m_rgb32FlatDataBuffer[indexDest], m_rgb32FlatDataBuffer[indexDest+1],
-                                                     m_rgb32FlatDataBuffer[indexDest + 2]);
+    params.brightnessThreshold = a_threshold;
 
-            if (brightness < a_threshold)
-            {
-                m_rgb32FlatDataBuffer[indexDest]     = 0;
-                m_rgb32FlatDataBuffer[indexDest + 1] = 0;
-                m_rgb32FlatDataBuffer[indexDest + 2] = 0;
-            }
-        }
-    }
+    adjustBufferRGB32FlatColors(m_rgb32FlatDataBuffer, m_width, m_height, params);
 }
 
 void Image::setMinValue(double a_value)
@@ -1428,84 +1326,152 @@ void Image::setMinMaxValuesL(int64_t a_minValue, int64_t a_maxValue)
 }
 
 template<typename T> void Image::calcBufferMinMax()
+{
+    if (m_isMinMaxCounted && !m_isStatsApproximate)
+        return;
+
+    ImageStats stats;
+
+    if (calcBufferStats<T>(stats) == FITS_GENERAL_SUCCESS)
+        setStats(stats);
+}
+
+template<typename T> void Image::calcBufferQuickStats(size_t a_samplePixels)
 {
     if (m_isMinMaxCounted)
         return;
 
-    float minValueF = 0.0, maxValueF = 0.0;
-    double minValueD = 0.0, maxValueD = 0.0;
+    ImageStats stats;
 
-    uint8_t minValue8 = 0, maxValue8 = 0;
-    int16_t minValue16 = 0, maxValue16 = 0;
-    int32_t minValue32 = 0, maxValue32 = 0;
-    int64_t minValue64 = 0, maxValue64 = 0;
+    if (calcBufferStats<T>(stats, a_samplePixels) == FITS_GENERAL_SUCCESS)
+        setStats(stats);
+}
 
-    size_t size = m_width * m_height * sizeof(T);
+template<typename T> int32_t Image::calcBufferStats(ImageStats& a_stats, size_t a_samplePixels) const
+{
+    size_t count = (size_t)m_width * m_height;
+    size_t size = count * sizeof(T);
 
-    if (m_baseOffset + size <= m_maxDataBufferSize)
-    {                
-        if (std::is_same<T, float>::value)
-        {
-            libnfits::getFloatBufferMinMax(m_dataBuffer, size, minValueF, maxValueF);
+    a_stats.minValue = a_stats.maxValue = 0.0;
+    a_stats.minValueL = a_stats.maxValueL = 0;
+    a_stats.invalidPixelsCount = 0;
+    a_stats.isApproximate = false;
+    a_stats.histogram.setBins(m_histogramBinsNumber, m_histogramSpacing);
 
-            m_minValue = minValueF;
-            m_maxValue = maxValueF;
+    if (m_dataBuffer == nullptr || m_baseOffset + size > m_maxDataBufferSize)
+        return FITS_GENERAL_ERROR;
 
-            return;
-        }
+    //// Every stride-th pixel is counted for the quick look, the stride is coprime with the width,
+    //// so the sampled pixels don't line up in the same columns.
+    size_t stride = 1;
 
-        if (std::is_same<T, double>::value)
-        {
-            libnfits::getDoubleBufferMinMax(m_dataBuffer, size, minValueD, maxValueD);
+    if (a_samplePixels != 0 && count / a_samplePixels > 1)
+    {
+        stride = count / a_samplePixels;
 
-            m_minValue = minValueD;
-            m_maxValue = maxValueD;
+        while (m_width > 1 && std::gcd(stride, (size_t)m_width) != 1)
+            ++stride;
+    }
 
-            return;
-        }
+    T minValue = 0, maxValue = 0;
 
-        if (std::is_same<T, uint8_t>::value)
-        {
-            libnfits::getByteBufferMinMax(m_dataBuffer, size, minValue8, maxValue8);
+    /// the histogram is counted in the same pass
+    int32_t retVal = libnfits::getBufferStats<T>(m_dataBuffer, size, minValue, maxValue, a_stats.invalidPixelsCount,
+                                                 a_stats.histogram, m_isBlankDefined, m_blankValue, stride);
 
-            m_minValueL = minValue8;
-            m_maxValueL = maxValue8;
+    /// an image without valid pixels gets 0 as min and max
+    if (retVal != FITS_GENERAL_SUCCESS && a_stats.invalidPixelsCount != (count + stride - 1) / stride)
+        return retVal;
 
-            return;
-        }
+    if (std::is_floating_point<T>::value)
+    {
+        a_stats.minValue = minValue;
+        a_stats.maxValue = maxValue;
+    }
+    else
+    {
+        a_stats.minValueL = minValue;
+        a_stats.maxValueL = maxValue;
+    }
 
-        if (std::is_same<T, int16_t>::value)
-        {
-            libnfits::getShortBufferMinMax(m_dataBuffer, size, minValue16, maxValue16);
+    /// the sampled counts are scaled to the whole image
+    if (stride > 1)
+    {
+        a_stats.isApproximate = true;
+        a_stats.invalidPixelsCount = std::min(a_stats.invalidPixelsCount * stride, count);
 
-            m_minValueL = minValue16;
-            m_maxValueL = maxValue16;
+        DistribStats* bins = a_stats.histogram.getBins();
 
-            return;
-        }
+        for (size_t i = 0; i < a_stats.histogram.getBinsNumber(); ++i)
+            bins[i].count *= stride;
+    }
 
-        if (std::is_same<T, int32_t>::value)
-        {
-            libnfits::getIntBufferMinMax(m_dataBuffer, size, minValue32, maxValue32);
+    /// the percentile fallback of the HISTOGRAM method reads the CDF
+    a_stats.histogram.calcPercents(count - a_stats.invalidPixelsCount);
 
-            m_minValueL = minValue32;
-            m_maxValueL = maxValue32;
+    return FITS_GENERAL_SUCCESS;
+}
 
-            return;
-        }
+void Image::setStats(const ImageStats& a_stats)
+{
+    m_minValue = a_stats.minValue;
+    m_maxValue = a_stats.maxValue;
+    m_minValueL = a_stats.minValueL;
+    m_maxValueL = a_stats.maxValueL;
+    m_invalidPixelsCount = a_stats.invalidPixelsCount;
+    m_isStatsApproximate = a_stats.isApproximate;
 
-        if (std::is_same<T, int64_t>::value)
-        {
-            libnfits::getLongBufferMinMax(m_dataBuffer, size, minValue64, maxValue64);
+    m_histogram = std::make_unique<Histogram>(a_stats.histogram);
 
-            m_minValueL = minValue64;
-            m_maxValueL = maxValue64;
+    m_isDistribCounted = true;
+    m_isMinMaxCounted = true;
+    m_percentThreshold = -1.0f;
+    m_selectedPercent = -1.0f;
+}
 
-            return;
-        }
+// The counted statistics as setStats() takes them, an error if they aren't counted yet
+int32_t Image::getStats(ImageStats& a_stats) const
+{
+    if (!m_isMinMaxCounted || !m_isDistribCounted || !m_histogram)
+        return FITS_GENERAL_ERROR;
 
-        m_isMinMaxCounted =true;
-    }
+    a_stats.minValue = m_minValue;
+    a_stats.maxValue = m_maxValue;
+    a_stats.minValueL = m_minValueL;
+    a_stats.maxValueL = m_maxValueL;
+    a_stats.invalidPixelsCount = m_invalidPixelsCount;
+    a_stats.isApproximate = m_isStatsApproximate;
+    a_stats.histogram = *m_histogram;
+
+    return FITS_GENERAL_SUCCESS;
+}
+
+bool Image::isStatsApproximate() const
+{
+    return m_isStatsApproximate;
+}
+
+void Image::setBlankValue(int64_t a_blankValue)
+{
+    m_blankValue = a_blankValue;
+    m_isBlankDefined = true;
+    m_isMinMaxCounted = false;
+    m_selectedPercent = -1.0f;
+}
+
+bool Image::isBlankDefined() const
+{
+    return m_isBlankDefined;
+}
+
+int64_t Image::getBlankValue() const
+{
+    return m_blankValue;
+}
+
+size_t Image::getInvalidPixelsCount() const
+{
+    return m_invalidPixelsCount;
 }
 
 template<typename T> T Image::getMinValue() const
@@ -1604,6 +1570,20 @@ template void Image::calcBufferMinMax<int16_t>();
 template void Image::calcBufferMinMax<int32_t>();
 template void Image::calcBufferMinMax<int64_t>();
 
+template void Image::calcBufferQuickStats<float>(size_t);
+template void Image::calcBufferQuickStats<double>(size_t);
+template void Image::calcBufferQuickStats<uint8_t>(size_t);
+template void Image::calcBufferQuickStats<int16_t>(size_t);
+template void Image::calcBufferQuickStats<int32_t>(size_t);
+template void Image::calcBufferQuickStats<int64_t>(size_t);
+
+template int32_t Image::calcBufferStats<float>(ImageStats&, size_t) const;
+template int32_t Image::calcBufferStats<double>(ImageStats&, size_t) const;
+template int32_t Image::calcBufferStats<uint8_t>(ImageStats&, size_t) const;
+template int32_t Image::calcBufferStats<int16_t>(ImageStats&, size_t) const;
+template int32_t Image::calcBufferStats<int32_t>(ImageStats&, size_t) const;
+template int32_t Image::calcBufferStats<int64_t>(ImageStats&, size_t) const;
+
 template float Image::getMinValue<float>() const;
 template float Image::getMaxValue<float>() const;
 
@@ -1653,7 +1633,7 @@ void Image::calcBufferDistribution(int32_t a_percent)
             float tmpMin, tmpMax;
 
             getBufferDistributionMinMax<float>(m_dataBuffer, m_width*m_height*bpx, percent,
-                                               m_minValue, m_maxValue, tmpMin, tmpMax, m_distribStats, m_isDistribCounted);
+                                               m_minValue, m_maxValue, tmpMin, tmpMax, acquireHistogram(), m_isDistribCounted);
 
             m_isDistribCounted = true;
             m_minDistribValue = tmpMin;
@@ -1668,7 +1648,7 @@ void Image::calcBufferDistribution(int32_t a_percent)
             double tmpMin,tmpMax;
 
             getBufferDistributionMinMax<double>(m_dataBuffer, m_width*m_height*bpx, percent,
-                                                m_minValue, m_maxValue, tmpMin, tmpMax, m_distribStats, m_isDistribCounted);
+                                                m_minValue, m_maxValue, tmpMin, tmpMax, acquireHistogram(), m_isDistribCounted);
             m_isDistribCounted = true;
             m_minDistribValue = tmpMin;
             m_maxDistribValue = tmpMax;
@@ -1682,7 +1662,7 @@ void Image::calcBufferDistribution(int32_t a_percent)
             uint8_t tmpMin, tmpMax;
 
             getBufferDistributionMinMax<uint8_t>(m_dataBuffer, m_width*m_height*bpx, percent,
-                                                 m_minValueL, m_maxValueL, tmpMin, tmpMax, m_distribStats, m_isDistribCounted);
+                                                 m_minValueL, m_maxValueL, tmpMin, tmpMax, acquireHistogram(), m_isDistribCounted);
 
             m_isDistribCounted = true;
             m_minDistribValueL = tmpMin;
@@ -1697,7 +1677,7 @@ void Image::calcBufferDistribution(int32_t a_percent)
             int16_t tmpMin, tmpMax;
 
             getBufferDistributionMinMax<int16_t>(m_dataBuffer, m_width*m_height*bpx, percent,
-                                                 m_minValueL, m_maxValueL, tmpMin, tmpMax, m_distribStats, m_isDistribCounted);
+                                                 m_minValueL, m_maxValueL, tmpMin, tmpMax, acquireHistogram(), m_isDistribCounted);
 
             m_isDistribCounted = true;
             m_minDistribValueL = tmpMin;
@@ -1712,7 +1692,7 @@ void Image::calcBufferDistribution(int32_t a_percent)
             int32_t tmpMin, tmpMax;
 
             getBufferDistributionMinMax<int32_t>(m_dataBuffer, m_width*m_height*bpx, percent,
-                                                 m_minValueL, m_maxValueL, tmpMin, tmpMax, m_distribStats, m_isDistribCounted);
+                                                 m_minValueL, m_maxValueL, tmpMin, tmpMax, acquireHistogram(), m_isDistribCounted);
 
             m_isDistribCounted = true;
             m_minDistribValueL = tmpMin;
@@ -1727,7 +1707,7 @@ void Image::calcBufferDistribution(int32_t a_percent)
             int64_t tmpMin, tmpMax;
 
             getBufferDistributionMinMax<int64_t>(m_dataBuffer, m_width*m_height*bpx, percent,
-                                                 m_minValueL, m_maxValueL, tmpMin, tmpMax, m_distribStats, m_isDistribCounted);
+                                                 m_minValueL, m_maxValueL, tmpMin, tmpMax, acquireHistogram(), m_isDistribCounted);
 
             m_isDistribCounted = true;
             m_minDistribValueL = tmpMin;
@@ -1764,6 +1744,197 @@ void Image::resetDistribValues()
     m_finalMaxValueL = m_maxDistribValueL = m_maxValueL = std::numeric_limits<int64_t>::max();
 }
 
+// Sets the clipped min/max to the pixels of the m_percentThreshold percentiles, the last selection is reused
+// for the same percentile and method, e.g. when only the stretch changes
+int32_t Image::selectPercentileMinMax(uint32_t a_method)
+{
+    size_t size = m_width * m_height * (std::abs(m_bitpix) / 8);
+
+    if (m_dataBuffer == nullptr || m_baseOffset + size > m_maxDataBufferSize)
+        return FITS_GENERAL_ERROR;
+
+    if (m_selectedPercentileMethod != a_method || !areEqual(m_selectedPercent, m_percentThreshold))
+    {
+        int32_t retVal = FITS_GENERAL_ERROR;
+
+        auto select = [&](auto a_sample)
+        {
+            typedef decltype(a_sample) T;
+
+            T newMin = 0, newMax = 0;
+
+            retVal = getBufferPercentileMinMax<T>(m_dataBuffer, size, m_percentThreshold, a_method, newMin, newMax,
+                                                  m_isBlankDefined, m_blankValue);
+
+            m_selectedMinValue = m_selectedMinValueL = newMin;
+            m_selectedMaxValue = m_selectedMaxValueL = newMax;
+        };
+
+        switch (m_bitpix)
+        {
+            case 8:
+                select(uint8_t());
+                break;
+            case 16:
+                select(int16_t());
+                break;
+            case 32:
+                select(int32_t());
+                break;
+            case 64:
+                select(int64_t());
+                break;
+            case -32:
+                select(float());
+                break;
+            case -64:
+                select(double());
+                break;
+        }
+
+        if (retVal != FITS_GENERAL_SUCCESS)
+        {
+            m_selectedPercent = -1.0f;
+
+            return retVal;
+        }
+
+        m_selectedPercent = m_percentThreshold;
+        m_selectedPercentileMethod = a_method;
+    }
+
+    m_finalClippedMinValue = m_selectedMinValue;
+    m_finalClippedMaxValue = m_selectedMaxValue;
+    m_finalClippedMinValueL = m_selectedMinValueL;
+    m_finalClippedMaxValueL = m_selectedMaxValueL;
+
+    /// the same corner case as in calcPercentileMinMax(), e.g. most of the pixels have the same value
+    if (m_bitpix < 0 ? areEqualFloatDouble(m_selectedMinValue, m_selectedMaxValue) : m_selectedMinValueL == m_selectedMaxValueL)
+    {
+        m_finalClippedMinValue = m_finalMinValue;
+        m_finalClippedMaxValue = m_finalMaxValue;
+        m_finalClippedMinValueL = m_finalMinValueL;
+        m_finalClippedMaxValueL = m_finalMaxValueL;
+    }
+
+    return FITS_GENERAL_SUCCESS;
+}
+
+renderKernelPtr Image::prepareRenderKernel(RenderParams& a_params, std::vector<uint32_t>& a_lut, bool a_fromSamplePlane)
+{
+    bool a_zeroScaleFlag = !(areEqual(m_bzero, FITS_BZERO_DEFAULT_VALUE) && areEqual(m_bscale, FITS_BSCALE_DEFAULT_VALUE));
+
+    switch (m_bitpix)
+    {
+        case 8:
+        case 16:
+            initRenderParams<int16_t>(a_params, (int16_t)m_finalClippedMinValueL, (int16_t)m_finalClippedMaxValueL,
+                                      m_bzero, m_bscale, a_zeroScaleFlag, m_transformType);
+            break;
+        case -32:
+            initRenderParams<float>(a_params, (float)m_finalClippedMinValue, (float)m_finalClippedMaxValue,
+                                    m_bzero, m_bscale, a_zeroScaleFlag, m_transformType);
+            break;
+        case 32:
+            initRenderParams<int32_t>(a_params, (int32_t)m_finalClippedMinValueL, (int32_t)m_finalClippedMaxValueL,
+                                      m_bzero, m_bscale, a_zeroScaleFlag, m_transformType);
+            break;
+        case -64:
+            initRenderParams<double>(a_params, m_finalClippedMinValue, m_finalClippedMaxValue,
+                                     m_bzero, m_bscale, a_zeroScaleFlag, m_transformType);
+            break;
+        case 64:
+            initRenderParams<int64_t>(a_params, m_finalClippedMinValueL, m_finalClippedMaxValueL,
+                                      m_bzero, m_bscale, a_zeroScaleFlag, m_transformType);
+            break;
+        default:
+            return nullptr;
+    }
+
+    /// the decoded samples have BZERO/BSCALE applied already, min/max/range above include them as well
+    if (a_fromSamplePlane)
+        return selectPlaneRenderKernel(m_bitpix, m_transformType);
+
+    renderKernelPtr kernel = selectRenderKernel(m_bitpix, m_transformType, a_zeroScaleFlag, true);
+
+    /// 8 and 16-bit images are rendered through a table of all the sample values if it's smaller than the image
+    if ((m_bitpix == 8 || m_bitpix == 16) && (size_t)m_width * m_height >= ((size_t)1 << m_bitpix))
+        kernel = selectRenderLutKernel(m_bitpix, kernel, a_params, a_lut);
+
+    return kernel;
+}
+
+// The decoded samples of the image. The first render goes straight from the payload, the samples are decoded by row bands
+// and cached when the image is rendered again. nullptr is returned if the caching is off, the image wasn't rendered yet,
+// BITPIX has no sample plane or the plane doesn't fit into the cache budget.
+std::shared_ptr<const SamplePlane> Image::acquireSamplePlane(size_t a_rowSize, size_t a_rowSamples)
+{
+#ifdef ENABLE_SAMPLE_PLANE_CACHE
+    size_t elementSize = getSamplePlaneElementSize(m_bitpix);
+
+    if (!m_isSamplePlaneCaching || elementSize == 0 || m_dataBuffer == nullptr)
+        return nullptr;
+
+    SamplePlaneCache& cache = SamplePlaneCache::getInstance();
+    std::shared_ptr<const SamplePlane> plane = cache.find(this);
+
+    if (plane != nullptr && plane->source == m_dataBuffer && plane->bitpix == m_bitpix &&
+        plane->width == m_width && plane->height == m_height && plane->bzero == m_bzero && plane->bscale == m_bscale)
+        return plane;
+
+    if (!m_isRendered)
+        return nullptr;
+
+    size_t planeRowSize = a_rowSamples * elementSize;
+    size_t planeSize = planeRowSize * m_height;
+
+    if (planeSize > cache.getBudget())
+    {
+        cache.remove(this);
+
+        return nullptr;
+    }
+
+    std::shared_ptr<SamplePlane> newPlane = std::make_shared<SamplePlane>();
+
+    newPlane->source = m_dataBuffer;
+    newPlane->bitpix = m_bitpix;
+    newPlane->width = m_width;
+    newPlane->height = m_height;
+    newPlane->bzero = m_bzero;
+    newPlane->bscale = m_bscale;
+    newPlane->size = planeSize;
+    newPlane->data.reset(new (std::nothrow) uint8_t[planeSize]);
+
+    if (newPlane->data == nullptr)
+        return nullptr;
+
+    bool zeroScaleFlag = !(areEqual(m_bzero, FITS_BZERO_DEFAULT_VALUE) && areEqual(m_bscale, FITS_BSCALE_DEFAULT_VALUE));
+
+    processRowBands(m_height, m_width, [&](size_t a_firstRow, size_t a_lastRow, std::vector<uint8_t>&)
+    {
+        for (size_t y = a_firstRow; y < a_lastRow; ++y)
+        {
+            size_t offset = y * a_rowSize;
+
+            //// the rows missing in a corrupted file are not rendered either
+            if ((m_baseOffset + offset + a_rowSize) > m_maxDataBufferSize)
+                break;
+
+            decodeSamplePlane(m_bitpix, m_dataBuffer + offset, a_rowSamples, newPlane->data.get() + y * planeRowSize,
+                              m_bzero, m_bscale, zeroScaleFlag);
+        }
+    });
+
+    cache.insert(this, newPlane);
+
+    return newPlane;
+#else
+    return nullptr;
+#endif
+}
+
+// 8 and 16-bit values are converted into tmpDestRow, the others in place (the RGB words have the size of the samples)
 void Image::convertBufferAllTypes2RGB(uint8_t* tmpRow, size_t tmpBufRowSize, uint8_t* tmpDestRow)
 {
     ///bool a_zeroScaleFlag = !(areEqualFloatDouble<long double>(m_bzero, FITS_BZERO_DEFAULT_VALUE) && areEqualFloatDouble<long double>(m_bscale, FITS_BSCALE_DEFAULT_VALUE));
@@ -1784,7 +1955,7 @@ void Image::convertBufferAllTypes2RGB(uint8_t* tmpRow, size_t tmpBufRowSize, uin
                                    m_bzero, m_bscale, a_zeroScaleFlag, m_transformType);
             break;
         case 32:
-            convertBufferInt2RGB(tmpRow, tmpBufRowSize, tmpDestRow, m_finalClippedMinValueL, m_finalClippedMaxValueL,
+            convertBufferInt2RGB(tmpRow, tmpBufRowSize, tmpRow, m_finalClippedMinValueL, m_finalClippedMaxValueL,
                                  m_bzero, m_bscale, a_zeroScaleFlag, m_transformType);
             break;
         case -64:
@@ -1792,7 +1963,7 @@ void Image::convertBufferAllTypes2RGB(uint8_t* tmpRow, size_t tmpBufRowSize, uin
                                     m_bzero, m_bscale, a_zeroScaleFlag, m_transformType);
             break;
         case 64:
-            convertBufferLong2RGB(tmpRow, tmpBufRowSize, tmpDestRow, m_finalClippedMinValueL, m_finalClippedMaxValueL,
+            convertBufferLong2RGB(tmpRow, tmpBufRowSize, tmpRow, m_finalClippedMinValueL, m_finalClippedMaxValueL,
                                   m_bzero, m_bscale, a_zeroScaleFlag, m_transformType);
             break;
         default:
@@ -1809,9 +1980,48 @@ bool Image::isDefaultBZeroBScale() const
         return true;
 }
 
+// The histogram is counted again with the new bins, the statistics are counted again for it
+void Image::setHistogramBins(size_t a_binsNumber, uint32_t a_spacing)
+{
+    m_histogramBinsNumber = a_binsNumber;
+    m_histogramSpacing = a_spacing;
+
+    m_histogram.reset();
+
+    m_isDistribCounted = false;
+    m_isMinMaxCounted = false;
+    m_percentThreshold = -1.0f;
+}
+
+size_t Image::getHistogramBinsNumber() const
+{
+    return m_histogramBinsNumber;
+}
+
+uint32_t Image::getHistogramSpacing() const
+{
+    return m_histogramSpacing;
+}
+
+Histogram& Image::acquireHistogram()
+{
+    if (!m_histogram)
+    {
+        m_histogram = std::make_unique<Histogram>(m_histogramBinsNumber, m_histogramSpacing);
+        m_isDistribCounted = false;
+    }
+
+    return *m_histogram;
+}
+
 DistribStats const* Image::getDistribStats() const
 {
-    return m_distribStats;
+    return m_histogram ? m_histogram->getBins() : nullptr;
+}
+
+Histogram const* Image::getHistogram() const
+{
+    return m_histogram.get();
 }
 
 //// these functions are for debugging purposes only, they are slow
@@ -3,9 +3,12 @@
 
 #include <cstdint>
 #include <string>
+#include <memory>
 
 #include "defs.h"
 #include "helperfunctions.h"
+#include "histogram.h"
+#include "sampleplanecache.h"
 
 #define MIN_RGB_CHANNEL_CHANGE_FACTOR       (0.0)
 #define MAX_RGB_CHANNEL_CHANGE_FACTOR       (2.0)
@@ -36,23 +39,57 @@ struct ImageColorStats
     uint8_t     maxB;
 };
 
+/// The statistics calcBufferStats() counts, they are counted apart from the image and set by setStats()
+struct ImageStats
+{
+    double          minValue;
+    double          maxValue;
+    int64_t         minValueL;
+    int64_t         maxValueL;
+    size_t          invalidPixelsCount;
+    bool            isApproximate;      /// counted from a sample of the pixels
+
+    Histogram       histogram;
+};
+
+/// Everything createRGB32FlatData() renders the pixels with. The adjustments are applied to the rendered pixels in this
+/// order: the channel levels, grayscale or the eye comfort colors, the brightness filter. The image is never changed in
+/// place, so an adjustment is undone by rendering the image again without it.
+struct ImageRenderSettings
+{
+    uint32_t        transformType = FITS_FLOAT_DOUBLE_NO_TRANSFORM;    /// the stretch
+    float           percent = 0.0f;                                     /// the clipping, as createRGB32FlatData() takes it
+    uint32_t        percentileMethod = FITS_PERCENTILE_METHOD_EXACT;
+    float           levels[3] = { 1.0f, 1.0f, 1.0f };                   /// factors of the channels 0, 1 and 2 as in change32FlatLevels()
+    bool            grayscale = false;
+    bool            eyeComfort = false;                                 /// not applied to the grayscale pixels
+    uint8_t         brightnessThreshold = 0;                            /// the darker pixels are black, 0 is off
+
+    bool operator == (const ImageRenderSettings& a_settings) const = default;
+};
+
 class Image
 {
 private:
     bool                m_isCompressed;
     bool                m_isMinMaxCounted;
     bool                m_isDistribCounted;
+    bool                m_isSamplePlaneCaching;     /// the decoded samples are kept in SamplePlaneCache for re-rendering
+    bool                m_isRendered;               /// rendered from the payload once, the samples are decoded on the next render
+    bool                m_isBlankDefined;           /// the BLANK keyword value marks undefined pixels of the integer BITPIX
+    int64_t             m_blankValue;
+    size_t              m_invalidPixelsCount;       /// NaN, infinite or BLANK pixels skipped by calcBufferMinMax()
+    bool                m_isStatsApproximate;       /// min/max and the distribution are the quick look ones
+    float               m_selectedPercent;          /// the percentile the selected min/max below were found for, -1 if none
+    uint32_t            m_selectedPercentileMethod;
+    double              m_selectedMinValue, m_selectedMaxValue;
+    int64_t             m_selectedMinValueL, m_selectedMaxValueL;
 
     uint8_t*            m_dataBuffer;
 
     uint8_t**           m_rgbDataBuffer;
-    uint8_t**           m_rgbDataBackupBuffer;
-
     uint8_t**           m_rgb32DataBuffer;
-    uint8_t**           m_rgb32DataBackupBuffer;
-
     uint8_t*            m_rgb32FlatDataBuffer;
-    uint8_t*            m_rgb32FlatDataBackupBuffer;
 
     uint32_t            m_width;
     uint32_t            m_height;
@@ -69,6 +106,7 @@ private:
 
     uint32_t            m_transformType;
     float               m_percentThreshold;
+    ImageRenderSettings m_renderSettings;       /// the ones of the last createRGB32FlatData() call
     size_t              m_maxDataBufferSize;
     size_t              m_baseOffset;
     std::string         m_title;
@@ -78,7 +116,9 @@ private:
 
     ImageColorStats     m_colorStats;
 
-    DistribStats        m_distribStats[FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER];
+    std::unique_ptr<Histogram>  m_histogram;    /// allocated when the statistics are counted
+    size_t              m_histogramBinsNumber;
+    uint32_t            m_histogramSpacing;
 
 private:
     int32_t _changeRGBColorChannelLevel(uint8_t a_channel, float a_quatient);
@@ -93,9 +133,15 @@ private:
                                uint8_t& a_newRed, uint8_t& a_newGreen, uint8_t& a_newBlue);
     void _convertBufferRGB32Flat2EyeComfortColors();
 
+    bool getColorKernelParams(ColorKernelParams& a_params) const;
+
     void resetDistribValues();
+    Histogram& acquireHistogram();
 
     void convertBufferAllTypes2RGB(uint8_t* tmpRow, size_t tmpBufRowSize, uint8_t* tmpDestRow);
+    renderKernelPtr prepareRenderKernel(RenderParams& a_params, std::vector<uint32_t>& a_lut, bool a_fromSamplePlane);
+    std::shared_ptr<const SamplePlane> acquireSamplePlane(size_t a_rowSize, size_t a_rowSamples);
+    int32_t selectPercentileMinMax(uint32_t a_method);
 
 public:
     Image();
@@ -123,6 +169,9 @@ public:
     void setData(const uint8_t* a_dataBuffer);
     uint8_t* getData() const;
 
+    void setSamplePlaneCaching(bool a_flag = true);
+    bool isSamplePlaneCaching() const;
+
     void setCallbackFunction(CallbackFunctionPtr a_callbackFunc, void* a_callbackFuncParam);
     int32_t exportPNG(const std::string& a_fileName, int32_t a_transform = FITS_FLOAT_DOUBLE_NO_TRANSFORM, bool a_gray = false);
 
@@ -136,8 +185,11 @@ public:
     void setRGB32Data(uint8_t** a_rgbDataBuffer);
     void copyRGB32Data(uint8_t** a_rgbDataBufferDest, uint8_t** a_rgbDataBufferSrc);
 
-    int32_t createRGB32FlatData(uint32_t a_transformType = FITS_FLOAT_DOUBLE_NO_TRANSFORM, float a_percent = 0.0);
+    int32_t createRGB32FlatData(uint32_t a_transformType = FITS_FLOAT_DOUBLE_NO_TRANSFORM, float a_percent = 0.0,
+                                uint32_t a_percentileMethod = FITS_PERCENTILE_METHOD_EXACT);
     uint8_t* getRGB32FlatData() const;
+    int32_t render(const ImageRenderSettings& a_settings);
+    const ImageRenderSettings& getRenderSettings() const;
     void setRGB32FlatData(uint8_t* a_rgbFlatDataBuffer);
     void copyRGB32FlatData(uint8_t* a_rgbFlatDataBufferDest, uint8_t* a_rgbFlatDataBufferSrc);
 
@@ -155,22 +207,14 @@ public:
     int32_t change32FlatRLevel(float a_quatient);
     int32_t change32FlatGLevel(float a_quatient);
     int32_t change32FlatBLevel(float a_quatient);
+    int32_t change32FlatLevels(float a_rQuatient, float a_gQuatient, float a_bQuatient);
     int32_t convertRGB32Flat2Grayscale();
     int32_t convertRGB32Flat2EyeComfortColors();
 
-    void backupRGBData();
-    void backupRGB32Data();
-    void backupRGB32FlatData();
-
-    void restoreRGBData();
-    void restoreGB32Data();
-    void restoreRGB32FlatData();
-
     void deleteRGBData();
     void deleteRGB32Data();
     void deleteRGB32FlatData();
     void deleteAllRGBData();
-    void deleteAllBackupRGBData();
     void deleteAllData();
 
     void normalize(float a_min, float a_max, float a_minNew, float a_maxNew);
@@ -229,10 +273,24 @@ public:
     uint32_t getTransformType() const;
 
     template<typename T> void calcBufferMinMax();
+    template<typename T> void calcBufferQuickStats(size_t a_samplePixels = FITS_QUICK_LOOK_SAMPLE_PIXELS);
+    template<typename T> int32_t calcBufferStats(ImageStats& a_stats, size_t a_samplePixels = 0) const;
+    void setStats(const ImageStats& a_stats);
+    int32_t getStats(ImageStats& a_stats) const;
+    bool isStatsApproximate() const;
+
+    void setBlankValue(int64_t a_blankValue);
+    bool isBlankDefined() const;
+    int64_t getBlankValue() const;
+    size_t getInvalidPixelsCount() const;
 
     bool isDefaultBZeroBScale() const;
 
+    void setHistogramBins(size_t a_binsNumber, uint32_t a_spacing = FITS_HISTOGRAM_SPACING_LINEAR);
+    size_t getHistogramBinsNumber() const;
+    uint32_t getHistogramSpacing() const;
     DistribStats const* getDistribStats() const;
+    Histogram const* getHistogram() const;
 
     //// thiese functions are for debugging purposes only, they are slow
     int32_t dumpFloatDataBuffer(const std::string& a_filename, uint32_t a_rowSize);
@@ -0,0 +1,153 @@
+#include "pixelkernels.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace libnfits
+{
+
+#ifdef LIBNFITS_HAVE_X86_PIXEL_KERNELS
+// The best kernels the CPU (and the OS) supports, a lower instruction set or the scalar code may be forced with
+// FITS_PIXEL_KERNELS_ENV_VARIABLE for comparisons
+static const PixelKernels* selectPixelKernels()
+{
+    const PixelKernels* supportedKernels[3] = {};
+    size_t count = 0;
+
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512dq"))
+        supportedKernels[count++] = getPixelKernelsAVX512();
+
+    if (__builtin_cpu_supports("avx2"))
+        supportedKernels[count++] = getPixelKernelsAVX2();
+
+    if (__builtin_cpu_supports("sse4.2"))
+        supportedKernels[count++] = getPixelKernelsSSE42();
+
+    const char* kernelsName = std::getenv(FITS_PIXEL_KERNELS_ENV_VARIABLE);
+
+    if (kernelsName != nullptr)
+    {
+        if (std::strcmp(kernelsName, FITS_PIXEL_KERNELS_SCALAR) == 0)
+            return nullptr;
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (std::strcmp(kernelsName, supportedKernels[i]->name) == 0)
+                return supportedKernels[i];
+        }
+    }
+
+    return count > 0 ? supportedKernels[0] : nullptr;
+}
+#endif
+
+const PixelKernels* getPixelKernels()
+{
+#ifdef LIBNFITS_HAVE_X86_PIXEL_KERNELS
+    static const PixelKernels* kernels = selectPixelKernels();
+
+    return kernels;
+#else
+    return nullptr;
+#endif
+}
+
+// Runs the kernel for a_bitpix and returns the number of converted pixels, 0 if the scalar code has to convert all of them.
+// Only the linear and square root stretches are vectorized, logarithm and arcsinh are left to the scalar code.
+size_t convertPixelsVectorized(int32_t a_bitpix, const uint8_t* a_src, uint8_t* a_dest, size_t a_count,
+                               long double a_min, long double a_max, long double a_range,
+                               long double a_bzero, long double a_bscale, bool a_zeroScaleFlag, uint32_t a_type,
+                               bool a_bBGRA, bool a_bNativeEndian)
+{
+    const PixelKernels* kernels = getPixelKernels();
+
+    uint32_t stretchIndex = a_type & FITS_PERCENTILE_TRANSFORM_AND_QUATIENT;
+
+    if (kernels == nullptr ||
+        (stretchIndex != FITS_STRETCHING_LINEAR_TRANSFORM && stretchIndex != FITS_STRETCHING_SQUARE_ROOT_TRANSFORM))
+        return 0;
+
+    PixelKernelParams params;
+
+    params.min = (double)a_min;
+    params.max = (double)a_max;
+    params.range = (double)a_range;
+    params.bzero = (double)a_bzero;
+    params.bscale = (double)a_bscale;
+    params.bZeroScale = a_zeroScaleFlag;
+    params.bClip = (a_type & FITS_PERCENTILE_TRANSFORM) != 0;
+    params.bSquareRoot = stretchIndex == FITS_STRETCHING_SQUARE_ROOT_TRANSFORM;
+    params.bBGRA = a_bBGRA;
+    params.bNativeEndian = a_bNativeEndian;
+
+    switch (a_bitpix)
+    {
+        case 8:
+            return kernels->byteKernel(a_src, a_dest, a_count, params);
+        case 16:
+            return kernels->shortKernel(a_src, a_dest, a_count, params);
+        case 32:
+            return kernels->intKernel(a_src, a_dest, a_count, params);
+        case 64:
+            return kernels->longKernel(a_src, a_dest, a_count, params);
+        case -32:
+            return kernels->floatKernel(a_src, a_dest, a_count, params);
+        case -64:
+            return kernels->doubleKernel(a_src, a_dest, a_count, params);
+        default:
+            return 0;
+    }
+}
+
+// Runs the min/max kernel for a_bitpix and returns the number of processed samples, 0 if the scalar code has to process all of them
+size_t calcMinMaxVectorized(int32_t a_bitpix, const uint8_t* a_src, size_t a_count, const MinMaxKernelParams& a_params,
+                            MinMaxKernelResult& a_result)
+{
+    const PixelKernels* kernels = getPixelKernels();
+
+    if (kernels == nullptr)
+        return 0;
+
+    switch (a_bitpix)
+    {
+        case 8:
+            return kernels->byteMinMaxKernel(a_src, a_count, a_params, a_result);
+        case 16:
+            return kernels->shortMinMaxKernel(a_src, a_count, a_params, a_result);
+        case 32:
+            return kernels->intMinMaxKernel(a_src, a_count, a_params, a_result);
+        case 64:
+            return kernels->longMinMaxKernel(a_src, a_count, a_params, a_result);
+        case -32:
+            return kernels->floatMinMaxKernel(a_src, a_count, a_params, a_result);
+        case -64:
+            return kernels->doubleMinMaxKernel(a_src, a_count, a_params, a_result);
+        default:
+            return 0;
+    }
+}
+
+// Runs the color kernel and returns the number of adjusted pixels, 0 if the scalar code has to adjust all of them
+size_t adjustColorsVectorized(uint32_t* a_pixels, size_t a_count, const ColorKernelParams& a_params)
+{
+    const PixelKernels* kernels = getPixelKernels();
+
+    if (kernels == nullptr)
+        return 0;
+
+    return kernels->colorKernel(a_pixels, a_count, a_params);
+}
+
+size_t calcColorStatsVectorized(const uint32_t* a_pixels, size_t a_count, ColorKernelResult& a_result)
+{
+    const PixelKernels* kernels = getPixelKernels();
+
+    if (kernels == nullptr)
+        return 0;
+
+    return kernels->colorStatsKernel(a_pixels, a_count, a_result);
+}
+
+}
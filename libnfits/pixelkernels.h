@@ -0,0 +1,127 @@
+#ifndef LIBNFITS_PIXELKERNELS_H
+#define LIBNFITS_PIXELKERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "defs.h"
+
+// the vector kernels are built with the GCC vector extensions for x86 only, other targets use the scalar code
+#if defined(ENABLE_SIMD_PIXEL_KERNELS) && defined(__GNUC__) && !defined(__clang__) && (defined(__x86_64__) || defined(__i386__))
+#define LIBNFITS_HAVE_X86_PIXEL_KERNELS
+#endif
+
+namespace libnfits
+{
+
+// Grayscale conversion parameters, the same values the scalar code in helperfunctions.cpp uses
+struct PixelKernelParams
+{
+    double  min;            /// after BZERO/BSCALE and the stretch
+    double  max;
+    double  range;
+    double  bzero;
+    double  bscale;
+    bool    bZeroScale;
+    bool    bClip;          /// the percentile transform clips the values into [min, max]
+    bool    bSquareRoot;    /// square root stretch, linear otherwise
+    bool    bBGRA;          /// opaque BGRA uint32_t words for every BITPIX, for the RGB32 flat buffer
+    bool    bNativeEndian;  /// the samples are decoded already (the float and double kernels only)
+};
+
+// Converts big-endian pixels into gray 0x00RRGGBB words (uint32_t, or uint64_t for BITPIX -64 and 64) or into 0xFFRRGGBB
+// words (always uint32_t) and returns the number of converted pixels. It is a multiple of the vector width, the rest is
+// left to the scalar code. The source and the destination may be the same buffer.
+typedef size_t (*PixelKernelPtr)(const uint8_t* a_src, uint8_t* a_dest, size_t a_count, const PixelKernelParams& a_params);
+
+// Min/max reduction of the valid samples: the float and double kernels skip NaN and infinite values, the integer ones
+// skip the BLANK value if it's defined
+struct MinMaxKernelParams
+{
+    int64_t blank;
+    bool    bBlank;
+};
+
+// The kernels merge their min/max into the values found so far, the min/max stay untouched if there are no valid samples
+struct MinMaxKernelResult
+{
+    double  minValue;       /// BITPIX -32 and -64
+    double  maxValue;
+    int64_t minValueL;      /// the integer BITPIX
+    int64_t maxValueL;
+    size_t  invalidCount;   /// NaN, infinite or BLANK samples
+};
+
+// Reduces big-endian samples and returns the number of the processed ones, a multiple of the vector width
+typedef size_t (*MinMaxKernelPtr)(const uint8_t* a_src, size_t a_count, const MinMaxKernelParams& a_params,
+                                  MinMaxKernelResult& a_result);
+
+// Adjustments of opaque BGRA words in this order: the channel levels, grayscale (the max of the channels) or the eye
+// comfort colors, the brightness filter. The bytes 0, 1 and 2 of the words are blue, green and red.
+struct ColorKernelParams
+{
+    float   levels[3];              /// factors of the bytes 0, 1 and 2 in [MIN, MAX]_RGB_CHANNEL_CHANGE_FACTOR
+    uint8_t levelTables[3][256];    /// the scaled values of the bytes, the scalar code looks them up
+    bool    bLevels;
+    bool    bGrayscale;
+    bool    bEyeComfort;            /// not applied if bGrayscale is set
+    uint8_t brightnessThreshold;    /// the darker pixels are black, 0 is off
+};
+
+// Adjusts the words in place and returns the number of adjusted ones, a multiple of the vector width
+typedef size_t (*ColorKernelPtr)(uint32_t* a_pixels, size_t a_count, const ColorKernelParams& a_params);
+
+// The kernels merge the statistics of the bytes 0, 1 and 2 of the words into the values found so far
+struct ColorKernelResult
+{
+    uint64_t    sum[3];
+    uint64_t    count[3];   /// the non-zero values
+    uint8_t     min[3];
+    uint8_t     max[3];
+};
+
+typedef size_t (*ColorStatsKernelPtr)(const uint32_t* a_pixels, size_t a_count, ColorKernelResult& a_result);
+
+struct PixelKernels
+{
+    const char*     name;
+    PixelKernelPtr  byteKernel;     /// BITPIX 8
+    PixelKernelPtr  shortKernel;    /// BITPIX 16
+    PixelKernelPtr  intKernel;      /// BITPIX 32
+    PixelKernelPtr  longKernel;     /// BITPIX 64
+    PixelKernelPtr  floatKernel;    /// BITPIX -32
+    PixelKernelPtr  doubleKernel;   /// BITPIX -64
+    MinMaxKernelPtr byteMinMaxKernel;
+    MinMaxKernelPtr shortMinMaxKernel;
+    MinMaxKernelPtr intMinMaxKernel;
+    MinMaxKernelPtr longMinMaxKernel;
+    MinMaxKernelPtr floatMinMaxKernel;
+    MinMaxKernelPtr doubleMinMaxKernel;
+    ColorKernelPtr  colorKernel;
+    ColorStatsKernelPtr colorStatsKernel;
+};
+
+// The kernels of the best instruction set supported by the CPU, nullptr if only the scalar code can be used
+const PixelKernels* getPixelKernels();
+
+size_t convertPixelsVectorized(int32_t a_bitpix, const uint8_t* a_src, uint8_t* a_dest, size_t a_count,
+                               long double a_min, long double a_max, long double a_range,
+                               long double a_bzero, long double a_bscale, bool a_zeroScaleFlag, uint32_t a_type,
+                               bool a_bBGRA = false, bool a_bNativeEndian = false);
+
+size_t calcMinMaxVectorized(int32_t a_bitpix, const uint8_t* a_src, size_t a_count, const MinMaxKernelParams& a_params,
+                            MinMaxKernelResult& a_result);
+
+size_t adjustColorsVectorized(uint32_t* a_pixels, size_t a_count, const ColorKernelParams& a_params);
+
+size_t calcColorStatsVectorized(const uint32_t* a_pixels, size_t a_count, ColorKernelResult& a_result);
+
+#ifdef LIBNFITS_HAVE_X86_PIXEL_KERNELS
+const PixelKernels* getPixelKernelsSSE42();
+const PixelKernels* getPixelKernelsAVX2();
+const PixelKernels* getPixelKernelsAVX512();
+#endif
+
+}
+
+#endif // LIBNFITS_PIXELKERNELS_H
@@ -0,0 +1,536 @@
+#ifndef LIBNFITS_PIXELKERNELS_IMPL_H
+#define LIBNFITS_PIXELKERNELS_IMPL_H
+
+// Pixel conversion kernels written once with the GCC vector extensions. Every pixelkernels_*.cpp file includes this
+// after selecting its instruction set with #pragma GCC target, the anonymous namespace keeps the copies apart.
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+#include <immintrin.h>
+
+#include "pixelkernels.h"
+
+namespace libnfits
+{
+namespace
+{
+
+// N is the vector size in bytes, the float and double kernels convert N/4 and N/8 pixels per step
+template<size_t N> struct PixelVectors
+{
+    typedef float       Float       __attribute__((vector_size(N)));
+    typedef int32_t     Int32       __attribute__((vector_size(N)));
+    typedef uint32_t    UInt32      __attribute__((vector_size(N)));
+    typedef double      Double      __attribute__((vector_size(N)));
+    typedef int64_t     Int64       __attribute__((vector_size(N)));
+    typedef uint64_t    UInt64      __attribute__((vector_size(N)));
+    typedef uint8_t     Bytes       __attribute__((vector_size(N)));
+    typedef uint8_t     HalfBytes   __attribute__((vector_size(N / 2)));
+    typedef int16_t     HalfInt16   __attribute__((vector_size(N / 2)));
+    typedef int32_t     HalfInt32   __attribute__((vector_size(N / 2)));
+    typedef uint32_t    HalfUInt32  __attribute__((vector_size(N / 2)));
+    typedef uint8_t     QuarterBytes __attribute__((vector_size(N / 4)));
+};
+
+// Kernel constants converted once to the precision of the kernel
+template<typename T> struct PixelKernelConstants
+{
+    T       min;
+    T       max;
+    T       range;
+    T       bzero;
+    T       bscale;
+    T       epsilon;
+    bool    bZeroScale;
+    bool    bClip;
+    bool    bSquareRoot;
+    uint32_t alpha;
+
+    explicit PixelKernelConstants(const PixelKernelParams& a_params):
+        min((T)a_params.min), max((T)a_params.max), range((T)a_params.range),
+        bzero((T)a_params.bzero), bscale((T)a_params.bscale), epsilon(std::numeric_limits<T>::epsilon()),
+        bZeroScale(a_params.bZeroScale), bClip(a_params.bClip), bSquareRoot(a_params.bSquareRoot),
+        alpha(a_params.bBGRA ? 0xFF000000 : 0)
+    {
+
+    }
+};
+
+template<typename V> inline V loadVector(const uint8_t* a_src)
+{
+    V v;
+    std::memcpy(&v, a_src, sizeof(V));
+
+    return v;
+}
+
+template<typename V> inline void storeVector(uint8_t* a_dest, V a_value)
+{
+    std::memcpy(a_dest, &a_value, sizeof(V));
+}
+
+// Reverses the bytes of every a_elementSize bytes long element with one byte shuffle (pshufb)
+template<typename V, size_t a_elementSize> inline V swapBytes(V a_bytes)
+{
+    V mask;
+
+    for (size_t i = 0; i < sizeof(V); ++i)
+        mask[i] = (uint8_t)((i / a_elementSize) * a_elementSize + a_elementSize - 1 - i % a_elementSize);
+
+    return __builtin_shuffle(a_bytes, mask);
+}
+
+template<typename V> inline V sqrtVector(V a_value)
+{
+    if constexpr (sizeof(a_value[0]) == sizeof(float))
+    {
+        if constexpr (sizeof(V) == 16)
+            return (V)_mm_sqrt_ps((__m128)a_value);
+        else if constexpr (sizeof(V) == 32)
+            return (V)_mm256_sqrt_ps((__m256)a_value);
+        else    // the zero masked form avoids the false uninitialized warning of _mm512_sqrt_ps() in GCC 12
+            return (V)_mm512_maskz_sqrt_ps((__mmask16)0xFFFF, (__m512)a_value);
+    }
+    else
+    {
+        if constexpr (sizeof(V) == 16)
+            return (V)_mm_sqrt_pd((__m128d)a_value);
+        else if constexpr (sizeof(V) == 32)
+            return (V)_mm256_sqrt_pd((__m256d)a_value);
+        else
+            return (V)_mm512_maskz_sqrt_pd((__mmask8)0xFF, (__m512d)a_value);
+    }
+}
+
+// BZERO/BSCALE, stretch, clipping and the gray level (0..255) as the scalar convertFloat2Grayscale() computes it.
+// Non-finite values are black, as in the scalar conversion.
+template<typename V, typename T> inline V calcGrayLevels(V a_value, const PixelKernelConstants<T>& a_constants)
+{
+    const V zero = {};
+
+    if (a_constants.bZeroScale)
+        a_value = a_value * a_constants.bscale + a_constants.bzero;
+
+    if (a_constants.bSquareRoot)
+        a_value = sqrtVector(a_value > a_constants.epsilon ? a_value : zero);
+
+    if (a_constants.bClip)
+    {
+        a_value = a_value > a_constants.max ? zero + a_constants.max : a_value;
+        a_value = a_value < a_constants.min ? zero + a_constants.min : a_value;
+    }
+
+    auto isFinite = (a_value - a_value) == zero;   /// inf - inf and NaN - NaN are NaN
+
+    V level = a_value - a_constants.min;
+
+    level = level < 0 ? -level : level;
+    level = level / a_constants.range * 255;
+    level = level > 0 ? level : zero;
+    level = level < 255 ? level : zero + 255;
+
+    return isFinite ? level : zero;
+}
+
+template<size_t N> size_t convertFloatPixels(const uint8_t* a_src, uint8_t* a_dest, size_t a_count, const PixelKernelParams& a_params)
+{
+    typedef PixelVectors<N> PV;
+
+    const PixelKernelConstants<float> constants(a_params);
+    const size_t lanes = N / sizeof(float);
+    const size_t count = a_count - a_count % lanes;
+
+    for (size_t i = 0; i < count; i += lanes)
+    {
+        typename PV::Bytes bytes = loadVector<typename PV::Bytes>(a_src + i * sizeof(float));
+
+        if (!a_params.bNativeEndian)
+            bytes = swapBytes<typename PV::Bytes, sizeof(float)>(bytes);
+
+        typename PV::Float value = (typename PV::Float)bytes;
+        typename PV::UInt32 level = __builtin_convertvector(calcGrayLevels(value, constants), typename PV::UInt32);
+
+        storeVector(a_dest + i * sizeof(uint32_t), level * 0x010101 | constants.alpha);
+    }
+
+    return count;
+}
+
+template<size_t N> size_t convertShortPixels(const uint8_t* a_src, uint8_t* a_dest, size_t a_count, const PixelKernelParams& a_params)
+{
+    typedef PixelVectors<N> PV;
+
+    const PixelKernelConstants<float> constants(a_params);
+    const size_t lanes = N / sizeof(float);
+    const size_t count = a_count - a_count % lanes;
+
+    for (size_t i = 0; i < count; i += lanes)
+    {
+        typename PV::HalfInt16 raw = (typename PV::HalfInt16)swapBytes<typename PV::HalfBytes, sizeof(int16_t)>(
+                                         loadVector<typename PV::HalfBytes>(a_src + i * sizeof(int16_t)));
+        typename PV::Float value = __builtin_convertvector(raw, typename PV::Float);
+        typename PV::UInt32 level = __builtin_convertvector(calcGrayLevels(value, constants), typename PV::UInt32);
+
+        storeVector(a_dest + i * sizeof(uint32_t), level * 0x010101 | constants.alpha);
+    }
+
+    return count;
+}
+
+template<size_t N> size_t convertBytePixels(const uint8_t* a_src, uint8_t* a_dest, size_t a_count, const PixelKernelParams& a_params)
+{
+    typedef PixelVectors<N> PV;
+
+    const PixelKernelConstants<float> constants(a_params);
+    const size_t lanes = N / sizeof(float);
+    const size_t count = a_count - a_count % lanes;
+
+    for (size_t i = 0; i < count; i += lanes)
+    {
+        typename PV::Float value = __builtin_convertvector(loadVector<typename PV::QuarterBytes>(a_src + i), typename PV::Float);
+        typename PV::UInt32 level = __builtin_convertvector(calcGrayLevels(value, constants), typename PV::UInt32);
+
+        storeVector(a_dest + i * sizeof(uint32_t), level * 0x010101 | constants.alpha);
+    }
+
+    return count;
+}
+
+template<size_t N> size_t convertIntPixels(const uint8_t* a_src, uint8_t* a_dest, size_t a_count, const PixelKernelParams& a_params)
+{
+    typedef PixelVectors<N> PV;
+
+    const PixelKernelConstants<double> constants(a_params);
+    const size_t lanes = N / sizeof(double);
+    const size_t count = a_count - a_count % lanes;
+
+    for (size_t i = 0; i < count; i += lanes)
+    {
+        typename PV::HalfInt32 raw = (typename PV::HalfInt32)swapBytes<typename PV::HalfBytes, sizeof(int32_t)>(
+                                         loadVector<typename PV::HalfBytes>(a_src + i * sizeof(int32_t)));
+        typename PV::Double value = __builtin_convertvector(raw, typename PV::Double);
+        typename PV::HalfUInt32 level = __builtin_convertvector(calcGrayLevels(value, constants), typename PV::HalfUInt32);
+
+        storeVector(a_dest + i * sizeof(uint32_t), level * 0x010101 | constants.alpha);
+    }
+
+    return count;
+}
+
+template<size_t N> size_t convertDoublePixels(const uint8_t* a_src, uint8_t* a_dest, size_t a_count, const PixelKernelParams& a_params)
+{
+    typedef PixelVectors<N> PV;
+
+    const PixelKernelConstants<double> constants(a_params);
+    const size_t lanes = N / sizeof(double);
+    const size_t count = a_count - a_count % lanes;
+
+    for (size_t i = 0; i < count; i += lanes)
+    {
+        typename PV::Bytes bytes = loadVector<typename PV::Bytes>(a_src + i * sizeof(double));
+
+        if (!a_params.bNativeEndian)
+            bytes = swapBytes<typename PV::Bytes, sizeof(double)>(bytes);
+
+        typename PV::Double value = (typename PV::Double)bytes;
+        typename PV::HalfUInt32 gray = (typename PV::HalfUInt32)__builtin_convertvector(calcGrayLevels(value, constants),
+                                                                                         typename PV::HalfInt32) * 0x010101;
+
+        if (a_params.bBGRA)
+            storeVector(a_dest + i * sizeof(uint32_t), gray | constants.alpha);
+        else
+            storeVector(a_dest + i * sizeof(uint64_t), __builtin_convertvector(gray, typename PV::UInt64));
+    }
+
+    return count;
+}
+
+template<size_t N> size_t convertLongPixels(const uint8_t* a_src, uint8_t* a_dest, size_t a_count, const PixelKernelParams& a_params)
+{
+    typedef PixelVectors<N> PV;
+
+    const PixelKernelConstants<double> constants(a_params);
+    const size_t lanes = N / sizeof(double);
+    const size_t count = a_count - a_count % lanes;
+
+    for (size_t i = 0; i < count; i += lanes)
+    {
+        typename PV::Int64 raw = (typename PV::Int64)swapBytes<typename PV::Bytes, sizeof(int64_t)>(
+                                      loadVector<typename PV::Bytes>(a_src + i * sizeof(int64_t)));
+        typename PV::Double value = __builtin_convertvector(raw, typename PV::Double);
+        typename PV::HalfUInt32 gray = (typename PV::HalfUInt32)__builtin_convertvector(calcGrayLevels(value, constants),
+                                                                                         typename PV::HalfInt32) * 0x010101;
+
+        if (a_params.bBGRA)
+            storeVector(a_dest + i * sizeof(uint32_t), gray | constants.alpha);
+        else
+            storeVector(a_dest + i * sizeof(uint64_t), __builtin_convertvector(gray, typename PV::UInt64));
+    }
+
+    return count;
+}
+
+// Min/max of the valid samples of type T. The invalid lanes are counted in the lanes of the comparison masks,
+// the counters are summed up after every block before they may overflow.
+template<size_t N, typename T, bool a_blank> size_t calcSamplesMinMax(const uint8_t* a_src, size_t a_count,
+                                                                      const MinMaxKernelParams& a_params, MinMaxKernelResult& a_result)
+{
+    typedef T Vector __attribute__((vector_size(N)));
+    typedef std::conditional_t<sizeof(T) == 1, int8_t, std::conditional_t<sizeof(T) == 2, int16_t,
+            std::conditional_t<sizeof(T) == 4, int32_t, int64_t>>> MaskLane;
+    typedef MaskLane Mask __attribute__((vector_size(N)));
+    typedef typename PixelVectors<N>::Bytes Bytes;
+
+    constexpr bool isFloat = std::is_floating_point_v<T>;
+
+    const size_t lanes = N / sizeof(T);
+    const size_t count = a_count - a_count % lanes;
+    const size_t blockSize = std::min<size_t>(std::numeric_limits<MaskLane>::max(), 1 << 14) * lanes;
+    const T limit = std::numeric_limits<T>::max();
+    const T blank = (T)a_params.blank;
+    const Vector zero = {};
+
+    Vector minV = zero + (isFloat ? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max());
+    Vector maxV = zero + (isFloat ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::lowest());
+    size_t invalidCount = 0;
+
+    for (size_t block = 0; block < count; block += blockSize)
+    {
+        const size_t blockEnd = std::min(block + blockSize, count);
+        Mask invalid = {};
+
+        for (size_t i = block; i < blockEnd; i += lanes)
+        {
+            Bytes bytes = loadVector<Bytes>(a_src + i * sizeof(T));
+
+            if constexpr (sizeof(T) > 1)
+                bytes = swapBytes<Bytes, sizeof(T)>(bytes);
+
+            Vector value = (Vector)bytes;
+
+            if constexpr (isFloat || a_blank)
+            {
+                Mask valid;
+
+                if constexpr (isFloat)  /// NaN fails both comparisons
+                    valid = (Mask)((value >= -limit) & (value <= limit));
+                else
+                    valid = (Mask)(value != blank);
+
+                minV = (valid & (Mask)(value < minV)) ? value : minV;
+                maxV = (valid & (Mask)(value > maxV)) ? value : maxV;
+                invalid += valid + 1;
+            }
+            else
+            {
+                minV = value < minV ? value : minV;
+                maxV = value > maxV ? value : maxV;
+            }
+        }
+
+        for (size_t i = 0; i < lanes; ++i)
+            invalidCount += (size_t)invalid[i];
+    }
+
+    for (size_t i = 0; i < lanes; ++i)
+    {
+        if constexpr (isFloat)
+        {
+            a_result.minValue = std::min(a_result.minValue, (double)minV[i]);
+            a_result.maxValue = std::max(a_result.maxValue, (double)maxV[i]);
+        }
+        else
+        {
+            a_result.minValueL = std::min(a_result.minValueL, (int64_t)minV[i]);
+            a_result.maxValueL = std::max(a_result.maxValueL, (int64_t)maxV[i]);
+        }
+    }
+
+    a_result.invalidCount += invalidCount;
+
+    return count;
+}
+
+template<size_t N, typename T> size_t calcMinMax(const uint8_t* a_src, size_t a_count, const MinMaxKernelParams& a_params,
+                                                 MinMaxKernelResult& a_result)
+{
+    if (a_params.bBlank)
+        return calcSamplesMinMax<N, T, true>(a_src, a_count, a_params, a_result);
+
+    return calcSamplesMinMax<N, T, false>(a_src, a_count, a_params, a_result);
+}
+
+// x / 255 for x in [0, 65535] with a multiplication
+template<typename V> inline V divideBy255(V a_value)
+{
+    return (a_value * 0x8081) >> 23;
+}
+
+// The integer arithmetic of adjustRGB32FlatPixels(), the words are split into the channels of 32-bit lanes and every
+// adjustment is a select, so there are no branches per pixel
+template<size_t N> size_t adjustColors(uint32_t* a_pixels, size_t a_count, const ColorKernelParams& a_params)
+{
+    typedef typename PixelVectors<N>::UInt32 UInt32;
+    typedef typename PixelVectors<N>::Int32 Int32;
+    typedef typename PixelVectors<N>::Float Float;
+
+    const size_t lanes = N / sizeof(uint32_t);
+    const size_t count = a_count - a_count % lanes;
+    const UInt32 zero = {};
+    const UInt32 max = zero + 0xff;
+    const UInt32 darkLimit = zero + (uint32_t)a_params.brightnessThreshold * 1000;
+
+    for (size_t i = 0; i < count; i += lanes)
+    {
+        uint8_t* pixels = reinterpret_cast<uint8_t*>(a_pixels + i);
+        UInt32 pixel = loadVector<UInt32>(pixels);
+
+        UInt32 alpha = pixel & 0xff000000;
+        UInt32 blue = pixel & 0xff;
+        UInt32 green = (pixel >> 8) & 0xff;
+        UInt32 red = (pixel >> 16) & 0xff;
+
+        if (a_params.bLevels)
+        {
+            blue = (UInt32)__builtin_convertvector(__builtin_convertvector((Int32)blue, Float) * a_params.levels[0], Int32);
+            green = (UInt32)__builtin_convertvector(__builtin_convertvector((Int32)green, Float) * a_params.levels[1], Int32);
+            red = (UInt32)__builtin_convertvector(__builtin_convertvector((Int32)red, Float) * a_params.levels[2], Int32);
+
+            blue = blue < max ? blue : max;
+            green = green < max ? green : max;
+            red = red < max ? red : max;
+        }
+
+        if (a_params.bGrayscale)
+        {
+            UInt32 gray = red > green ? red : green;
+
+            gray = gray > blue ? gray : blue;
+            red = green = blue = gray;
+        }
+        else if (a_params.bEyeComfort)
+        {
+            UInt32 bright = (UInt32)((red >= 0x7f) | (green >= 0x7f) | (blue >= 0x7f));
+            UInt32 blueTop = bright & (UInt32)((blue > red) & (blue > green));
+            UInt32 greenTop = bright & (UInt32)((green > blue) & (green > red));
+            UInt32 redTop = bright & (UInt32)((red > blue) & (red > green));
+
+            UInt32 newRed = blueTop ? zero + 0x7f : (greenTop ? max : (redTop ? max - blue : red));
+            UInt32 newGreen = blueTop ? divideBy255(65025 - 153 * blue) >> 1 :
+                                        (greenTop ? divideBy255(61200 - 138 * blue) : (redTop ? max : green));
+            UInt32 newBlue = blueTop ? (max - blue) >> 1 :
+                                       (greenTop ? max - blue : (redTop ? divideBy255(61200 - 138 * green) : blue));
+
+            red = newRed;
+            green = newGreen;
+            blue = newBlue;
+            alpha = zero + 0xff000000;
+        }
+
+        if (a_params.brightnessThreshold != 0)
+        {
+            UInt32 dark = (UInt32)(red * 299 + green * 587 + blue * 114 + 500 < darkLimit);
+
+            red = dark ? zero : red;
+            green = dark ? zero : green;
+            blue = dark ? zero : blue;
+        }
+
+        storeVector(pixels, alpha | (red << 16) | (green << 8) | blue);
+    }
+
+    return count;
+}
+
+// Sums, non-zero counts and min/max of the channels in 32-bit lanes, the sums are added up after every block before
+// they may overflow
+template<size_t N> size_t calcColorStats(const uint32_t* a_pixels, size_t a_count, ColorKernelResult& a_result)
+{
+    typedef typename PixelVectors<N>::UInt32 UInt32;
+
+    const size_t lanes = N / sizeof(uint32_t);
+    const size_t count = a_count - a_count % lanes;
+    const size_t blockSize = ((size_t)1 << 16) * lanes;
+    const UInt32 zero = {};
+
+    UInt32 minV[3], maxV[3];
+
+    for (size_t channel = 0; channel < 3; ++channel)
+    {
+        minV[channel] = zero + 0xff;
+        maxV[channel] = zero;
+    }
+
+    for (size_t block = 0; block < count; block += blockSize)
+    {
+        const size_t blockEnd = std::min(block + blockSize, count);
+        UInt32 sum[3] = {}, nonZero[3] = {};
+
+        for (size_t i = block; i < blockEnd; i += lanes)
+        {
+            UInt32 pixel = loadVector<UInt32>(reinterpret_cast<const uint8_t*>(a_pixels + i));
+
+            for (size_t channel = 0; channel < 3; ++channel)
+            {
+                UInt32 value = (pixel >> (channel * 8)) & 0xff;
+
+                sum[channel] += value;
+                nonZero[channel] -= (UInt32)(value != 0);
+                minV[channel] = value < minV[channel] ? value : minV[channel];
+                maxV[channel] = value > maxV[channel] ? value : maxV[channel];
+            }
+        }
+
+        for (size_t channel = 0; channel < 3; ++channel)
+        {
+            for (size_t i = 0; i < lanes; ++i)
+            {
+                a_result.sum[channel] += sum[channel][i];
+                a_result.count[channel] += nonZero[channel][i];
+            }
+        }
+    }
+
+    for (size_t channel = 0; channel < 3; ++channel)
+    {
+        for (size_t i = 0; i < lanes; ++i)
+        {
+            a_result.min[channel] = std::min(a_result.min[channel], (uint8_t)minV[channel][i]);
+            a_result.max[channel] = std::max(a_result.max[channel], (uint8_t)maxV[channel][i]);
+        }
+    }
+
+    return count;
+}
+
+template<size_t N> const PixelKernels* makePixelKernels(const char* a_name)
+{
+    static const PixelKernels kernels =
+    {
+        a_name,
+        convertBytePixels<N>,
+        convertShortPixels<N>,
+        convertIntPixels<N>,
+        convertLongPixels<N>,
+        convertFloatPixels<N>,
+        convertDoublePixels<N>,
+        calcMinMax<N, uint8_t>,
+        calcMinMax<N, int16_t>,
+        calcMinMax<N, int32_t>,
+        calcMinMax<N, int64_t>,
+        calcMinMax<N, float>,
+        calcMinMax<N, double>,
+        adjustColors<N>,
+        calcColorStats<N>
+    };
+
+    return &kernels;
+}
+
+}
+}
+
+#endif // LIBNFITS_PIXELKERNELS_IMPL_H
@@ -0,0 +1,27 @@
+#include "pixelkernels.h"
+
+#ifdef LIBNFITS_HAVE_X86_PIXEL_KERNELS
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+#include <immintrin.h>
+
+// the headers above are included before the target is changed, only the kernels below use the instruction set
+#pragma GCC target("sse4.2")
+
+#include "pixelkernels_impl.h"
+
+namespace libnfits
+{
+
+const PixelKernels* getPixelKernelsSSE42()
+{
+    return makePixelKernels<16>("sse4.2");
+}
+
+}
+
+#endif
@@ -0,0 +1,120 @@
+#include "sampleplanecache.h"
+
+namespace libnfits
+{
+
+SamplePlaneCache::SamplePlaneCache():
+    m_budget(FITS_SAMPLE_PLANE_CACHE_BUDGET_SIZE), m_usedSize(0)
+{
+
+}
+
+SamplePlaneCache& SamplePlaneCache::getInstance()
+{
+    static SamplePlaneCache cache;
+
+    return cache;
+}
+
+// Removes the least recently used planes until a_size bytes more fit into the budget, the mutex must be locked
+void SamplePlaneCache::evict(size_t a_size)
+{
+    while (!m_entries.empty() && m_usedSize + a_size > m_budget)
+    {
+        m_usedSize -= m_entries.back().plane->size;
+        m_entries.pop_back();
+    }
+}
+
+void SamplePlaneCache::setBudget(size_t a_budget)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_budget = a_budget;
+    evict(0);
+}
+
+size_t SamplePlaneCache::getBudget() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_budget;
+}
+
+size_t SamplePlaneCache::getUsedSize() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_usedSize;
+}
+
+std::shared_ptr<const SamplePlane> SamplePlaneCache::find(const void* a_owner)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+    {
+        if (it->owner == a_owner)
+        {
+            m_entries.splice(m_entries.begin(), m_entries, it);
+
+            return it->plane;
+        }
+    }
+
+    return nullptr;
+}
+
+// Replaces the plane of a_owner, fails if the plane is bigger than the whole budget
+int32_t SamplePlaneCache::insert(const void* a_owner, std::shared_ptr<const SamplePlane> a_plane)
+{
+    if (a_plane == nullptr)
+        return FITS_GENERAL_ERROR;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+    {
+        if (it->owner == a_owner)
+        {
+            m_usedSize -= it->plane->size;
+            m_entries.erase(it);
+            break;
+        }
+    }
+
+    if (a_plane->size > m_budget)
+        return FITS_GENERAL_ERROR;
+
+    evict(a_plane->size);
+
+    m_entries.push_front({ a_owner, std::move(a_plane) });
+    m_usedSize += m_entries.front().plane->size;
+
+    return FITS_GENERAL_SUCCESS;
+}
+
+void SamplePlaneCache::remove(const void* a_owner)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+    {
+        if (it->owner == a_owner)
+        {
+            m_usedSize -= it->plane->size;
+            m_entries.erase(it);
+            break;
+        }
+    }
+}
+
+void SamplePlaneCache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_entries.clear();
+    m_usedSize = 0;
+}
+
+}
@@ -0,0 +1,64 @@
+#ifndef LIBNFITS_SAMPLEPLANECACHE_H
+#define LIBNFITS_SAMPLEPLANECACHE_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+
+#include "defs.h"
+
+namespace libnfits
+{
+
+// Native-endian samples of one image with BZERO/BSCALE applied, stored in the type the render kernels convert them in
+struct SamplePlane
+{
+    const uint8_t*              source;     /// the big-endian data the plane was decoded from
+    int32_t                     bitpix;
+    uint32_t                    width;
+    uint32_t                    height;
+    long double                 bzero;
+    long double                 bscale;
+    size_t                      size;       /// in bytes
+    std::unique_ptr<uint8_t[]>  data;
+};
+
+// Sample planes of all the images within one memory budget, the least recently used planes are evicted first.
+// The planes are shared: an evicted plane is released when the render using it is over.
+class SamplePlaneCache
+{
+private:
+    struct Entry
+    {
+        const void*                         owner;
+        std::shared_ptr<const SamplePlane>  plane;
+    };
+
+    std::list<Entry>    m_entries;      /// the most recently used first
+    size_t              m_budget;
+    size_t              m_usedSize;
+    mutable std::mutex  m_mutex;
+
+private:
+    SamplePlaneCache();
+    void evict(size_t a_size);
+
+public:
+    SamplePlaneCache(const SamplePlaneCache&) = delete;
+    SamplePlaneCache& operator = (const SamplePlaneCache&) = delete;
+
+    static SamplePlaneCache& getInstance();
+
+    void setBudget(size_t a_budget);
+    size_t getBudget() const;
+    size_t getUsedSize() const;
+
+    std::shared_ptr<const SamplePlane> find(const void* a_owner);
+    int32_t insert(const void* a_owner, std::shared_ptr<const SamplePlane> a_plane);
+    void remove(const void* a_owner);
+    void clear();
+};
+
+}
+#endif // LIBNFITS_SAMPLEPLANECACHE_H
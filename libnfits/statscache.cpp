@@ -0,0 +1,290 @@
+#include "statscache.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#include "hduindex.h"
+
+namespace libnfits
+{
+
+StatsCache::StatsCache():
+    m_fileSize(0), m_modificationTime(0), m_blockHash(0), m_isModified(false)
+{
+
+}
+
+StatsCache::~StatsCache()
+{
+    reset();
+}
+
+// Hash of the payload size and of FITS_STATS_CACHE_HASH_BLOCKS blocks spread over the payload, the first and the last
+// ones included, so validating a cached entry doesn't read the whole payload
+uint64_t StatsCache::hashPayload(const uint8_t* a_buffer, size_t a_size)
+{
+    uint64_t hash = HDUIndex::hashBlock((const uint8_t*)&a_size, sizeof(a_size));
+
+    size_t blocksNumber = (a_size + FITS_BLOCK_SIZE - 1) / FITS_BLOCK_SIZE;
+    size_t hashedBlocks = std::min(blocksNumber, (size_t)FITS_STATS_CACHE_HASH_BLOCKS);
+
+    for (size_t i = 0; i < hashedBlocks; ++i)
+    {
+        size_t block = hashedBlocks > 1 ? i * (blocksNumber - 1) / (hashedBlocks - 1) : 0;
+        size_t offset = block * FITS_BLOCK_SIZE;
+
+        hash ^= HDUIndex::hashBlock(a_buffer + offset, std::min((size_t)FITS_BLOCK_SIZE, a_size - offset));
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+void StatsCache::reset()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_entries.clear();
+    m_fileSize = 0;
+    m_modificationTime = 0;
+    m_blockHash = 0;
+    m_isModified = false;
+}
+
+void StatsCache::setFileInfo(uint64_t a_fileSize, uint64_t a_modificationTime, uint64_t a_blockHash)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_fileSize = a_fileSize;
+    m_modificationTime = a_modificationTime;
+    m_blockHash = a_blockHash;
+}
+
+bool StatsCache::isModified() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_isModified;
+}
+
+std::vector<StatsCacheEntry>::iterator StatsCache::findEntry(uint64_t a_payloadOffset, uint64_t a_payloadSize)
+{
+    for (auto it = m_entries.begin(); it < m_entries.end(); ++it)
+    {
+        if (it->payloadOffset == a_payloadOffset && it->payloadSize == a_payloadSize)
+            return it;
+    }
+
+    return m_entries.end();
+}
+
+int32_t StatsCache::findImageStats(const Image& a_image, ImageStats& a_stats) const
+{
+    size_t size = (size_t)a_image.getWidth() * a_image.getHeight() * (std::abs(a_image.getBitPix()) / 8);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_entries.empty() || a_image.getData() == nullptr || a_image.getBaseOffset() + size > a_image.getMaxDataBufferSize())
+        return FITS_GENERAL_ERROR;
+
+    for (const StatsCacheEntry& entry : m_entries)
+    {
+        if (entry.payloadOffset != a_image.getBaseOffset() || entry.payloadSize != size)
+            continue;
+
+        if (entry.bitpix != a_image.getBitPix() || entry.stats.histogram.getBinsNumber() != a_image.getHistogramBinsNumber() ||
+            entry.stats.histogram.getSpacing() != a_image.getHistogramSpacing() ||
+            entry.payloadHash != hashPayload(a_image.getData(), size))
+            return FITS_GENERAL_ERROR;
+
+        a_stats = entry.stats;
+
+        return FITS_GENERAL_SUCCESS;
+    }
+
+    return FITS_GENERAL_ERROR;
+}
+
+// Only the exact statistics are kept, the entry of the same payload is replaced
+void StatsCache::setImageStats(const Image& a_image, const ImageStats& a_stats)
+{
+    size_t size = (size_t)a_image.getWidth() * a_image.getHeight() * (std::abs(a_image.getBitPix()) / 8);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (a_stats.isApproximate || m_modificationTime == 0 || a_image.getData() == nullptr ||
+        a_image.getBaseOffset() + size > a_image.getMaxDataBufferSize())
+        return;
+
+    auto it = findEntry(a_image.getBaseOffset(), size);
+
+    if (it == m_entries.end())
+        it = m_entries.insert(m_entries.end(), StatsCacheEntry());
+
+    it->payloadOffset = a_image.getBaseOffset();
+    it->payloadSize = size;
+    it->payloadHash = hashPayload(a_image.getData(), size);
+    it->bitpix = a_image.getBitPix();
+    it->stats = a_stats;
+
+    m_isModified = true;
+}
+
+// Only the bins with pixels are saved as (index, count) pairs, the percents are counted again from the counts
+int32_t StatsCache::saveToFile(const std::string& a_fileName)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_entries.empty() || m_modificationTime == 0)
+        return FITS_GENERAL_ERROR;
+
+    std::ofstream file(a_fileName, std::ios::binary | std::ios::trunc);
+
+    if (!file)
+        return FITS_GENERAL_ERROR;
+
+    uint64_t header[4] = { m_fileSize, m_modificationTime, m_blockHash, m_entries.size() };
+
+    file.write(FITS_STATS_CACHE_FILE_SIGNATURE, std::strlen(FITS_STATS_CACHE_FILE_SIGNATURE));
+    file.write((const char*)header, sizeof(header));
+
+    for (const StatsCacheEntry& entry : m_entries)
+    {
+        const Histogram& histogram = entry.stats.histogram;
+        const DistribStats* bins = histogram.getBins();
+
+        uint64_t binsWithPixels = 0;
+
+        for (size_t i = 0; i < histogram.getBinsNumber(); ++i)
+            binsWithPixels += bins[i].count != 0;
+
+        uint64_t payload[6] = { entry.payloadOffset, entry.payloadSize, entry.payloadHash, entry.stats.invalidPixelsCount,
+                                histogram.getBinsNumber(), binsWithPixels };
+        int32_t structure[2] = { entry.bitpix, (int32_t)histogram.getSpacing() };
+        double minMax[2] = { entry.stats.minValue, entry.stats.maxValue };
+        int64_t minMaxL[2] = { entry.stats.minValueL, entry.stats.maxValueL };
+
+        file.write((const char*)payload, sizeof(payload));
+        file.write((const char*)structure, sizeof(structure));
+        file.write((const char*)minMax, sizeof(minMax));
+        file.write((const char*)minMaxL, sizeof(minMaxL));
+
+        for (size_t i = 0; i < histogram.getBinsNumber(); ++i)
+        {
+            if (bins[i].count == 0)
+                continue;
+
+            uint64_t bin[2] = { i, bins[i].count };
+
+            file.write((const char*)bin, sizeof(bin));
+        }
+    }
+
+    if (!file.good())
+        return FITS_GENERAL_ERROR;
+
+    m_isModified = false;
+
+    return FITS_GENERAL_SUCCESS;
+}
+
+// The cache is accepted only if it was created for the same file: size, modification time and the first block hash must match.
+// The file info is kept even if it isn't, so the statistics counted later are saved for this file.
+int32_t StatsCache::loadFromFile(const std::string& a_fileName, uint64_t a_fileSize, uint64_t a_modificationTime, uint64_t a_blockHash)
+{
+    reset();
+
+    setFileInfo(a_fileSize, a_modificationTime, a_blockHash);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::ifstream file(a_fileName, std::ios::binary);
+
+    if (!file)
+        return FITS_GENERAL_ERROR;
+
+    char signature[sizeof(FITS_STATS_CACHE_FILE_SIGNATURE)] = {};
+    uint64_t header[4] = {};
+
+    file.read(signature, std::strlen(FITS_STATS_CACHE_FILE_SIGNATURE));
+    file.read((char*)header, sizeof(header));
+
+    if (!file || std::strcmp(signature, FITS_STATS_CACHE_FILE_SIGNATURE) != 0 || header[0] != a_fileSize ||
+        header[1] != a_modificationTime || header[2] != a_blockHash)
+        return FITS_GENERAL_ERROR;
+
+    for (uint64_t i = 0; i < header[3]; ++i)
+    {
+        StatsCacheEntry entry;
+        uint64_t payload[6];
+        int32_t structure[2];
+        double minMax[2];
+        int64_t minMaxL[2];
+
+        file.read((char*)payload, sizeof(payload));
+        file.read((char*)structure, sizeof(structure));
+        file.read((char*)minMax, sizeof(minMax));
+        file.read((char*)minMaxL, sizeof(minMaxL));
+
+        const int32_t bytesPerPixel = std::abs(structure[0]) / 8;
+
+        if (!file || payload[4] == 0 || payload[4] > FITS_STATS_CACHE_MAX_BINS || payload[5] > payload[4] ||
+            structure[1] < FITS_HISTOGRAM_SPACING_LINEAR || structure[1] > FITS_HISTOGRAM_SPACING_ASINH ||
+            (bytesPerPixel != 1 && bytesPerPixel != 2 && bytesPerPixel != 4 && bytesPerPixel != 8) ||
+            (structure[0] < 0 && bytesPerPixel < 4) || payload[3] > payload[1] / bytesPerPixel)
+        {
+            m_entries.clear();
+
+            return FITS_GENERAL_ERROR;
+        }
+
+        entry.payloadOffset = payload[0];
+        entry.payloadSize = payload[1];
+        entry.payloadHash = payload[2];
+        entry.bitpix = structure[0];
+        entry.stats.invalidPixelsCount = payload[3];
+        entry.stats.isApproximate = false;
+        entry.stats.minValue = minMax[0];
+        entry.stats.maxValue = minMax[1];
+        entry.stats.minValueL = minMaxL[0];
+        entry.stats.maxValueL = minMaxL[1];
+
+        /// the histogram range is the min/max, as getBufferStats() sets it
+        Histogram& histogram = entry.stats.histogram;
+
+        histogram.setBins(payload[4], structure[1]);
+
+        if (entry.bitpix > 0)
+            histogram.setRange(entry.stats.minValueL, entry.stats.maxValueL);
+        else
+            histogram.setRange(entry.stats.minValue, entry.stats.maxValue);
+
+        DistribStats* bins = histogram.getBins();
+
+        for (uint64_t j = 0; j < payload[5]; ++j)
+        {
+            uint64_t bin[2] = { payload[4], 0 };
+
+            file.read((char*)bin, sizeof(bin));
+
+            if (!file || bin[0] >= payload[4])
+            {
+                m_entries.clear();
+
+                return FITS_GENERAL_ERROR;
+            }
+
+            bins[bin[0]].count = bin[1];
+        }
+
+        histogram.calcPercents(entry.payloadSize / bytesPerPixel - entry.stats.invalidPixelsCount);
+
+        m_entries.push_back(std::move(entry));
+    }
+
+    return FITS_GENERAL_SUCCESS;
+}
+
+}
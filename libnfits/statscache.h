@@ -0,0 +1,59 @@
+#ifndef LIBNFITS_STATSCACHE_H
+#define LIBNFITS_STATSCACHE_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "defs.h"
+#include "image.h"
+
+namespace libnfits
+{
+
+// Exact statistics of one image HDU, the payload is identified by its location and a hash of some of its blocks
+struct StatsCacheEntry
+{
+    uint64_t                payloadOffset;
+    uint64_t                payloadSize;
+    uint64_t                payloadHash;
+    int32_t                 bitpix;
+    ImageStats              stats;
+};
+
+// Image statistics of a FITS file, saved next to it so reopening the file skips counting them.
+// The cache belongs to the file with the same size, modification time and first block contents,
+// an entry also to the payload with the same hash, bitpix and histogram bins.
+// The statistics may be set by the threads counting them while the cache is saved.
+class StatsCache
+{
+private:
+    std::vector<StatsCacheEntry>    m_entries;
+    uint64_t                        m_fileSize;         /// size of the file on disk
+    uint64_t                        m_modificationTime;
+    uint64_t                        m_blockHash;        /// hash of the first block of the file on disk
+    bool                            m_isModified;       /// entries were added since the cache was loaded
+    mutable std::mutex              m_mutex;
+
+    std::vector<StatsCacheEntry>::iterator findEntry(uint64_t a_payloadOffset, uint64_t a_payloadSize);
+
+public:
+    StatsCache();
+    ~StatsCache();
+
+    static uint64_t hashPayload(const uint8_t* a_buffer, size_t a_size);
+
+    void reset();
+    void setFileInfo(uint64_t a_fileSize, uint64_t a_modificationTime, uint64_t a_blockHash);
+    bool isModified() const;
+
+    int32_t findImageStats(const Image& a_image, ImageStats& a_stats) const;
+    void setImageStats(const Image& a_image, const ImageStats& a_stats);
+
+    int32_t saveToFile(const std::string& a_fileName);
+    int32_t loadFromFile(const std::string& a_fileName, uint64_t a_fileSize, uint64_t a_modificationTime, uint64_t a_blockHash);
+};
+
+}
+#endif // LIBNFITS_STATSCACHE_H
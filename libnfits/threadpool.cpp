@@ -0,0 +1,124 @@
+#include "threadpool.h"
+
+#include <algorithm>
+
+namespace libnfits
+{
+
+// One thread less than the cores, the calling thread runs the task as well
+ThreadPool::ThreadPool():
+    m_isStopping(false)
+{
+    size_t threadsNumber = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), FITS_RENDER_MAX_THREADS) - 1;
+
+    try
+    {
+        for (size_t i = 0; i < threadsNumber; ++i)
+            m_threads.emplace_back(&ThreadPool::work, this);
+    }
+    catch (...)
+    {
+        /// the threads started so far are the pool
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_isStopping = true;
+    }
+
+    m_jobCondition.notify_all();
+
+    for (std::thread& thread : m_threads)
+        thread.join();
+}
+
+ThreadPool& ThreadPool::getInstance()
+{
+    static ThreadPool pool;
+
+    return pool;
+}
+
+size_t ThreadPool::getThreadsNumber() const
+{
+    return m_threads.size();
+}
+
+void ThreadPool::work()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true)
+    {
+        m_jobCondition.wait(lock, [this]() { return m_isStopping || !m_jobs.empty(); });
+
+        if (m_isStopping)
+            return;
+
+        Job* job = m_jobs.front();
+
+        if (--job->helpersNumber == 0)
+            m_jobs.pop_front();
+
+        ++job->runningNumber;
+
+        lock.unlock();
+
+        try
+        {
+            (*job->task)();
+        }
+        catch (...)
+        {
+            /// the task reports its failures itself, the thread stays in the pool
+        }
+
+        lock.lock();
+
+        /// the job lives on the stack of run(), it's not touched after the last running thread is done
+        if (--job->runningNumber == 0)
+            m_doneCondition.notify_all();
+    }
+}
+
+// Runs a_task on the calling thread and on up to a_helpersNumber pool threads, returns when all of them are done
+void ThreadPool::run(size_t a_helpersNumber, const std::function<void()>& a_task)
+{
+    a_helpersNumber = std::min(a_helpersNumber, m_threads.size());
+
+    if (a_helpersNumber == 0)
+    {
+        a_task();
+
+        return;
+    }
+
+    Job job = { &a_task, a_helpersNumber, 0 };
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_jobs.push_back(&job);
+    }
+
+    for (size_t i = 0; i < a_helpersNumber; ++i)
+        m_jobCondition.notify_one();
+
+    a_task();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    /// the threads which haven't taken the job yet are not needed anymore
+    auto it = std::find(m_jobs.begin(), m_jobs.end(), &job);
+
+    if (it != m_jobs.end())
+        m_jobs.erase(it);
+
+    m_doneCondition.wait(lock, [&job]() { return job.runningNumber == 0; });
+}
+
+}
@@ -0,0 +1,55 @@
+#ifndef LIBNFITS_THREADPOOL_H
+#define LIBNFITS_THREADPOOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "defs.h"
+
+namespace libnfits
+{
+
+// Threads started once and shared by all the processRowBands() calls. A task is run by the calling thread and by up to
+// the requested number of idle pool threads, so the calls from different threads and the nested calls never wait for
+// each other: a call without idle pool threads runs its task alone.
+class ThreadPool
+{
+private:
+    struct Job
+    {
+        const std::function<void()>*    task;
+        size_t                          helpersNumber;      /// pool threads which may still take the job
+        size_t                          runningNumber;      /// pool threads running the task
+    };
+
+    std::vector<std::thread>    m_threads;
+    std::deque<Job*>            m_jobs;
+    std::mutex                  m_mutex;
+    std::condition_variable     m_jobCondition;
+    std::condition_variable     m_doneCondition;
+    bool                        m_isStopping;
+
+private:
+    ThreadPool();
+    ~ThreadPool();
+
+    void work();
+
+public:
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator = (const ThreadPool&) = delete;
+
+    static ThreadPool& getInstance();
+
+    size_t getThreadsNumber() const;
+
+    void run(size_t a_helpersNumber, const std::function<void()>& a_task);
+};
+
+}
+#endif // LIBNFITS_THREADPOOL_H
@@ -34,6 +34,16 @@ qint32 progressCallbackFunction(qint32 a_value, void* a_buffer)
     return a_value;
 }
 
+// Wrapper over the HDU loaded signal, called by FitsFile for each HDU as soon as it is parsed and its data is available
+qint32 hduCallbackFunction(qint32 a_hduIndex, void* a_buffer)
+{
+    MainWindow* mainWnd = static_cast<MainWindow*>(a_buffer);
+
+    emit mainWnd->sendHDULoaded(a_hduIndex);
+
+    return a_hduIndex;
+}
+
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
@@ -48,6 +58,7 @@ MainWindow::MainWindow(QWidget *parent)
     , m_exportFormat(IMAGE_EXPORT_TYPE_PNG)
     , m_exportQuality(IMAGE_EXPORT_DEFAULT_QUALITY)
     , m_bEnableStretchingWidgets(false)
+    , m_defaultHDURow(0)
 {
     ui->setupUi(this);
 
@@ -59,15 +70,19 @@ MainWindow::MainWindow(QWidget *parent)
 
     connect(m_sliderZoom, SIGNAL(valueChanged(int)), SLOT(om_m_sliderZoom_valueChanged(int)));
     connect(this, SIGNAL(sendProgressChanged(qint32)), SLOT(on_progressChanged(qint32)));
+    connect(this, SIGNAL(sendHDULoaded(qint32)), SLOT(onHDULoaded(qint32)));
 
     connect(ui->workspaceWidget, SIGNAL(sendGammaCorrectionTabEnabled(bool)), this, SLOT(on_workspaceWidget_sendGammaCorrectionTabEnabled(bool)));
     connect(ui->workspaceWidget->getFITSImageLabel(), SIGNAL(sendMousewheelZoomChanged(int32_t)), this, SLOT(onSendMousewheelZoomChanged(int32_t)));
     connect(ui->workspaceWidget->getFITSImageLabel(), SIGNAL(sendMousedragScrollChanged(int32_t, int32_t)), this, SLOT(onSendMousedragScrollChanged(int32_t, int32_t)));
 
-    connect(ui->workspaceWidget, SIGNAL(sendDrawHistogramChartInt(libnfits::DistribStats const*, int64_t, int64_t, size_t)),
-                  SLOT(onDrawHistogramChartInt(libnfits::DistribStats const*, int64_t, int64_t, size_t)));
-    connect(ui->workspaceWidget, SIGNAL(sendDrawHistogramChartDouble(libnfits::DistribStats const*, double, double, size_t)),
-                  SLOT(onDrawHistogramChartDouble(libnfits::DistribStats const*, double, double, size_t)));
+    connect(ui->workspaceWidget, SIGNAL(sendDrawHistogramChartInt(libnfits::Histogram const*, int64_t, int64_t)),
+                  SLOT(onDrawHistogramChartInt(libnfits::Histogram const*, int64_t, int64_t)));
+    connect(ui->workspaceWidget, SIGNAL(sendDrawHistogramChartDouble(libnfits::Histogram const*, double, double)),
+                  SLOT(onDrawHistogramChartDouble(libnfits::Histogram const*, double, double)));
+    connect(ui->workspaceWidget, SIGNAL(sendImageStatsUpdated(quint32)), this, SLOT(onImageStatsUpdated(quint32)));
+
+    ui->workspaceWidget->setStatsCache(&m_fitsFile.getStatsCache());  // statistics of the reopened files are not counted again
 
     //// currently the Undo/Redo logic is not implemented, not needed so far, so disabling the controls
     ui->actionUndo->setVisible(false);
@@ -302,9 +317,8 @@ void MainWindow::on_checkBoxGrayscale_stateChanged(int arg1)
     }
     else
     {
-        int32_t index = ui->workspaceWidget->getCurrentImageHDUIndex();
-        if (index != - 1)
-            restoreRGBColorChannelLevelsImage(index);
+        if (ui->workspaceWidget->getCurrentImageHDUIndex() != -1)
+            applyImageAdjustments();
 
         m_bGrayscale = false;
     }
@@ -327,117 +341,106 @@ void MainWindow::om_m_sliderZoom_valueChanged(int a_value)
     scaleImage();
 }
 
-void MainWindow::populateHDUsWidget()
+void MainWindow::populateHDUsWidgetRow(uint32_t a_hduIndex)
 {
-    uint32_t            numberOfHDUs = 0;
-    int32_t             resTemp = FITS_GENERAL_ERROR, curHDU = 0;
-    libnfits::HDU       hdu;
+    const libnfits::HDU* hdu = nullptr;
 
-    m_fitsFile.setOffset(0);
-    numberOfHDUs = m_fitsFile.getNumberOfHDUs();
+    int32_t resTemp = m_fitsFile.getHDU(a_hduIndex, hdu);
 
-    for (uint32_t i = 0; i < numberOfHDUs; ++i)
+    if (resTemp == FITS_GENERAL_SUCCESS)
     {
-        resTemp = m_fitsFile.getHDU(i, hdu);
-        size_t sizeHDU = hdu.getSize();
+        size_t sizeHDU = hdu->getSize();
 
-        if (resTemp == FITS_GENERAL_SUCCESS)
-        {
-            ui->tableWidgetHDUs->insertRow(ui->tableWidgetHDUs->rowCount());
+        ui->tableWidgetHDUs->insertRow(ui->tableWidgetHDUs->rowCount());
 
-            bool bSuccess;
-            int32_t bitpix = hdu.getKeywordValue<int32_t>(FITS_KEYWORD_BITPIX, bSuccess);
-            QString bitpixStr = "N/A";
+        // the structural values are known without parsing the whole header
+        int32_t bitpix = hdu->getBitpix();
+        QString bitpixStr = "N/A";
 
-            if (bSuccess)
-                bitpixStr = QString::number(bitpix);
+        if (bitpix != FITS_RECORD_NOT_FOUND)
+            bitpixStr = QString::number(bitpix);
 
-            uint8_t HDUtype = hdu.getType();
-            QString HDUtypeStr = "";
+        uint8_t HDUtype = hdu->getType();
+        QString HDUtypeStr = "";
 
-            if (hdu.isPrimary())
-            {
-                curHDU = i;
-                HDUtypeStr = "P";
-            }
+        if (hdu->isPrimary())
+        {
+            m_defaultHDURow = a_hduIndex;
+            HDUtypeStr = "P";
+        }
 
-            if (HDUtype & FITS_HDU_TYPE_IMAGE_XTENSION)
-            {
-                curHDU = i;
-                HDUtypeStr += "I";
-            }
+        if (HDUtype & FITS_HDU_TYPE_IMAGE_XTENSION)
+        {
+            m_defaultHDURow = a_hduIndex;
+            HDUtypeStr += "I";
+        }
 
-            if (HDUtype & FITS_HDU_TYPE_ASCII_TABLE_XTENSION)
-                HDUtypeStr += "T(A)";
+        if (HDUtype & FITS_HDU_TYPE_ASCII_TABLE_XTENSION)
+            HDUtypeStr += "T(A)";
 
-            if (HDUtype & FITS_HDU_TYPE_BINARY_TABLE_XTENSION)
-                HDUtypeStr += "T(B)";
+        if (HDUtype & FITS_HDU_TYPE_BINARY_TABLE_XTENSION)
+            HDUtypeStr += "T(B)";
 
-            if (HDUtype & FITS_HDU_TYPE_COMPRESSED_IMAGE_XTENSION)
-                HDUtypeStr += "I(C)";
+        if (HDUtype & FITS_HDU_TYPE_COMPRESSED_IMAGE_XTENSION)
+            HDUtypeStr += "I(C)";
 
-            if (HDUtype & FITS_HDU_TYPE_COMPRESSED_TABLE_XTENSION)
-                HDUtypeStr += "T(C)";
+        if (HDUtype & FITS_HDU_TYPE_COMPRESSED_TABLE_XTENSION)
+            HDUtypeStr += "T(C)";
 
-            if (HDUtype & FITS_HDU_TYPE_RANDOM_GROUP_RECORDS)
-                HDUtypeStr += "R";
+        if (HDUtype & FITS_HDU_TYPE_RANDOM_GROUP_RECORDS)
+            HDUtypeStr += "R";
 
-            QTableWidgetItem *itemType, *itemSize, *itemBitpix;
+        QTableWidgetItem *itemType, *itemSize, *itemBitpix;
 
-            itemType = new QTableWidgetItem(HDUtypeStr);
-            itemSize = new QTableWidgetItem(QString::number(sizeHDU));
-            itemBitpix = new QTableWidgetItem(bitpixStr);
+        itemType = new QTableWidgetItem(HDUtypeStr);
+        itemSize = new QTableWidgetItem(QString::number(sizeHDU));
+        itemBitpix = new QTableWidgetItem(bitpixStr);
 
-            itemType->setFlags(itemType->flags() & ~Qt::ItemIsEditable);
-            itemSize->setFlags(itemSize->flags() & ~Qt::ItemIsEditable);
-            itemBitpix->setFlags(itemBitpix->flags() & ~Qt::ItemIsEditable);
+        itemType->setFlags(itemType->flags() & ~Qt::ItemIsEditable);
+        itemSize->setFlags(itemSize->flags() & ~Qt::ItemIsEditable);
+        itemBitpix->setFlags(itemBitpix->flags() & ~Qt::ItemIsEditable);
 
-            ui->tableWidgetHDUs->setItem(ui->tableWidgetHDUs->rowCount()-1, 0, itemType);
-            ui->tableWidgetHDUs->setItem(ui->tableWidgetHDUs->rowCount()-1, 1, itemSize);
-            ui->tableWidgetHDUs->setItem(ui->tableWidgetHDUs->rowCount()-1, 2, itemBitpix);
+        ui->tableWidgetHDUs->setItem(ui->tableWidgetHDUs->rowCount()-1, 0, itemType);
+        ui->tableWidgetHDUs->setItem(ui->tableWidgetHDUs->rowCount()-1, 1, itemSize);
+        ui->tableWidgetHDUs->setItem(ui->tableWidgetHDUs->rowCount()-1, 2, itemBitpix);
 
-            uint32_t axisesNumber = hdu.getKeywordValue<uint32_t>(FITS_KEYWORD_NAXIS, bSuccess);
-            std::vector<uint32_t> axises = hdu.getAxises();
+        int32_t axisesNumber = hdu->getNaxis();
+        const std::vector<uint32_t>& axises = hdu->getAxises();
 
-            if ((HDUtype == FITS_HDU_TYPE_IMAGE_XTENSION || HDUtype == FITS_HDU_TYPE_PRIMARY) &&
-                (axisesNumber >= 2 && bSuccess) && (axises.size() >= 2))
-            {
-                QBrush color = Qt::lightGray;
+        if ((HDUtype == FITS_HDU_TYPE_IMAGE_XTENSION || HDUtype == FITS_HDU_TYPE_PRIMARY) &&
+            axisesNumber >= 2 && axises.size() >= 2)
+        {
+            QBrush color = Qt::lightGray;
 
-                ui->tableWidgetHDUs->item(ui->tableWidgetHDUs->rowCount()-1, 0)->setBackground(color);
-                ui->tableWidgetHDUs->item(ui->tableWidgetHDUs->rowCount()-1, 1)->setBackground(color);
-                ui->tableWidgetHDUs->item(ui->tableWidgetHDUs->rowCount()-1, 2)->setBackground(color);
-            }
+            ui->tableWidgetHDUs->item(ui->tableWidgetHDUs->rowCount()-1, 0)->setBackground(color);
+            ui->tableWidgetHDUs->item(ui->tableWidgetHDUs->rowCount()-1, 1)->setBackground(color);
+            ui->tableWidgetHDUs->item(ui->tableWidgetHDUs->rowCount()-1, 2)->setBackground(color);
         }
     }
-
-    int32_t rowCount = ui->tableWidgetHDUs->rowCount();
-
-    if (rowCount > 0)
-        ///ui->tableWidgetHDUs->selectRow(rowCount - 1); /// original way
-        ui->tableWidgetHDUs->selectRow(curHDU);
 }
 
 void MainWindow::populateHeaderWidget(int32_t a_hduIndex)
 {
     int32_t          resTemp = FITS_GENERAL_ERROR;
-    libnfits::HDU    hdu;
+    const libnfits::HDU* hdu = nullptr;
 
     resTemp = m_fitsFile.getHDU(a_hduIndex, hdu);
 
     if (resTemp == FITS_GENERAL_SUCCESS)
-        ui->workspaceWidget->populateHeaderWidget(hdu);
+        ui->workspaceWidget->populateHeaderWidget(*hdu);
 }
 
 void MainWindow::populateRawDataWidget(int32_t a_hduIndex)
 {
     int32_t          resTemp = FITS_GENERAL_ERROR;
-    libnfits::HDU    hdu;
+    const libnfits::HDU* hdu = nullptr;
+
+    m_fitsFile.loadHDUData(a_hduIndex); // inflating the HDU on demand in case of an indexed .gz file
 
     resTemp = m_fitsFile.getHDU(a_hduIndex, hdu);
 
     if (resTemp == FITS_GENERAL_SUCCESS)
-        ui->workspaceWidget->populateRawDataWidget(hdu);
+        ui->workspaceWidget->populateRawDataWidget(*hdu);
 }
 
 int32_t MainWindow::openFITSFile()
@@ -479,6 +482,12 @@ int32_t MainWindow::openFITSFileByName(const QString& a_fileName, bool a_bShowMs
 
     setProgress(25);
 
+    m_defaultHDURow = 0;
+
+    // the HDUs rows and images are added by onHDULoaded() while the file is being loaded
+    m_fitsFile.setHDUCallbackFunction(hduCallbackFunction, (void *)this);
+    m_fitsFile.setCallbackFunction(progressCallbackFunction, (void *)this);  // reading progress of large files
+
 #if defined(PROFILING_MODE)
     libnfits::debugStartProfiling();
 #endif
@@ -489,34 +498,25 @@ int32_t MainWindow::openFITSFileByName(const QString& a_fileName, bool a_bShowMs
 
     if (resTemp == FITS_GENERAL_SUCCESS)
     {
-        m_fitsFile.setCallbackFunction(progressCallbackFunction, (void *)this);
+        if (ui->tableWidgetHDUs->rowCount() > 0)
+            ui->tableWidgetHDUs->selectRow(m_defaultHDURow);
 
-        // this function loads all the image HDUs into the corresponding Image objects
-#if defined(PROFILING_MODE)
-        libnfits::debugStartProfiling();
-#endif
-        setAllWorkspaceImages();
-#if defined(PROFILING_MODE)
-        libnfits::debugEndProfiling("setAllWorkspaceImages()");
-#endif
-
-#if defined(PROFILING_MODE)
-        libnfits::debugStartProfiling();
-#endif
-        populateHDUsWidget();
-#if defined(PROFILING_MODE)
-        libnfits::debugEndProfiling("populateHDUsWidget()");
-#endif
         enableFileOpenRelatedWidgets();
 
         setWindowTitle(QString(NFITSVIEW_APP_NAME) + " - " + getFileName());
 
         setProgress(100);
     }
-    else if (a_bShowMsg)
+    else
     {
-        QMessageBox messageBox;
-        messageBox.critical(this, FITS_MSG_ERROR_TYPE, FITS_MSG_ERROR_OPENING_FILE);
+        clearWidgets();
+        ui->workspaceWidget->clearImages();
+
+        if (a_bShowMsg)
+        {
+            QMessageBox messageBox;
+            messageBox.critical(this, FITS_MSG_ERROR_TYPE, FITS_MSG_ERROR_OPENING_FILE);
+        }
     }
 
     setStatus(STATUS_MESSAGE_READY);
@@ -528,8 +528,58 @@ int32_t MainWindow::openFITSFileByName(const QString& a_fileName, bool a_bShowMs
     return resTemp;
 }
 
+void MainWindow::onHDULoaded(qint32 a_hduIndex)
+{
+    // the loading was restarted, the already reported HDUs are reported again
+    if (a_hduIndex == FITS_HDU_CALLBACK_RESET)
+    {
+        ui->tableWidgetHDUs->clearContents();
+        ui->tableWidgetHDUs->model()->removeRows(0, ui->tableWidgetHDUs->rowCount());
+        ui->workspaceWidget->clearImages();
+
+        m_defaultHDURow = 0;
+
+        return;
+    }
+
+    // the image is inserted before the row, so selecting the row finds it in the workspace
+    bool bImage = setWorkspaceImage(a_hduIndex);
+
+    populateHDUsWidgetRow(a_hduIndex);
+
+    // the first image is shown right away, the rest of the file is still being loaded
+    if (bImage && ui->tableWidgetHDUs->currentRow() < 0)
+    {
+        ui->tableWidgetHDUs->selectRow(a_hduIndex);
+
+        QCoreApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
+    }
+}
+
+// The exact statistics replaced the quick look ones of the shown image
+void MainWindow::onImageStatsUpdated(quint32 a_hduIndex)
+{
+    // the adjustments of the image are kept, it is rendered again with them
+    if ((int32_t)a_hduIndex != ui->workspaceWidget->getCurrentImageHDUIndex())
+        return;
+
+    int32_t scrollX = ui->workspaceWidget->getScrollPosX();
+    int32_t scrollY = ui->workspaceWidget->getScrollPosY();
+
+    ui->workspaceWidget->setImage(a_hduIndex, ui->workspaceWidget->getTransformType(), m_percentThreshold[ui->comboBoxMapping->currentIndex()]);
+
+    ui->workspaceWidget->scaleImage(m_scaleFactor);
+    ui->workspaceWidget->setScrollPosX(scrollX);
+    ui->workspaceWidget->setScrollPosY(scrollY);
+
+    updateHDUInfoWidgetMinMax();
+}
+
 int32_t MainWindow::closeFITSFile()
 {
+    // the payloads are unmapped below, the statistics workers read them
+    ui->workspaceWidget->waitImageStats();
+
     if (m_fitsFile.closeFile() != FITS_MEMORY_MAP_FILE_SUCCESS)
         return FITS_GENERAL_ERROR;
 
@@ -851,27 +901,27 @@ void MainWindow::on_actionRestoreOriginal_triggered()
     //restoreOriginalImage();
 }
 
-void MainWindow::backupOriginalImage()
+void MainWindow::setImageChanged()
 {
     if (!m_bImageChanged)
     {
-        //libnfits::LOG("in backupOriginalImage()");
         m_bImageChanged = true;
-        ui->workspaceWidget->backupImage();
 
         enableRestoreWidgets();
     }
 }
 
+// The original image is the one rendered without adjustments, nothing has to be backed up for it
 void MainWindow::restoreOriginalImage()
 {
-    ui->workspaceWidget->restoreImage();
-    ui->workspaceWidget->reloadImage();
-    ui->workspaceWidget->scaleImage(m_scaleFactor);
-
     initGammaWidgetsValues();
     initMappingWidgetsValues();
     initStretchingWidgetsValues();
+
+    ui->workspaceWidget->setImageAdjustments(1.0f, 1.0f, 1.0f, false, false);
+    ui->workspaceWidget->reloadImage();
+    ui->workspaceWidget->scaleImage(m_scaleFactor);
+
     enableRestoreWidgets(false);
 
     m_bImageChanged = false;
@@ -1012,13 +1062,13 @@ QString MainWindow::getFileName() const
 void MainWindow::populateHDUInfoWidget(int32_t a_hduIndex)
 {
     int32_t          resTemp = FITS_GENERAL_ERROR;
-    libnfits::HDU    hdu;
+    const libnfits::HDU* hdu = nullptr;
 
     resTemp = m_fitsFile.getHDU(a_hduIndex, hdu);
 
     if (resTemp == FITS_GENERAL_SUCCESS)
     {
-        std::vector<uint32_t> axises = hdu.getAxises();
+        const std::vector<uint32_t>& axises = hdu->getAxises();
 
         int32_t numAxises = axises.size();
 
@@ -1030,23 +1080,21 @@ void MainWindow::populateHDUInfoWidget(int32_t a_hduIndex)
             return;
 
         if (numAxises >= 1)
-            ui->labelNAXIS1->setText("NAXIS1: " + QString::number(hdu.getKeywordValue<int32_t>("NAXIS1", bSuccess)));
+            ui->labelNAXIS1->setText("NAXIS1: " + QString::number(hdu->getKeywordValue<int32_t>("NAXIS1", bSuccess)));
 
         if (numAxises >= 2)
-            ui->labelNAXIS2->setText("NAXIS2: " + QString::number(hdu.getKeywordValue<int32_t>("NAXIS2", bSuccess)));
+            ui->labelNAXIS2->setText("NAXIS2: " + QString::number(hdu->getKeywordValue<int32_t>("NAXIS2", bSuccess)));
 
-        long double bzero = hdu.getKeywordValue<long double>("BZERO", bSuccess);
+        long double bzero = hdu->getKeywordValue<long double>("BZERO", bSuccess);
         if (!bSuccess)
             bzero = FITS_BZERO_DEFAULT_VALUE;
         ui->labelBZERO->setText("BZERO: " + QString::asprintf("%.10LE", bzero));
 
-        long double bscale = hdu.getKeywordValue<long double>("BSCALE", bSuccess);
+        long double bscale = hdu->getKeywordValue<long double>("BSCALE", bSuccess);
         if (!bSuccess)
             bscale = FITS_BSCALE_DEFAULT_VALUE;
         ui->labelBSCALE->setText("BSCALE: " + QString::asprintf("%.10LE", bscale));
 
-        axises.clear();
-
         //updateHDUInfoWidgetMinMax();
     }
 }
@@ -1082,7 +1130,7 @@ void MainWindow::on_tableWidgetHDUs_currentItemChanged(QTableWidgetItem *current
         return;
 
     int32_t             row = current->row();
-    libnfits::HDU       hdu;
+    const libnfits::HDU* hdu = nullptr;
     bool                bSuccess;
 
     if (row != -1)
@@ -1113,15 +1161,15 @@ void MainWindow::on_tableWidgetHDUs_currentItemChanged(QTableWidgetItem *current
 
     if (resTemp == FITS_GENERAL_SUCCESS)
     {
-        uint32_t axisesNumber = hdu.getKeywordValue<uint32_t>(FITS_KEYWORD_NAXIS, bSuccess);
-        std::vector<uint32_t> axises = hdu.getAxises();
+        uint32_t axisesNumber = hdu->getKeywordValue<uint32_t>(FITS_KEYWORD_NAXIS, bSuccess);
+        const std::vector<uint32_t>& axises = hdu->getAxises();
 
-        uint8_t HDUType = hdu.getType();
+        uint8_t HDUType = hdu->getType();
 
         if ((HDUType == FITS_HDU_TYPE_IMAGE_XTENSION || HDUType == FITS_HDU_TYPE_PRIMARY) &&
             (axisesNumber >= 2 && bSuccess) && (axises.size() >= 2))
         {
-            int32_t bitpix = hdu.getKeywordValue<int32_t>(FITS_KEYWORD_BITPIX, bSuccess);
+            int32_t bitpix = hdu->getKeywordValue<int32_t>(FITS_KEYWORD_BITPIX, bSuccess);
 
             if (bSuccess)
             {
@@ -1133,7 +1181,7 @@ void MainWindow::on_tableWidgetHDUs_currentItemChanged(QTableWidgetItem *current
                     m_percentThreshold[i] = widgetsStates.gammaStates.mappingThreshold[i];
 
                 ui->workspaceWidget->imageSetVisible(true);
-                //ui->workspaceWidget->setImage(hdu.getPayload(), axises[0], axises[1], hdu.getPayloadOffset(), m_fitsFile.getSize(), bitpix);
+                //ui->workspaceWidget->setImage(hdu->getPayload(), axises[0], axises[1], hdu->getPayloadOffset(), m_fitsFile.getSize(), bitpix);
                 //ui->workspaceWidget->setImage(row);
                 ui->workspaceWidget->setImage(row, widgetsStates.gammaStates.mappingValue, m_percentThreshold[ui->comboBoxMapping->currentIndex()]);
 
@@ -1176,21 +1224,14 @@ void MainWindow::on_tableWidgetHDUs_currentItemChanged(QTableWidgetItem *current
                         //              widgetStates.imageChanged, widgetStates.gammaStates.gray, widgetStates.gammaStates.eye);
                         setWidgetsStates(widgetsStates);
 
-                        int32_t index = ui->workspaceWidget->getCurrentImageHDUIndex();
-
                         if (widgetsStates.gammaStates.gray)
                         {
-
-                            //libnfits::LOG("gray: index = % , hduIndex = %", index, hduIndex);
-                            restoreRGBColorChannelLevelsImage(index);
                             grayScale();
                             ui->workspaceWidget->scaleImage(m_scaleFactor);
                         }
 
                         if (widgetsStates.gammaStates.eye)
                         {
-                            //libnfits::LOG("eye: index = % , hduIndex = %", index, hduIndex);
-                            restoreRGBColorChannelLevelsImage(index);
                             eyeComfort();
                             ui->workspaceWidget->scaleImage(m_scaleFactor);
                         }
@@ -1231,8 +1272,6 @@ void MainWindow::on_tableWidgetHDUs_currentItemChanged(QTableWidgetItem *current
             initStretchingWidgetMinMax();
         }
 
-        axises.clear();
-
         initHDUInfoWidgetValues();
         populateHDUInfoWidget(row);
     }
@@ -1267,72 +1306,70 @@ void MainWindow::resizeEvent(QResizeEvent *event)
         fitToWindow();
 }
 
-int32_t MainWindow::setAllWorkspaceImages()
+bool MainWindow::setWorkspaceImage(uint32_t a_hduIndex)
 {
-    libnfits::HDU       hdu;
-
-    int32_t retVal = 0;
+    const libnfits::HDU* hdu = nullptr;
 
     bool bSuccess;
 
-    int32_t countHDU = m_fitsFile.getNumberOfHDUs();
+    int32_t resTemp = m_fitsFile.getHDU(a_hduIndex, hdu);
 
-    for (uint32_t h = 0; h < countHDU; ++h)
+    if (resTemp == FITS_GENERAL_SUCCESS)
     {
-        int32_t resTemp = m_fitsFile.getHDU(h, hdu);
+        uint32_t axisesNumber = hdu->getKeywordValue<uint32_t>(FITS_KEYWORD_NAXIS, bSuccess);
+        const std::vector<uint32_t>& axises = hdu->getAxises();
 
-        if (resTemp == FITS_GENERAL_SUCCESS)
-        {
-            uint32_t axisesNumber = hdu.getKeywordValue<uint32_t>(FITS_KEYWORD_NAXIS, bSuccess);
-            std::vector<uint32_t> axises = hdu.getAxises();
+        uint8_t HDUType = hdu->getType();
 
-            uint8_t HDUType = hdu.getType();
+        //WidgetsStates widgetStates = getWidgetsStates(); // (2) <-> (1)
 
-            //WidgetsStates widgetStates = getWidgetsStates(); // (2) <-> (1)
+        if ((HDUType == FITS_HDU_TYPE_IMAGE_XTENSION || HDUType == FITS_HDU_TYPE_PRIMARY) && (axisesNumber >= 2 && bSuccess) && (axises.size() >= 2))
+        {
+            int32_t bitpix = hdu->getKeywordValue<int32_t>(FITS_KEYWORD_BITPIX, bSuccess);
 
-            if ((HDUType == FITS_HDU_TYPE_IMAGE_XTENSION || HDUType == FITS_HDU_TYPE_PRIMARY) && (axisesNumber >= 2 && bSuccess) && (axises.size() >= 2))
+            // only the image HDUs payloads are inflated for indexed .gz files
+            if (bSuccess && m_fitsFile.loadHDUData(a_hduIndex) == FITS_GENERAL_SUCCESS)
             {
-                int32_t bitpix = hdu.getKeywordValue<int32_t>(FITS_KEYWORD_BITPIX, bSuccess);
+                WidgetsStates widgetStates = getWidgetsStates(); // (1) <-> (2)
 
-                if (bSuccess)
-                {
-                    WidgetsStates widgetStates = getWidgetsStates(); // (1) <-> (2)
+                //// The old function, in the new one packed params into the structure
+                //ui->workspaceWidget->insertImage(hdu->getPayload(), axises[0], axises[1], hdu->getPayloadOffset(), m_fitsFile.getSize(),
+                //                                 bitpix, a_hduIndex, widgetStates);
 
-                    //// The old function, in the new one packed params into the structure
-                    //ui->workspaceWidget->insertImage(hdu.getPayload(), axises[0], axises[1], hdu.getPayloadOffset(), m_fitsFile.getSize(),
-                    //                                 bitpix, h, widgetStates);
+                ImageParams imageParams;
+                imageParams.width = axises[0];
+                imageParams.height = axises[1];
+                imageParams.HDUBaseOffset = hdu->getPayloadOffset();
+                imageParams.maxDataBufferSize = m_fitsFile.getSize();
+                imageParams.bitpix = bitpix;
+                imageParams.hduIndex = a_hduIndex;
 
-                    ImageParams imageParams;
-                    imageParams.width = axises[0];
-                    imageParams.height = axises[1];
-                    imageParams.HDUBaseOffset = hdu.getPayloadOffset();
-                    imageParams.maxDataBufferSize = m_fitsFile.getSize();
-                    imageParams.bitpix = bitpix;
-                    imageParams.hduIndex = h;
+                bool bZSuccess = false, bSSuccess = false;
 
-                    bool bZSuccess = false, bSSuccess = false;
+                long double bzero = hdu->getKeywordValue<long double>(FITS_KEYWORD_BZERO, bZSuccess);
+                long double bscale = hdu->getKeywordValue<long double>(FITS_KEYWORD_BSCALE, bSSuccess);
 
-                    long double bzero = hdu.getKeywordValue<long double>(FITS_KEYWORD_BZERO, bZSuccess);
-                    long double bscale = hdu.getKeywordValue<long double>(FITS_KEYWORD_BSCALE, bSSuccess);
+                imageParams.bzero = FITS_BZERO_DEFAULT_VALUE;
+                if (bZSuccess)
+                    imageParams.bzero = bzero;
 
-                    imageParams.bzero = FITS_BZERO_DEFAULT_VALUE;
-                    if (bZSuccess)
-                        imageParams.bzero = bzero;
+                imageParams.bscale = FITS_BSCALE_DEFAULT_VALUE;
+                if (bSSuccess)
+                    imageParams.bscale = bscale;
 
-                    imageParams.bscale = FITS_BSCALE_DEFAULT_VALUE;
-                    if (bSSuccess)
-                        imageParams.bscale = bscale;
+                bool bBSuccess = false;
+                imageParams.blank = hdu->getKeywordValue<int64_t>(FITS_KEYWORD_BLANK, bBSuccess);
+                imageParams.blankFlag = bBSuccess;
 
-                    ui->workspaceWidget->insertImage(hdu.getPayload(), imageParams, widgetStates,
-                                                     FITS_FLOAT_DOUBLE_NO_TRANSFORM, FITS_VALUE_DISTRIBUTION_RANGE_MIN_THREASHOLD);
+                ui->workspaceWidget->insertImage(hdu->getPayload(), imageParams, widgetStates,
+                                                 FITS_FLOAT_DOUBLE_NO_TRANSFORM, FITS_VALUE_DISTRIBUTION_RANGE_MIN_THREASHOLD);
 
-                    ++retVal;
-                }
+                return true;
             }
         }
     }
 
-    return retVal;
+    return false;
 }
 
 WidgetsStates MainWindow::getWidgetsStates() const
@@ -1496,9 +1533,8 @@ void MainWindow::on_checkBoxEyeComfort_stateChanged(int arg1)
     }
     else if (!arg1 && m_bEyeComfort)
     {
-        int32_t index = ui->workspaceWidget->getCurrentImageHDUIndex();
-        if (index != -1)
-            restoreRGBColorChannelLevelsImage(index);
+        if (ui->workspaceWidget->getCurrentImageHDUIndex() != -1)
+            applyImageAdjustments();
 
         m_bEyeComfort = false;
     }
@@ -1511,103 +1547,50 @@ void MainWindow::on_checkBoxEyeComfort_stateChanged(int arg1)
 
 void MainWindow::changeRGBColorChannelLevel(uint8_t a_channel, int8_t a_value)
 {
-    //libnfits::LOG("in changeRGBColorChannelLevel(), before backupOriginalImage() call, m_bImageChanged = %", m_bImageChanged);
-    backupOriginalImage();
+    int8_t values[3] = { (int8_t)ui->horizontalSliderR->value(), (int8_t)ui->horizontalSliderG->value(),
+                         (int8_t)ui->horizontalSliderB->value() };
 
-    QString valueStr = QString::number(a_value) + " %";
-    valueStr = valueStr.rightJustified(LABELS_RIGHT_JUSTIFICATION_VALUE, ' ');
-
-    ui->workspaceWidget->restoreImage();
-
-    int8_t tmpVal;
-    if (a_channel == 0)
-    {
-        ui->labelValueR->setText(valueStr);
+    values[a_channel] = a_value;
 
-        tmpVal = ui->horizontalSliderG->value();
-        if (tmpVal != 0)
-            ui->workspaceWidget->changeChannelLevel(1, 1 + (float)(tmpVal)/100);
+    changeRGBColorChannelLevels(values[0], values[1], values[2]);
+}
 
-        tmpVal = ui->horizontalSliderB->value();
-        if (tmpVal != 0)
-            ui->workspaceWidget->changeChannelLevel(2, 1 + (float)(tmpVal)/100);
-    }
-    else if (a_channel == 1)
-    {
-        ui->labelValueG->setText(valueStr);
+// The image is rendered again with all three levels and the grayscale and eye comfort check boxes at once
+void MainWindow::changeRGBColorChannelLevels(int8_t a_rValue, int8_t a_gValue, int8_t a_bValue)
+{
+    setImageChanged();
 
-        tmpVal = ui->horizontalSliderR->value();
-        if (tmpVal != 0)
-            ui->workspaceWidget->changeChannelLevel(0, 1 + (float)(tmpVal)/100);
+    QLabel* labels[3] = { ui->labelValueR, ui->labelValueG, ui->labelValueB };
+    int8_t values[3] = { a_rValue, a_gValue, a_bValue };
 
-        tmpVal = ui->horizontalSliderB->value();
-        if (tmpVal != 0)
-            ui->workspaceWidget->changeChannelLevel(2, 1 + (float)(tmpVal)/100);
-    }
-    else if (a_channel == 2)
+    for (int32_t i = 0; i < 3; ++i)
     {
-        ui->labelValueB->setText(valueStr);
-
-        tmpVal = ui->horizontalSliderR->value();
-        if (tmpVal != 0)
-            ui->workspaceWidget->changeChannelLevel(0, 1 + (float)(tmpVal)/100);
-
-        tmpVal = ui->horizontalSliderG->value();
-        if (tmpVal != 0)
-            ui->workspaceWidget->changeChannelLevel(1, 1 + (float)(tmpVal)/100);
+        QString valueStr = QString::number(values[i]) + " %";
+        labels[i]->setText(valueStr.rightJustified(LABELS_RIGHT_JUSTIFICATION_VALUE, ' '));
     }
 
-    //ui->workspaceWidget->restoreImage();
-    ui->workspaceWidget->changeChannelLevel(a_channel, 1 + (float)(a_value)/100);
+    ui->workspaceWidget->setImageAdjustments(1 + (float)(a_rValue)/100, 1 + (float)(a_gValue)/100, 1 + (float)(a_bValue)/100,
+                                             ui->checkBoxGrayscale->isChecked(), ui->checkBoxEyeComfort->isChecked());
     ui->workspaceWidget->reloadImage();
     ui->workspaceWidget->scaleImage(m_scaleFactor);
 }
 
-void MainWindow::changeRGBColorChannelLevels(int8_t a_rValue, int8_t a_gValue, int8_t a_bValue)
-{
-    changeRGBColorChannelLevel(0, a_rValue);
-    changeRGBColorChannelLevel(1, a_gValue);
-    changeRGBColorChannelLevel(2, a_bValue);
-}
-
-void MainWindow::restoreRGBColorChannelLevelsImage(int32_t a_hduIndex, uint32_t a_transformType)
-//void MainWindow::restoreRGBColorChannelLevelsImage(int32_t a_hduIndex, uint32_t a_transformType,)
+// The adjustments of the widgets, the image is rendered again only if they differ from the ones it is shown with
+void MainWindow::applyImageAdjustments()
 {
-    int8_t rValue = ui->horizontalSliderR->value();
-    int8_t gValue = ui->horizontalSliderG->value();
-    int8_t bValue = ui->horizontalSliderB->value();
-
-    if (rValue != 0 || gValue != 0 || bValue != 0)
-    {
-        //libnfits::LOG("in restoreRGBColorChannelLevelsImage(), if case, a_hduIndex = %", a_hduIndex);
-        ui->workspaceWidget->setImage(a_hduIndex, a_transformType, m_percentThreshold[ui->comboBoxMapping->currentIndex()]);
-        changeRGBColorChannelLevels(rValue, gValue, bValue);
-    }
-    else
-    {
-        //libnfits::LOG("in restoreRGBColorChannelLevelsImage(), else case");
-        ui->workspaceWidget->restoreImage();
-        ui->workspaceWidget->reloadImage();
-    }
+    changeRGBColorChannelLevels(ui->horizontalSliderR->value(), ui->horizontalSliderG->value(), ui->horizontalSliderB->value());
 }
 
 void MainWindow::grayScale()
 {
-    //libnfits::LOG("in grayScale() , m_bImageChanged = ", m_bImageChanged);
-    backupOriginalImage();
-    ui->workspaceWidget->convertImage2Grayscale();
+    applyImageAdjustments();
     enableRestoreWidgets(false);
-    ui->workspaceWidget->reloadImage();
-
 }
 
 void MainWindow::eyeComfort()
 {
-    //libnfits::LOG("in eyeComfort() , m_bImageChanged = ", m_bImageChanged);
-    backupOriginalImage();
-    ui->workspaceWidget->convertImage2EyeComfort();
+    applyImageAdjustments();
     enableRestoreWidgets(false);
-    ui->workspaceWidget->reloadImage();
 }
 
 void MainWindow::on_resetRGBButton_clicked()
@@ -1657,8 +1640,7 @@ void MainWindow::on_comboBoxMapping_currentIndexChanged(int index)
 
     ui->workspaceWidget->reloadImageWithTransformation(transformType, m_percentThreshold[transformType]);
     m_bImageChanged = false;
-    backupOriginalImage();
-    restoreRGBColorChannelLevelsImage(ui->workspaceWidget->getCurrentImageHDUIndex(), transformType);
+    applyImageAdjustments();
 
     ui->workspaceWidget->scaleImage(m_scaleFactor);
     ui->workspaceWidget->setScrollPosX(scrollX);
@@ -1839,8 +1821,7 @@ void MainWindow::on_horizontalSliderPercent_valueChanged(int value)
 
     ui->workspaceWidget->reloadImageWithTransformation(transformType, m_percentThreshold[transformType]);
     m_bImageChanged = false;
-    backupOriginalImage();
-    restoreRGBColorChannelLevelsImage(ui->workspaceWidget->getCurrentImageHDUIndex(), transformType);
+    applyImageAdjustments();
 
     ui->workspaceWidget->scaleImage(m_scaleFactor);
     ui->workspaceWidget->setScrollPosX(scrollX);
@@ -1953,8 +1934,11 @@ void MainWindow::on_actionAboutToolBar_triggered()
     dlg.exec();
 }
 
-template<typename T> void MainWindow::onDrawHistogramChart(libnfits::DistribStats const* a_distribStats, T a_min, T a_max, size_t a_size)
+template<typename T> void MainWindow::onDrawHistogramChart(libnfits::Histogram const* a_histogram, T a_min, T a_max)
 {
+    libnfits::DistribStats const* a_distribStats = a_histogram->getBins();
+    size_t a_size = a_histogram->getBinsNumber();
+
     float maxPercent = 0.0f;
 
     size_t maxPixelCount = 0;
@@ -2049,18 +2033,14 @@ template<typename T> void MainWindow::onDrawHistogramChart(libnfits::DistribStat
     */
     /// end of useful debug output
 
-    ///double stretchQ = ((double)(range) / (a_size)); /// original way
-    long double stretchQ = ((long double)(range1) / (a_size)); /// original way
-
-    int32_t histShowStep = FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER / histChartMaxPointsToShow;
+    /// the log and asinh bins are of different widths, every bin is placed at its start
+    size_t histShowStep = std::max<size_t>(a_size / histChartMaxPointsToShow, 1);
 
     for (size_t i = 0; i < a_size; ++i)
     {
         if (i % histShowStep == 0)
         {
-            ///double scaledX = a_min + i*stretchQ; /// original way
-
-            double scaledX = ((long double)a_min + i*stretchQ) / k;
+            double scaledX = a_histogram->getBinStart(i) / k;
 
             double value = a_distribStats[i].count > 0 ? std::log10(a_distribStats[i].count) : 0;
 
@@ -2089,22 +2069,22 @@ void MainWindow::initChartDefaultMetrics()
     m_histChart->setTitle(histogramTitle + QString::asprintf("%.10LE", 1.0L));
 }
 
-void MainWindow::onDrawHistogramChartInt(libnfits::DistribStats const* a_distribStats, int64_t a_min, int64_t a_max, size_t a_size)
+void MainWindow::onDrawHistogramChartInt(libnfits::Histogram const* a_histogram, int64_t a_min, int64_t a_max)
 {
-    onDrawHistogramChart<int64_t>(a_distribStats, a_min, a_max, a_size);
+    onDrawHistogramChart<int64_t>(a_histogram, a_min, a_max);
 }
 
-void MainWindow::onDrawHistogramChartDouble(libnfits::DistribStats const* a_distribStats, double a_min, double a_max, size_t a_size)
+void MainWindow::onDrawHistogramChartDouble(libnfits::Histogram const* a_histogram, double a_min, double a_max)
 {
-    onDrawHistogramChart<double>(a_distribStats, a_min, a_max, a_size);
+    onDrawHistogramChart<double>(a_histogram, a_min, a_max);
 }
 
-template void MainWindow::onDrawHistogramChart<int64_t>(libnfits::DistribStats const* a_distribStats, int64_t a_min, int64_t a_max, size_t a_size);
-template void MainWindow::onDrawHistogramChart<double>(libnfits::DistribStats const* a_distribStats, double a_min, double a_max, size_t a_size);
+template void MainWindow::onDrawHistogramChart<int64_t>(libnfits::Histogram const* a_histogram, int64_t a_min, int64_t a_max);
+template void MainWindow::onDrawHistogramChart<double>(libnfits::Histogram const* a_histogram, double a_min, double a_max);
 
 void MainWindow::transformPercentileStretching()
 {
-    int32_t percentile = FITS_PERCENTILE_THRESHOLD_OFFSET + (ui->comboBoxPercentile->currentText()).toFloat();
+    float percentile = FITS_PERCENTILE_THRESHOLD_OFFSET + (ui->comboBoxPercentile->currentText()).toFloat();
     uint32_t stretching = ui->comboBoxStretching->currentIndex();
 
     int32_t scrollX = ui->workspaceWidget->getScrollPosX();
@@ -2119,8 +2099,7 @@ void MainWindow::transformPercentileStretching()
 
     ui->workspaceWidget->reloadImageWithTransformation(transform, percentile);
     m_bImageChanged = false;
-    backupOriginalImage();
-    ///restoreRGBColorChannelLevelsImage(ui->workspaceWidget->getCurrentImageHDUIndex(), transform);
+    applyImageAdjustments();
 
     ui->workspaceWidget->scaleImage(m_scaleFactor);
     ui->workspaceWidget->setScrollPosX(scrollX);
@@ -132,9 +132,9 @@ private slots:
 
     void on_actionAboutToolBar_triggered();
 
-    void onDrawHistogramChartInt(libnfits::DistribStats const* a_distribStats, int64_t a_min, int64_t a_max, size_t a_size);
+    void onDrawHistogramChartInt(libnfits::Histogram const* a_histogram, int64_t a_min, int64_t a_max);
 
-    void onDrawHistogramChartDouble(libnfits::DistribStats const* a_distribStats, double a_min, double a_max, size_t a_size);
+    void onDrawHistogramChartDouble(libnfits::Histogram const* a_histogram, double a_min, double a_max);
 
     void on_comboBoxPercentile_currentIndexChanged(int index);
 
@@ -144,6 +144,10 @@ private slots:
 
     void on_actionOriginalSize_triggered();
 
+    void onHDULoaded(qint32 a_hduIndex);
+
+    void onImageStatsUpdated(quint32 a_hduIndex);
+
 private:
     Ui::MainWindow *ui;
 
@@ -186,6 +190,8 @@ private:
     QValueAxis*         m_axisY;
     ///////
 
+    int32_t             m_defaultHDURow;     /// the HDU row selected after loading: the last image HDU or the first one
+
 private:
     void createStatusBarWidgets();
     void initGammaWidgetsValues();
@@ -208,7 +214,7 @@ private:
     void scaleImage();
     void fitToWindow();
     void fitOriginalSize();
-    void backupOriginalImage();
+    void setImageChanged();
     void restoreOriginalImage();
 
     int32_t openFITSFile();
@@ -216,9 +222,9 @@ private:
     int32_t closeFITSFile();
     int32_t exportAllImages(bool a_msgFlag = true, int32_t a_transform = FITS_FLOAT_DOUBLE_NO_TRANSFORM, bool a_gray = false);
     bool   exportImage();
-    int32_t setAllWorkspaceImages();
+    bool setWorkspaceImage(uint32_t a_hduIndex);
 
-    void populateHDUsWidget();
+    void populateHDUsWidgetRow(uint32_t a_hduIndex);
     void populateHeaderWidget(int32_t a_hduIndex);
     void populateRawDataWidget(int32_t a_hduIndex);
     void populateHDUInfoWidget(int32_t a_hduIndex);
@@ -237,7 +243,7 @@ private:
 
     void changeRGBColorChannelLevel(uint8_t a_channel, int8_t a_value);
     void changeRGBColorChannelLevels(int8_t a_rValue, int8_t a_gValue, int8_t a_bValue);
-    void restoreRGBColorChannelLevelsImage(int32_t a_hduIndex, uint32_t a_transformType = FITS_FLOAT_DOUBLE_NO_TRANSFORM);
+    void applyImageAdjustments();
     void grayScale();
     void eyeComfort();
 
@@ -249,7 +255,7 @@ private:
 
     void checkForUpdate();
 
-    template<typename T> void onDrawHistogramChart(libnfits::DistribStats const* a_distribStats, T a_min, T a_max, size_t a_size);
+    template<typename T> void onDrawHistogramChart(libnfits::Histogram const* a_histogram, T a_min, T a_max);
 
     void initChartDefaultMetrics();
 
@@ -257,6 +263,7 @@ private:
 
 signals:
     void sendProgressChanged(qint32 a_value);
+    void sendHDULoaded(qint32 a_hduIndex);
 
 };
 #endif // MAINWINDOW_H
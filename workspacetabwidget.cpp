@@ -2,13 +2,20 @@
 #include "ui_workspacetabwidget.h"
 
 #include <cstring>
+#include <memory>
 #include <QMovie>
 
 WorkspaceTabWidget::WorkspaceTabWidget(QWidget *parent) :
     QTabWidget(parent),
     ui(new Ui::WorkspaceTabWidget),
     m_fitsImage(nullptr),
-    m_fitsImageHDUIndex(-1)
+    m_fitsImageHDUIndex(-1),
+    m_quickLookSamplePixels(FITS_QUICK_LOOK_SAMPLE_PIXELS),
+    m_histogramBinsNumber(HISTOGRAM_BINS_NUMBER),
+    m_histogramSpacing(HISTOGRAM_SPACING),
+    m_isStatsThreadRunning(false),
+    m_statsGeneration(0),
+    m_statsCache(nullptr)
 {
     ui->setupUi(this);
 
@@ -58,16 +65,11 @@ WorkspaceTabWidget::~WorkspaceTabWidget()
 
 void WorkspaceTabWidget::populateHeaderWidget(const libnfits::HDU& a_hdu)
 {
-    libnfits::Header header;
-
-    std::vector<libnfits::HeaderRecord> headerRecords;
-
     ui->textEditHeader->clear();
 
-    header = a_hdu.getHeader();
-    headerRecords = header.getHeaderRecords();
+    const std::vector<libnfits::HeaderRecord>& headerRecords = a_hdu.getHeader().getHeaderRecords();
 
-    for (std::vector<libnfits::HeaderRecord>::iterator it = headerRecords.begin(); it < headerRecords.end(); ++it)
+    for (std::vector<libnfits::HeaderRecord>::const_iterator it = headerRecords.begin(); it < headerRecords.end(); ++it)
     {
          QString keyword = QString((it->getKeyword().c_str()));
          QString keywordAligned = keyword.leftJustified(12, ' ');
@@ -99,8 +101,6 @@ void WorkspaceTabWidget::populateHeaderWidget(const libnfits::HDU& a_hdu)
          ui->textEditHeader->insertPlainText(comment + "\n");
      }
 
-     headerRecords.clear();
-
      ui->textEditHeader->moveCursor(QTextCursor::Start);
 }
 
@@ -167,11 +167,14 @@ void WorkspaceTabWidget::insertImage(const uint8_t* a_image, uint32_t a_width, u
     image->setMaxDataBufferSize(a_maxDataBufferSize);
     image->setBaseOffset(a_HDUBaseOffset);
     image->setData(a_image);
+    image->setSamplePlaneCaching();  /// stretch changes re-render the image from the decoded samples
+    image->setHistogramBins(m_histogramBinsNumber, m_histogramSpacing);
     image->createRGB32FlatData();
 
     imageHDU.index = a_hduIndex;
     imageHDU.image = image;
     imageHDU.widgetsStates = a_widgetStates;
+    imageHDU.isRenderOutdated = false;
 
     m_vecFitsImages.push_back(imageHDU);
 }
@@ -191,29 +194,190 @@ void WorkspaceTabWidget::insertImage(const uint8_t* a_image, ImageParams& a_imag
     image->setBZero(a_imageParams.bzero);
     image->setBScale(a_imageParams.bscale);
     image->setData(a_image);
+    image->setSamplePlaneCaching();  /// stretch changes re-render the image from the decoded samples
+    image->setHistogramBins(m_histogramBinsNumber, m_histogramSpacing);
 
-    if (a_imageParams.bitpix == -64)
-            image->calcBufferMinMax<double>();
+    if (a_imageParams.blankFlag)
+        image->setBlankValue(a_imageParams.blank);
+
+    libnfits::ImageStats cachedStats;
+
+    if (m_statsCache != nullptr && m_statsCache->findImageStats(*image, cachedStats) == FITS_GENERAL_SUCCESS)
+        image->setStats(cachedStats);
+    else if (a_imageParams.bitpix == -64)
+            calcImageStats<double>(image, a_imageParams.hduIndex);
     else if (a_imageParams.bitpix == 64)
-            image->calcBufferMinMax<int64_t>();
+            calcImageStats<int64_t>(image, a_imageParams.hduIndex);
     else if (a_imageParams.bitpix == -32)
-            image->calcBufferMinMax<float>();
+            calcImageStats<float>(image, a_imageParams.hduIndex);
     else if (a_imageParams.bitpix == 32)
-            image->calcBufferMinMax<int32_t>();
+            calcImageStats<int32_t>(image, a_imageParams.hduIndex);
     else if (a_imageParams.bitpix == 16)
-            image->calcBufferMinMax<int16_t>();
+            calcImageStats<int16_t>(image, a_imageParams.hduIndex);
     else if (a_imageParams.bitpix == 8)
-            image->calcBufferMinMax<uint8_t>();
+            calcImageStats<uint8_t>(image, a_imageParams.hduIndex);
 
     image->createRGB32FlatData(a_transformType, a_percent);
 
     imageHDU.index = a_imageParams.hduIndex;
     imageHDU.image = image;
     imageHDU.widgetsStates = a_widgetStates;
+    imageHDU.isRenderOutdated = false;
 
     m_vecFitsImages.push_back(imageHDU);
 }
 
+//// The image is rendered with the statistics of a sample of its pixels first, the exact ones are counted
+//// by the statistics worker and replace them in the GUI thread by setImageExactStats(). The worker counts
+//// the images one after another, each of them is counted on all the cores.
+template<typename T> void WorkspaceTabWidget::calcImageStats(libnfits::Image* a_image, uint32_t a_hduIndex)
+{
+    if (m_quickLookSamplePixels != 0)
+        a_image->calcBufferQuickStats<T>(m_quickLookSamplePixels);
+
+    if (!a_image->isStatsApproximate())
+    {
+        a_image->calcBufferMinMax<T>();
+        cacheImageStats(a_image);
+
+        return;
+    }
+
+    uint32_t statsGeneration = m_statsGeneration;
+
+    try
+    {
+        queueImageStats([this, a_image, a_hduIndex, statsGeneration]()
+        {
+            std::shared_ptr<libnfits::ImageStats> stats = std::make_shared<libnfits::ImageStats>();
+
+            if (a_image->calcBufferStats<T>(*stats) != FITS_GENERAL_SUCCESS)
+                return;
+
+            /// cached here, the file may be closed before the GUI thread gets the statistics
+            if (m_statsCache != nullptr)
+                m_statsCache->setImageStats(*a_image, *stats);
+
+            QMetaObject::invokeMethod(this, [this, a_hduIndex, statsGeneration, stats]()
+            {
+                setImageExactStats(a_hduIndex, statsGeneration, *stats);
+            }, Qt::QueuedConnection);
+        });
+    }
+    catch (...)
+    {
+        /// no thread, the exact statistics are counted right away
+        a_image->calcBufferMinMax<T>();
+        cacheImageStats(a_image);
+    }
+}
+
+void WorkspaceTabWidget::setImageExactStats(uint32_t a_hduIndex, uint32_t a_statsGeneration, const libnfits::ImageStats& a_stats)
+{
+    if (a_statsGeneration != m_statsGeneration)
+        return;
+
+    for (auto it = m_vecFitsImages.begin(); it < m_vecFitsImages.end(); ++it)
+    {
+        if (it->index == a_hduIndex)
+        {
+            it->image->setStats(a_stats);
+            it->isRenderOutdated = true;
+
+            /// the shown image is re-rendered by the main window with its current settings
+            if ((int32_t)a_hduIndex == m_fitsImageHDUIndex)
+                emit sendImageStatsUpdated(a_hduIndex);
+        }
+    }
+}
+
+// The worker is started with the first job and ends when there are no more of them
+void WorkspaceTabWidget::queueImageStats(std::function<void()>&& a_job)
+{
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+
+    m_statsJobs.push_back(std::move(a_job));
+
+    if (m_isStatsThreadRunning)
+        return;
+
+    if (m_statsThread.joinable())
+        m_statsThread.join();
+
+    try
+    {
+        m_statsThread = std::thread(&WorkspaceTabWidget::runImageStats, this);
+        m_isStatsThreadRunning = true;
+    }
+    catch (...)
+    {
+        m_statsJobs.pop_back();
+        throw;
+    }
+}
+
+void WorkspaceTabWidget::runImageStats()
+{
+    while (true)
+    {
+        std::function<void()> job;
+
+        {
+            std::lock_guard<std::mutex> lock(m_statsMutex);
+
+            if (m_statsJobs.empty())
+            {
+                m_isStatsThreadRunning = false;
+                return;
+            }
+
+            job = std::move(m_statsJobs.front());
+            m_statsJobs.pop_front();
+        }
+
+        job();
+    }
+}
+
+// The images not started yet are dropped, the one being counted is finished
+void WorkspaceTabWidget::waitImageStats()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+
+        m_statsJobs.clear();
+    }
+
+    if (m_statsThread.joinable())
+        m_statsThread.join();
+}
+
+void WorkspaceTabWidget::setQuickLookSamplePixels(size_t a_samplePixels)
+{
+    m_quickLookSamplePixels = a_samplePixels;
+}
+
+// Applied to the images inserted afterwards, the statistics of the inserted ones are counted with their bins
+void WorkspaceTabWidget::setHistogramBins(size_t a_binsNumber, uint32_t a_spacing)
+{
+    m_histogramBinsNumber = a_binsNumber;
+    m_histogramSpacing = a_spacing;
+}
+
+void WorkspaceTabWidget::setStatsCache(libnfits::StatsCache* a_statsCache)
+{
+    m_statsCache = a_statsCache;
+}
+
+// The exact statistics of the image are saved with the file when it is closed
+void WorkspaceTabWidget::cacheImageStats(const libnfits::Image* a_image)
+{
+    libnfits::ImageStats stats;
+
+    if (m_statsCache != nullptr && a_image->getStats(stats) == FITS_GENERAL_SUCCESS)
+        m_statsCache->setImageStats(*a_image, stats);
+}
+
 void WorkspaceTabWidget::reloadImage()
 {
     QImage *image = nullptr;
@@ -273,37 +437,23 @@ void WorkspaceTabWidget::scrollToCenter() const
         vScrollBar->setValue(int(vScrollBar->maximum()/2));
 }
 
-void WorkspaceTabWidget::convertImage2Grayscale()
-{
-    //backupImage();
-
-    m_fitsImage->convertRGB32Flat2Grayscale();
-}
-
-void WorkspaceTabWidget::convertImage2EyeComfort()
+// The image is rendered again from its samples with the adjustments, the channels are swapped as the R level is
+// the one of the pixel word bits 16-23
+void WorkspaceTabWidget::setImageAdjustments(float a_rQuatient, float a_gQuatient, float a_bQuatient, bool a_grayscale,
+                                             bool a_eyeComfort)
 {
-    //backupImage();
+    if (m_fitsImage == nullptr)
+        return;
 
-    m_fitsImage->convertRGB32Flat2EyeComfortColors();
-}
-void WorkspaceTabWidget::backupImage()
-{
-    m_fitsImage->backupRGB32FlatData();
-}
+    libnfits::ImageRenderSettings settings = m_fitsImage->getRenderSettings();
 
-void WorkspaceTabWidget::restoreImage()
-{
-    m_fitsImage->restoreRGB32FlatData();
-}
+    settings.levels[0] = a_bQuatient;
+    settings.levels[1] = a_gQuatient;
+    settings.levels[2] = a_rQuatient;
+    settings.grayscale = a_grayscale;
+    settings.eyeComfort = a_eyeComfort;
 
-void WorkspaceTabWidget::changeChannelLevel(uint8_t a_channel, float a_quatient)
-{
-    if (a_channel == 2)
-        m_fitsImage->change32FlatRLevel(a_quatient);
-    else if (a_channel == 1)
-        m_fitsImage->change32FlatGLevel(a_quatient);
-    else if (a_channel == 0)
-        m_fitsImage->change32FlatBLevel(a_quatient);
+    m_fitsImage->render(settings);
 }
 
 uint32_t WorkspaceTabWidget::getImageWidth() const
@@ -359,6 +509,10 @@ void WorkspaceTabWidget::enableTabs(bool a_flag)
 
 void WorkspaceTabWidget::clearImages()
 {
+    /// the workers read the payloads of the images, the statistics still queued are dropped
+    waitImageStats();
+    ++m_statsGeneration;
+
     if (m_imageLabel != nullptr)
     {
         m_imageLabel->resize(0, 0);
@@ -381,7 +535,7 @@ void WorkspaceTabWidget::clearImages()
 }
 
 //void WorkspaceTabWidget::setImage(uint32_t a_hduIndex, uint32_t a_transformType, bool a_bRecreate)
-void WorkspaceTabWidget::setImage(uint32_t a_hduIndex, uint32_t a_transformType, int32_t a_percent, bool a_bRecreate)
+void WorkspaceTabWidget::setImage(uint32_t a_hduIndex, uint32_t a_transformType, float a_percent, bool a_bRecreate)
 {
     for (auto it = m_vecFitsImages.begin(); it < m_vecFitsImages.end(); ++it)
     {
@@ -391,8 +545,10 @@ void WorkspaceTabWidget::setImage(uint32_t a_hduIndex, uint32_t a_transformType,
             m_fitsImageHDUIndex = it->index;
 
             //// this part is added due to image mapping/transformation support
-            if (a_bRecreate)
+            if (a_bRecreate || it->isRenderOutdated)
             {
+                it->isRenderOutdated = false;
+
                 m_fitsImage->deleteAllData();
                 m_fitsImage->createRGB32FlatData(a_transformType, a_percent);
                 ///libnfits::LOG("in setImage(uint32_t a_hduIndex, uint32_t a_transformType), a_transformType = % ", a_transformType);
@@ -401,15 +557,16 @@ void WorkspaceTabWidget::setImage(uint32_t a_hduIndex, uint32_t a_transformType,
 
             reloadImage();
 
-            if (it->image->getBitPix() > 0)
+            /// the histogram is allocated when the statistics are counted
+            if (it->image->getHistogram() != nullptr && it->image->getBitPix() > 0)
             {
-                emit sendDrawHistogramChartInt(it->image->getDistribStats(), it->image->getMinValueL(),
-                                               it->image->getMaxValueL(), FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER);
+                emit sendDrawHistogramChartInt(it->image->getHistogram(), it->image->getMinValueL(),
+                                               it->image->getMaxValueL());
             }
-            else if (it->image->getBitPix() < 0)
+            else if (it->image->getHistogram() != nullptr && it->image->getBitPix() < 0)
             {
-                emit sendDrawHistogramChartDouble(it->image->getDistribStats(), it->image->getMinValue(),
-                                               it->image->getMaxValue(), FITS_VALUE_DISTRIBUTION_SEGMENTS_NUMBER);
+                emit sendDrawHistogramChartDouble(it->image->getHistogram(), it->image->getMinValue(),
+                                               it->image->getMaxValue());
             }
 
 
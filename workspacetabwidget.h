@@ -5,11 +5,17 @@
 #include <QLabel>
 #include <QScrollBar>
 
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
 #include "defsui.h"
 #include "fitsimagelabel.h"
 
 #include "libnfits/hdu.h"
 #include "libnfits/image.h"
+#include "libnfits/statscache.h"
 
 #define IMAGE_EXPORT_TYPE_PNG       "png"
 #define IMAGE_EXPORT_TYPE_TIFF      "tiff"
@@ -21,6 +27,7 @@ struct FITSImageHDU
     libnfits::Image*    image;
     uint32_t            index;
     WidgetsStates       widgetsStates;
+    bool                isRenderOutdated;   /// the exact statistics replaced the quick look ones after the image was rendered
 };
 
 namespace Ui {
@@ -45,14 +52,10 @@ public:
     void scaleImage(int32_t a_factor);
     QSize getScrollAreaSize() const;
     void scrollToCenter() const;
-    void convertImage2Grayscale();
-    void convertImage2EyeComfort();
-    void restoreImage();
-    void changeChannelLevel(uint8_t a_channel, float a_quatient);
+    void setImageAdjustments(float a_rQuatient, float a_gQuatient, float a_bQuatient, bool a_grayscale, bool a_eyeComfort);
     uint32_t getImageWidth() const;
     uint32_t getImageHeight() const;
     void imageSetVisible(bool a_visible);
-    void backupImage();
     bool exportImage(const QString& a_fileName, const QString& a_strType = IMAGE_EXPORT_TYPE_PNG, int32_t a_quality = -1);
     QSize getImageLabelSize() const;
     void enableTabs(bool a_flag = true);
@@ -65,8 +68,12 @@ public:
                      uint32_t a_transformType, int32_t a_percent);
 
     void clearImages();
+    void waitImageStats();
+    void setQuickLookSamplePixels(size_t a_samplePixels);
+    void setHistogramBins(size_t a_binsNumber, uint32_t a_spacing);
+    void setStatsCache(libnfits::StatsCache* a_statsCache);
     //void setImage(uint32_t a_hduIndex, uint32_t a_transformType = FITS_FLOAT_DOUBLE_NO_TRANSFORM, bool a_bRecreate = false);
-    void setImage(uint32_t a_hduIndex, uint32_t a_transformType, int32_t a_percent, bool a_bRecreate = false);
+    void setImage(uint32_t a_hduIndex, uint32_t a_transformType, float a_percent, bool a_bRecreate = false);
     libnfits::Image* getImage(uint32_t a_hduIndex) const;
 
     int32_t getScrollPosX() const;
@@ -122,15 +129,24 @@ public:
 
     libnfits::DistribStats const* getDistribStats() const;
 
+private:
+    template<typename T> void calcImageStats(libnfits::Image* a_image, uint32_t a_hduIndex);
+    void queueImageStats(std::function<void()>&& a_job);
+    void runImageStats();
+    void setImageExactStats(uint32_t a_hduIndex, uint32_t a_statsGeneration, const libnfits::ImageStats& a_stats);
+    void cacheImageStats(const libnfits::Image* a_image);
+
 private slots:
     void on_WorkspaceTabWidget_currentChanged(int index);
 
 signals:
     void sendGammaCorrectionTabEnabled(bool a_flag);
 
-    void sendDrawHistogramChartInt(libnfits::DistribStats const* a_distribStats, int64_t a_min, int64_t a_max, size_t a_size);
+    void sendDrawHistogramChartInt(libnfits::Histogram const* a_histogram, int64_t a_min, int64_t a_max);
 
-    void sendDrawHistogramChartDouble(libnfits::DistribStats const* a_distribStats, double a_min, double a_max, size_t a_size);
+    void sendDrawHistogramChartDouble(libnfits::Histogram const* a_histogram, double a_min, double a_max);
+
+    void sendImageStatsUpdated(quint32 a_hduIndex);
 
 private:
     Ui::WorkspaceTabWidget *ui;
@@ -140,6 +156,16 @@ private:
 
     std::vector<FITSImageHDU>        m_vecFitsImages;
     int32_t                          m_fitsImageHDUIndex;
+
+    size_t                           m_quickLookSamplePixels;   /// 0 counts the exact statistics before the first render
+    size_t                           m_histogramBinsNumber;     /// the value distribution of the inserted images
+    uint32_t                         m_histogramSpacing;
+    std::thread                      m_statsThread;             /// counts the exact statistics of the quick look images one by one
+    std::deque<std::function<void()>> m_statsJobs;
+    std::mutex                       m_statsMutex;              /// guards the jobs and the flag below
+    bool                             m_isStatsThreadRunning;
+    uint32_t                         m_statsGeneration;         /// the statistics of the cleared images are dropped
+    libnfits::StatsCache*            m_statsCache;              /// the exact statistics of the images of the open file
 };
 
 #endif // WORKSPACETABWIDGET_H